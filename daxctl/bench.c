@@ -0,0 +1,1096 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysmacros.h>
+#include <util/json.h>
+#include <util/clock.h>
+#include <util/size.h>
+#include <util/jobs.h>
+#include <json-c/json.h>
+#include <daxctl/libdaxctl.h>
+#include <util/parse-options.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#endif
+
+static struct {
+	const char *size;
+	const char *align;
+	const char *block_size;
+	const char *tests;
+	const char *store;
+	unsigned int threads;
+	unsigned int duration;
+	int numa_node;
+	bool force;
+	bool human;
+	bool verbose;
+} param = {
+	.threads = 1,
+	.duration = 1,
+	.numa_node = -1,
+};
+
+enum bench_test {
+	TEST_SEQ_READ,
+	TEST_SEQ_WRITE,
+	TEST_RAND_READ,
+	TEST_RAND_WRITE,
+	TEST_LATENCY,
+	TEST_FAULT,
+	TEST_MAX,
+};
+
+static const char * const test_names[] = {
+	[TEST_SEQ_READ] = "seq-read",
+	[TEST_SEQ_WRITE] = "seq-write",
+	[TEST_RAND_READ] = "rand-read",
+	[TEST_RAND_WRITE] = "rand-write",
+	[TEST_LATENCY] = "latency",
+	[TEST_FAULT] = "fault",
+};
+
+enum bench_store {
+	STORE_REGULAR,
+	STORE_NT,
+	STORE_CLWB,
+};
+
+static const char * const store_names[] = {
+	[STORE_REGULAR] = "regular",
+	[STORE_NT] = "nt",
+	[STORE_CLWB] = "clwb",
+};
+
+#define CACHELINE 64
+/* working set of the pointer chase, large enough to defeat the caches */
+#define LATENCY_SPAN SZ_256M
+
+struct bench_map {
+	const char *path;
+	char *addr;
+	unsigned long long size;
+	unsigned long align;
+	unsigned long dev_align;
+	int fd;
+	bool devdax;
+	bool sync;
+};
+
+/* shared by all workers, lives in the parent before the fork */
+struct bench_run {
+	struct bench_map *map;
+	enum bench_test test;
+	enum bench_store store;
+	unsigned long block;
+	unsigned long long duration_ns;
+	unsigned long long span;
+	int num_workers;
+	unsigned long flags;
+	int *barrier;
+	cpu_set_t *cpus;
+};
+
+struct bench_worker {
+	struct bench_run *run;
+	int id;
+};
+
+static const struct option options[] = {
+	OPT_STRING('s', "size", &param.size, "size",
+			"amount of the mapping to exercise (default: all)"),
+	OPT_STRING('a', "align", &param.align, "align",
+			"mapping alignment, one of 4K, 2M, or 1G"),
+	OPT_STRING('b', "block-size", &param.block_size, "size",
+			"transfer size of a single read or write (default: 4K)"),
+	OPT_STRING('t', "tests", &param.tests, "test-list",
+			"comma separated list of seq-read, seq-write, rand-read, rand-write, latency, fault"),
+	OPT_STRING('S', "store", &param.store, "store",
+			"store flavour of the write tests: regular, nt, or clwb"),
+	OPT_UINTEGER('j', "threads", &param.threads,
+			"number of workers per test (default: 1)"),
+	OPT_INTEGER('n', "numa-node", &param.numa_node,
+			"pin workers to the cpus of this numa node"),
+	OPT_UINTEGER('d', "duration", &param.duration,
+			"seconds to run each test (default: 1)"),
+	OPT_BOOLEAN('f', "force", &param.force,
+			"allow tests that overwrite the contents of the target"),
+	OPT_BOOLEAN('u', "human", &param.human,
+			"use human friendly number formats"),
+	OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"),
+	OPT_END(),
+};
+
+static uint64_t xorshift64(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+static bool cpu_has_clwb(void)
+{
+#if defined(__x86_64__)
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	return !!(ebx & (1 << 24));
+#else
+	return false;
+#endif
+}
+
+static int store_supported(enum bench_store store)
+{
+	switch (store) {
+	case STORE_REGULAR:
+		return 0;
+	case STORE_NT:
+#if defined(__x86_64__)
+		return 0;
+#else
+		return -EOPNOTSUPP;
+#endif
+	case STORE_CLWB:
+		return cpu_has_clwb() ? 0 : -EOPNOTSUPP;
+	}
+	return -EINVAL;
+}
+
+#if defined(__x86_64__)
+static void clwb(void *addr)
+{
+	/* clwb encoded as "66 0f ae /6" for assemblers that predate it */
+	asm volatile(".byte 0x66; xsaveopt %0" : "+m" (*(volatile char *)addr));
+}
+#endif
+
+static uint64_t read_block(const char *src, unsigned long len)
+{
+	const uint64_t *p = (const uint64_t *) src;
+	uint64_t sum = 0;
+	unsigned long i;
+
+	for (i = 0; i < len / sizeof(*p); i++)
+		sum += p[i];
+	return sum;
+}
+
+static void write_block(char *dst, unsigned long len, enum bench_store store,
+		uint64_t val)
+{
+	uint64_t *p = (uint64_t *) dst;
+	unsigned long i;
+
+	switch (store) {
+	case STORE_REGULAR:
+		for (i = 0; i < len / sizeof(*p); i++)
+			p[i] = val;
+		break;
+#if defined(__x86_64__)
+	case STORE_NT:
+		for (i = 0; i < len / sizeof(*p); i++)
+			_mm_stream_si64((long long *) &p[i], val);
+		_mm_sfence();
+		break;
+	case STORE_CLWB:
+		for (i = 0; i < len / sizeof(*p); i++) {
+			p[i] = val;
+			if ((i + 1) % (CACHELINE / sizeof(*p)) == 0)
+				clwb(&p[i]);
+		}
+		_mm_sfence();
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+static bool test_writes(enum bench_test test)
+{
+	return test == TEST_SEQ_WRITE || test == TEST_RAND_WRITE
+		|| test == TEST_LATENCY;
+}
+
+/* fault in the range up front so that page faults are not timed */
+static uint64_t prefault(struct bench_map *map, unsigned long long start,
+		unsigned long long len)
+{
+	uint64_t sum = 0;
+	unsigned long long off;
+
+	for (off = start; off < start + len; off += map->align)
+		sum += *(volatile uint64_t *) (map->addr + off);
+	return sum;
+}
+
+/*
+ * Map @size bytes of @fd at an address aligned to @align plus @skew, a
+ * non-zero @skew keeps the kernel from using pages larger than itself.
+ */
+static char *map_aligned(int fd, unsigned long long size, unsigned long align,
+		unsigned long skew, int mflags)
+{
+	char *reserve, *addr, *mapped;
+
+	reserve = mmap(NULL, size + align + skew, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserve == MAP_FAILED)
+		return MAP_FAILED;
+	addr = (char *) ALIGN((unsigned long) reserve, align) + skew;
+	if (addr > reserve)
+		munmap(reserve, addr - reserve);
+	munmap(addr + size, reserve + align + skew - addr);
+
+	mapped = mmap(addr, size, PROT_READ | PROT_WRITE, mflags | MAP_FIXED,
+			fd, 0);
+	if (mapped == MAP_FAILED)
+		munmap(addr, size);
+	return mapped;
+}
+
+static void barrier_wait(struct bench_run *run)
+{
+	__atomic_add_fetch(run->barrier, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(run->barrier, __ATOMIC_SEQ_CST)
+			< run->num_workers)
+		sched_yield();
+}
+
+static int bench_worker(void *arg, FILE *f_out)
+{
+	struct bench_worker *worker = arg;
+	struct bench_run *run = worker->run;
+	struct bench_map *map = run->map;
+	unsigned long long start, slice, off = 0, ops = 0, t0, t1;
+	unsigned long long nblocks = run->span / run->block;
+	uint64_t state = 0x9e3779b97f4a7c15ULL * (worker->id + 1);
+	volatile uint64_t sink = 0;
+	unsigned long batch;
+	void **chase;
+	int rc = 0;
+
+	if (run->cpus && sched_setaffinity(0, sizeof(*run->cpus), run->cpus))
+		rc = -errno;
+
+	slice = run->span / run->num_workers / run->block * run->block;
+	start = slice * worker->id;
+
+	if (run->test == TEST_SEQ_READ || run->test == TEST_SEQ_WRITE)
+		sink += prefault(map, start, slice);
+	else
+		sink += prefault(map, 0, run->span);
+
+	/* always arrive, a worker that is not counted hangs the others */
+	barrier_wait(run);
+	if (rc)
+		return rc;
+
+	if (run->test == TEST_LATENCY) {
+		chase = (void **) (map->addr + (run->span / run->num_workers
+				/ CACHELINE) * CACHELINE * worker->id);
+		t0 = now_ns();
+		do {
+			for (batch = 0; batch < 4096; batch++)
+				chase = *chase;
+			ops += batch;
+			t1 = now_ns();
+		} while (t1 - t0 < run->duration_ns);
+		sink += (uintptr_t) chase;
+		fprintf(f_out, "%llu %llu\n", ops, t1 - t0);
+		return 0;
+	}
+
+	/* sample the clock roughly once per 64K transferred */
+	batch = max(SZ_64K / run->block, 1UL);
+	t0 = now_ns();
+	do {
+		unsigned long i;
+
+		for (i = 0; i < batch; i++, ops++) {
+			char *addr;
+
+			if (run->test == TEST_RAND_READ
+					|| run->test == TEST_RAND_WRITE)
+				addr = map->addr + (xorshift64(&state)
+						% nblocks) * run->block;
+			else {
+				addr = map->addr + start + off;
+				off += run->block;
+				if (off >= slice)
+					off = 0;
+			}
+
+			if (run->test == TEST_SEQ_READ
+					|| run->test == TEST_RAND_READ)
+				sink += read_block(addr, run->block);
+			else
+				write_block(addr, run->block, run->store, ops);
+		}
+		t1 = now_ns();
+	} while (t1 - t0 < run->duration_ns);
+
+	fprintf(f_out, "%llu %llu\n", ops * run->block, t1 - t0);
+	return 0;
+}
+
+/* link every cacheline of the span into one randomly ordered cycle */
+static int latency_setup(struct bench_run *run)
+{
+	unsigned long long nlines = run->span / CACHELINE, i;
+	uint64_t state = 0x2545f4914f6cdd1dULL;
+	char *base = run->map->addr;
+	uint32_t *order;
+
+	if (nlines < 2)
+		return -EINVAL;
+	order = calloc(nlines, sizeof(*order));
+	if (!order)
+		return -ENOMEM;
+
+	for (i = 0; i < nlines; i++)
+		order[i] = i;
+	for (i = nlines - 1; i > 0; i--) {
+		unsigned long long j = xorshift64(&state) % (i + 1);
+		uint32_t tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	for (i = 0; i < nlines; i++) {
+		void **line = (void **) (base + (size_t) order[i] * CACHELINE);
+
+		*line = base + (size_t) order[(i + 1) % nlines] * CACHELINE;
+	}
+	free(order);
+	return 0;
+}
+
+static struct json_object *bench_one(struct bench_run *run)
+{
+	struct bench_worker *workers;
+	unsigned long long total = 0, ns = 0, max_ns = 0;
+	struct json_object *jobj, *jval;
+	struct util_job *jobs;
+	int i, rc = 0;
+
+	if (run->test == TEST_LATENCY) {
+		run->span = min(run->map->size, (unsigned long long) LATENCY_SPAN);
+		rc = latency_setup(run);
+		if (rc) {
+			fprintf(stderr, "%s: setup failed: %s\n",
+					test_names[run->test], strerror(-rc));
+			return NULL;
+		}
+	} else
+		run->span = run->map->size;
+
+	if (run->span / run->num_workers < run->block) {
+		fprintf(stderr, "%s: %llu bytes is too small for %d workers\n",
+				test_names[run->test], run->span,
+				run->num_workers);
+		return NULL;
+	}
+
+	workers = calloc(run->num_workers, sizeof(*workers));
+	jobs = calloc(run->num_workers, sizeof(*jobs));
+	if (!workers || !jobs)
+		goto out;
+
+	*run->barrier = 0;
+	for (i = 0; i < run->num_workers; i++) {
+		workers[i].run = run;
+		workers[i].id = i;
+		jobs[i].run = bench_worker;
+		jobs[i].arg = &workers[i];
+	}
+
+	rc = util_jobs_run(jobs, run->num_workers, run->num_workers);
+	for (i = 0; i < run->num_workers; i++) {
+		unsigned long long val, t;
+
+		if (!rc && jobs[i].rc)
+			rc = jobs[i].rc;
+		if (!rc && (!jobs[i].out
+				|| sscanf(jobs[i].out, "%llu %llu", &val, &t) != 2))
+			rc = -EIO;
+		if (!rc) {
+			total += val;
+			ns += t;
+			max_ns = max(max_ns, t);
+		}
+		free(jobs[i].out);
+	}
+	if (rc) {
+		fprintf(stderr, "%s: %s\n", test_names[run->test],
+				strerror(-rc));
+		goto out;
+	}
+
+	jobj = json_object_new_object();
+	if (!jobj)
+		goto out;
+
+	jval = json_object_new_string(test_names[run->test]);
+	if (jval)
+		json_object_object_add(jobj, "test", jval);
+
+	if (run->test == TEST_LATENCY) {
+		jval = util_json_object_size(run->span, run->flags);
+		if (jval)
+			json_object_object_add(jobj, "span", jval);
+		jval = json_object_new_int64(total);
+		if (jval)
+			json_object_object_add(jobj, "loads", jval);
+		jval = json_object_new_int64(total ? (ns + total / 2) / total : 0);
+		if (jval)
+			json_object_object_add(jobj, "latency_ns", jval);
+	} else {
+		jval = json_object_new_int64(total);
+		if (jval)
+			json_object_object_add(jobj, "bytes", jval);
+		jval = json_object_new_int64(max_ns);
+		if (jval)
+			json_object_object_add(jobj, "elapsed_ns", jval);
+		jval = json_object_new_int64(max_ns
+				? total * 1000000000.0 / max_ns : 0);
+		if (jval)
+			json_object_object_add(jobj, "bytes_per_sec", jval);
+	}
+
+	free(workers);
+	free(jobs);
+	return jobj;
+out:
+	free(workers);
+	free(jobs);
+	return NULL;
+}
+
+struct fault_worker {
+	struct bench_run *run;
+	int *ready;
+	int *abort;
+	char *addr;
+	unsigned long long len;
+	unsigned long page;
+	unsigned long long touches;
+	unsigned long long ns;
+	unsigned long long hist[64];
+	int rc;
+};
+
+/* time the first touch of each page, bucketed by power of 2 nanoseconds */
+static void *fault_worker(void *arg)
+{
+	struct fault_worker *worker = arg;
+	struct bench_run *run = worker->run;
+	unsigned long long off, t0, t1, t2;
+	volatile uint64_t sink = 0;
+
+	if (run->cpus && sched_setaffinity(0, sizeof(*run->cpus), run->cpus))
+		worker->rc = -errno;
+
+	__atomic_add_fetch(worker->ready, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(worker->ready, __ATOMIC_SEQ_CST)
+			< run->num_workers)
+		if (__atomic_load_n(worker->abort, __ATOMIC_SEQ_CST))
+			return NULL;
+	if (worker->rc)
+		return NULL;
+
+	t0 = t1 = now_ns();
+	for (off = 0; off < worker->len; off += worker->page) {
+		sink += *(volatile uint64_t *) (worker->addr + off);
+		t2 = now_ns();
+		worker->hist[63 - __builtin_clzll((t2 - t1) | 1)]++;
+		worker->touches++;
+		t1 = t2;
+	}
+	worker->ns = t1 - t0;
+	return NULL;
+}
+
+static struct json_object *fault_histogram(unsigned long long *hist)
+{
+	struct json_object *jhist, *jbucket, *jval;
+	int i;
+
+	jhist = json_object_new_array();
+	if (!jhist)
+		return NULL;
+
+	for (i = 0; i < 64; i++) {
+		if (!hist[i])
+			continue;
+		jbucket = json_object_new_object();
+		if (!jbucket)
+			continue;
+		jval = json_object_new_int64(1ULL << i);
+		if (jval)
+			json_object_object_add(jbucket, "ns", jval);
+		jval = json_object_new_int64(hist[i]);
+		if (jval)
+			json_object_object_add(jbucket, "count", jval);
+		json_object_array_add(jhist, jbucket);
+	}
+	return jhist;
+}
+
+/*
+ * Map the target afresh with @page as the largest usable page size and
+ * have every worker touch its share of the pages. The workers are
+ * threads so that they contend on the page tables and mmap lock of one
+ * address space, as the users of a shared mapping do.
+ */
+static struct json_object *fault_one(struct bench_run *run,
+		unsigned long page, const char *name, int mflags)
+{
+	unsigned long long len = run->map->size / page * page, hist[64] = { 0 };
+	unsigned long long touches = 0, ns = 0, max_ns = 0, t0, t1;
+	unsigned long align = page, skew = 0, slice;
+	struct fault_worker *workers;
+	struct json_object *jobj = NULL, *jval;
+	int i, j, started, ready = 0, abort = 0, rc = 0;
+	pthread_t *threads;
+	char *addr;
+
+	if (page < SZ_1G) {
+		align = page == SZ_4K ? SZ_2M : SZ_1G;
+		skew = page;
+	}
+
+	slice = len / page / run->num_workers * page;
+	if (!slice) {
+		fprintf(stderr, "fault: %llu bytes is too small for %d workers\n",
+				len, run->num_workers);
+		return NULL;
+	}
+
+	workers = calloc(run->num_workers, sizeof(*workers));
+	threads = calloc(run->num_workers, sizeof(*threads));
+	if (!workers || !threads)
+		goto out;
+
+	t0 = now_ns();
+	addr = map_aligned(run->map->fd, len, align, skew, mflags);
+	t1 = now_ns();
+	if (addr == MAP_FAILED) {
+		rc = -errno;
+		fprintf(stderr, "fault: %#lx %s mapping failed: %s\n", page,
+				name, strerror(-rc));
+		goto out;
+	}
+
+	for (started = 0; started < run->num_workers; started++) {
+		i = started;
+		workers[i].run = run;
+		workers[i].ready = &ready;
+		workers[i].abort = &abort;
+		workers[i].addr = addr + slice * i;
+		workers[i].len = slice;
+		workers[i].page = page;
+		rc = -pthread_create(&threads[i], NULL, fault_worker,
+				&workers[i]);
+		if (rc)
+			break;
+	}
+
+	/* release the workers that are waiting for the missing ones */
+	if (rc)
+		__atomic_store_n(&abort, 1, __ATOMIC_SEQ_CST);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+		if (!rc)
+			rc = workers[i].rc;
+		touches += workers[i].touches;
+		ns += workers[i].ns;
+		max_ns = max(max_ns, workers[i].ns);
+		for (j = 0; j < 64; j++)
+			hist[j] += workers[i].hist[j];
+	}
+	munmap(addr, len);
+	if (rc) {
+		fprintf(stderr, "fault: %#lx %s: %s\n", page, name,
+				strerror(-rc));
+		goto out;
+	}
+
+	jobj = json_object_new_object();
+	if (!jobj)
+		goto out;
+
+	jval = json_object_new_string(test_names[run->test]);
+	if (jval)
+		json_object_object_add(jobj, "test", jval);
+	jval = util_json_object_size(page, run->flags);
+	if (jval)
+		json_object_object_add(jobj, "page_size", jval);
+	jval = json_object_new_string(name);
+	if (jval)
+		json_object_object_add(jobj, "map", jval);
+	jval = json_object_new_int64(t1 - t0);
+	if (jval)
+		json_object_object_add(jobj, "mmap_ns", jval);
+	jval = json_object_new_int64(max_ns);
+	if (jval)
+		json_object_object_add(jobj, "touch_ns", jval);
+	jval = json_object_new_int64(touches);
+	if (jval)
+		json_object_object_add(jobj, "touches", jval);
+	jval = json_object_new_int64(touches ? ns / touches : 0);
+	if (jval)
+		json_object_object_add(jobj, "avg_ns", jval);
+	jval = fault_histogram(hist);
+	if (jval)
+		json_object_object_add(jobj, "histogram", jval);
+out:
+	free(workers);
+	free(threads);
+	return jobj;
+}
+
+static int bench_fault(struct bench_run *run, struct json_object *jresults)
+{
+	static const unsigned long pages[] = { SZ_4K, SZ_2M, SZ_1G };
+	struct {
+		const char *name;
+		int mflags;
+		bool sync;
+	} variants[] = {
+		{ "shared", MAP_SHARED, false },
+		{ "populate", MAP_SHARED | MAP_POPULATE, false },
+#if HAVE_DECL_MAP_SYNC && HAVE_DECL_MAP_SHARED_VALIDATE
+		{ "sync", MAP_SHARED_VALIDATE | MAP_SYNC, true },
+		{ "sync+populate", MAP_SHARED_VALIDATE | MAP_SYNC
+			| MAP_POPULATE, true },
+#endif
+	};
+	struct bench_map *map = run->map;
+	struct json_object *jobj;
+	unsigned int i, j;
+	int rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(pages); i++) {
+		/* device-dax faults at its own alignment whatever the mapping */
+		if (map->devdax && pages[i] != map->dev_align)
+			continue;
+		if (param.align && pages[i] != map->align)
+			continue;
+		if (pages[i] > map->size)
+			continue;
+
+		for (j = 0; j < ARRAY_SIZE(variants); j++) {
+			/* MAP_SYNC is implied for device-dax */
+			if (variants[j].sync && (map->devdax || !map->sync))
+				continue;
+			jobj = fault_one(run, pages[i], variants[j].name,
+					variants[j].mflags);
+			if (!jobj) {
+				rc = -ENXIO;
+				continue;
+			}
+			json_object_array_add(jresults, jobj);
+		}
+	}
+	return rc;
+}
+
+static int node_cpus(struct daxctl_ctx *ctx, int node, cpu_set_t *cpus)
+{
+	char path[PATH_MAX], buf[4096], *p;
+	FILE *f;
+
+	if (snprintf(path, sizeof(path), "%s/devices/system/node/node%d/cpulist",
+			daxctl_get_sysfs_root(ctx), node) >= (int) sizeof(path))
+		return -ENAMETOOLONG;
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (!p)
+		return -ENXIO;
+
+	CPU_ZERO(cpus);
+	while (*p && *p != '\n') {
+		unsigned long first, last;
+		char *end;
+
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			return -EINVAL;
+		last = first;
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 10);
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, cpus);
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return CPU_COUNT(cpus) ? 0 : -ENXIO;
+}
+
+static struct daxctl_dev *find_dax_dev(struct daxctl_ctx *ctx, dev_t devt)
+{
+	struct daxctl_region *region;
+	struct daxctl_dev *dev;
+
+	daxctl_region_foreach(ctx, region)
+		daxctl_dev_foreach(region, dev)
+			if (daxctl_dev_get_major(dev) == (int) major(devt)
+					&& daxctl_dev_get_minor(dev)
+					== (int) minor(devt))
+				return dev;
+	return NULL;
+}
+
+static int bench_map(struct daxctl_ctx *ctx, struct bench_map *map)
+{
+	unsigned long long size = 0;
+	struct stat st;
+	int fd, rc;
+
+	fd = open(map->path, O_RDWR);
+	if (fd < 0) {
+		rc = -errno;
+		fprintf(stderr, "failed to open %s: %s\n", map->path,
+				strerror(-rc));
+		return rc;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		rc = -errno;
+		goto out;
+	}
+
+	map->dev_align = SZ_4K;
+	if (S_ISCHR(st.st_mode)) {
+		struct daxctl_dev *dev = find_dax_dev(ctx, st.st_rdev);
+
+		if (!dev) {
+			fprintf(stderr, "%s: not a device-dax instance\n",
+					map->path);
+			rc = -ENODEV;
+			goto out;
+		}
+		map->devdax = true;
+		size = daxctl_dev_get_size(dev);
+		if (daxctl_dev_get_align(dev))
+			map->dev_align = daxctl_dev_get_align(dev);
+	} else if (S_ISREG(st.st_mode)) {
+		size = st.st_size;
+	} else {
+		fprintf(stderr, "%s: not a device-dax instance or a file\n",
+				map->path);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	if (!map->align)
+		map->align = size >= SZ_2M
+			? max(map->dev_align, (unsigned long) SZ_2M)
+			: map->dev_align;
+	if (map->align < map->dev_align) {
+		fprintf(stderr, "%s: align must be at least %#lx\n",
+				map->path, map->dev_align);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	if (map->size) {
+		if (map->size > size) {
+			fprintf(stderr, "%s: size exceeds %#llx capacity\n",
+					map->path, size);
+			rc = -EINVAL;
+			goto out;
+		}
+		size = map->size;
+	}
+	map->size = size / map->align * map->align;
+	if (!map->size) {
+		fprintf(stderr, "%s: smaller than the %#lx alignment\n",
+				map->path, map->align);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	map->addr = MAP_FAILED;
+#if HAVE_DECL_MAP_SYNC && HAVE_DECL_MAP_SHARED_VALIDATE
+	if (!map->devdax) {
+		map->addr = map_aligned(fd, map->size, map->align, 0,
+				MAP_SHARED_VALIDATE | MAP_SYNC);
+		map->sync = map->addr != MAP_FAILED;
+	}
+#endif
+	if (map->addr == MAP_FAILED)
+		map->addr = map_aligned(fd, map->size, map->align, 0,
+				MAP_SHARED);
+	if (map->addr == MAP_FAILED) {
+		rc = -errno;
+		fprintf(stderr, "failed to map %s: %s\n", map->path,
+				strerror(-rc));
+		goto out;
+	}
+	map->fd = fd;
+	return 0;
+out:
+	close(fd);
+	return rc;
+}
+
+static int parse_tests(const char *list, bool *tests)
+{
+	const char *p = list;
+	int i;
+
+	if (!list) {
+		for (i = 0; i < TEST_MAX; i++)
+			tests[i] = true;
+		return 0;
+	}
+
+	while (*p) {
+		size_t len = strchrnul(p, ',') - p;
+
+		for (i = 0; i < TEST_MAX; i++)
+			if (strlen(test_names[i]) == len
+					&& strncmp(p, test_names[i], len) == 0)
+				break;
+		if (i >= TEST_MAX) {
+			fprintf(stderr, "unknown test: '%.*s'\n", (int) len, p);
+			return -EINVAL;
+		}
+		tests[i] = true;
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+	return 0;
+}
+
+static struct json_object *bench_header(struct bench_map *map,
+		struct bench_run *run, unsigned long flags)
+{
+	struct json_object *jbench, *jobj;
+
+	jbench = json_object_new_object();
+	if (!jbench)
+		return NULL;
+
+	jobj = json_object_new_string(map->path);
+	if (jobj)
+		json_object_object_add(jbench, "path", jobj);
+	jobj = json_object_new_string(map->devdax ? "devdax" : "fsdax");
+	if (jobj)
+		json_object_object_add(jbench, "mode", jobj);
+	if (!map->devdax) {
+		jobj = json_object_new_boolean(map->sync);
+		if (jobj)
+			json_object_object_add(jbench, "map_sync", jobj);
+	}
+	jobj = util_json_object_size(map->size, flags);
+	if (jobj)
+		json_object_object_add(jbench, "size", jobj);
+	jobj = util_json_object_size(map->align, flags);
+	if (jobj)
+		json_object_object_add(jbench, "align", jobj);
+	jobj = util_json_object_size(run->block, flags);
+	if (jobj)
+		json_object_object_add(jbench, "block_size", jobj);
+	jobj = json_object_new_string(store_names[run->store]);
+	if (jobj)
+		json_object_object_add(jbench, "store", jobj);
+	jobj = json_object_new_int(run->num_workers);
+	if (jobj)
+		json_object_object_add(jbench, "threads", jobj);
+	if (run->cpus) {
+		jobj = json_object_new_int(param.numa_node);
+		if (jobj)
+			json_object_object_add(jbench, "numa_node", jobj);
+	}
+	return jbench;
+}
+
+int cmd_bench(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char * const u[] = {
+		"daxctl bench <device or file> [<options>]",
+		NULL
+	};
+	struct bench_map map = { 0 };
+	struct bench_run run = { 0 };
+	struct json_object *jbench, *jresults, *jresult;
+	bool tests[TEST_MAX] = { false };
+	unsigned long flags = 0;
+	char devpath[PATH_MAX];
+	cpu_set_t cpus;
+	int i, rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1) {
+		for (i = 1; i < argc; i++)
+			error("unknown extra parameter \"%s\"\n", argv[i]);
+		if (!argc)
+			error("specify a device-dax instance or a file on fsdax\n");
+		usage_with_options(u, options);
+	}
+
+	if (param.verbose)
+		daxctl_set_log_priority(ctx, LOG_DEBUG);
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+
+	map.path = argv[0];
+	if (strncmp(map.path, "dax", 3) == 0 && !strchr(map.path, '/')) {
+		snprintf(devpath, sizeof(devpath), "/dev/%s", map.path);
+		map.path = devpath;
+	}
+
+	if (param.align) {
+		map.align = parse_size64(param.align);
+		if (map.align != SZ_4K && map.align != SZ_2M
+				&& map.align != SZ_1G) {
+			error("align must be 4K, 2M, or 1G\n");
+			usage_with_options(u, options);
+		}
+	}
+
+	if (param.size) {
+		map.size = parse_size64(param.size);
+		if (map.size == ULLONG_MAX || !map.size) {
+			error("invalid size '%s'\n", param.size);
+			usage_with_options(u, options);
+		}
+	}
+
+	run.block = SZ_4K;
+	if (param.block_size) {
+		run.block = parse_size64(param.block_size);
+		if (run.block == ULONG_MAX || run.block < CACHELINE
+				|| run.block % CACHELINE) {
+			error("block size must be a multiple of %d\n",
+					CACHELINE);
+			usage_with_options(u, options);
+		}
+	}
+
+	run.store = STORE_REGULAR;
+	if (param.store) {
+		for (i = 0; i < (int) ARRAY_SIZE(store_names); i++)
+			if (strcmp(param.store, store_names[i]) == 0)
+				break;
+		if (i >= (int) ARRAY_SIZE(store_names)) {
+			error("unknown store flavour '%s'\n", param.store);
+			usage_with_options(u, options);
+		}
+		run.store = i;
+	}
+	rc = store_supported(run.store);
+	if (rc) {
+		error("'%s' stores are not supported on this cpu\n",
+				store_names[run.store]);
+		return rc;
+	}
+
+	if (parse_tests(param.tests, tests))
+		usage_with_options(u, options);
+	for (i = 0; i < TEST_MAX; i++)
+		if (tests[i] && test_writes(i) && !param.force) {
+			error("'%s' overwrites %s, use --force to proceed\n",
+					test_names[i], map.path);
+			return -EPERM;
+		}
+
+	if (!param.threads || !param.duration) {
+		error("--threads and --duration must be at least 1\n");
+		usage_with_options(u, options);
+	}
+	run.num_workers = param.threads;
+	run.duration_ns = param.duration * 1000000000ULL;
+
+	if (param.numa_node >= 0) {
+		rc = node_cpus(ctx, param.numa_node, &cpus);
+		if (rc) {
+			error("no cpus found for numa node %d: %s\n",
+					param.numa_node, strerror(-rc));
+			return rc;
+		}
+		run.cpus = &cpus;
+	}
+
+	rc = bench_map(ctx, &map);
+	if (rc)
+		return rc;
+	run.map = &map;
+	run.flags = flags;
+
+	run.barrier = mmap(NULL, sizeof(*run.barrier), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (run.barrier == MAP_FAILED) {
+		rc = -errno;
+		goto out;
+	}
+
+	jbench = bench_header(&map, &run, flags);
+	jresults = json_object_new_array();
+	if (!jbench || !jresults) {
+		json_object_put(jbench);
+		json_object_put(jresults);
+		rc = -ENOMEM;
+		goto out_barrier;
+	}
+	json_object_object_add(jbench, "results", jresults);
+
+	for (i = 0; i < TEST_MAX; i++) {
+		if (!tests[i])
+			continue;
+		run.test = i;
+		if (run.test == TEST_FAULT) {
+			if (bench_fault(&run, jresults))
+				rc = -ENXIO;
+			continue;
+		}
+		jresult = bench_one(&run);
+		if (!jresult) {
+			rc = -ENXIO;
+			continue;
+		}
+		json_object_array_add(jresults, jresult);
+	}
+
+	printf("%s\n", json_object_to_json_string_ext(jbench,
+				JSON_C_TO_STRING_PRETTY));
+	json_object_put(jbench);
+out_barrier:
+	munmap(run.barrier, sizeof(*run.barrier));
+out:
+	munmap(map.addr, map.size);
+	close(map.fd);
+	return rc;
+}
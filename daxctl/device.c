@@ -10,6 +10,8 @@
 #include <sys/types.h>
 #include <sys/sysmacros.h>
 #include <util/json.h>
+#include <util/size.h>
+#include <util/jobs.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <daxctl/libdaxctl.h>
@@ -20,11 +22,15 @@ static struct {
 	const char *dev;
 	const char *mode;
 	const char *region;
+	const char *size;
+	const char *align;
+	int target_node;
 	bool no_online;
 	bool no_movable;
 	bool force;
 	bool human;
 	bool verbose;
+	unsigned int jobs;
 } param;
 
 enum dev_mode {
@@ -46,12 +52,15 @@ enum device_action {
 	ACTION_RECONFIG,
 	ACTION_ONLINE,
 	ACTION_OFFLINE,
+	ACTION_DESTROY,
 };
 
 #define BASE_OPTIONS() \
 OPT_STRING('r', "region", &param.region, "region-id", "filter by region"), \
 OPT_BOOLEAN('u', "human", &param.human, "use human friendly number formats"), \
-OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages")
+OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+		"act on up to <n> numa nodes worth of devices in parallel")
 
 #define RECONFIG_OPTIONS() \
 OPT_STRING('m', "mode", &param.mode, "mode", "mode to switch the device to"), \
@@ -82,6 +91,28 @@ static const struct option offline_options[] = {
 	OPT_END(),
 };
 
+static const struct option destroy_options[] = {
+	BASE_OPTIONS(),
+	OPT_BOOLEAN('f', "force", &param.force,
+			"disable the device first if it is enabled in devdax mode"),
+	OPT_END(),
+};
+
+static const struct option create_options[] = {
+	OPT_STRING('r', "region", &param.region, "region-id",
+			"carve the device from this region"),
+	OPT_STRING('s', "size", &param.size, "size",
+			"size of the new device (default: all available)"),
+	OPT_STRING('a', "align", &param.align, "align",
+			"mapping alignment of the new device (4K, 2M, or 1G)"),
+	OPT_INTEGER('t', "target-node", &param.target_node,
+			"carve from a region on this numa node"),
+	OPT_BOOLEAN('u', "human", &param.human,
+			"use human friendly number formats"),
+	OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"),
+	OPT_END(),
+};
+
 static const char *parse_device_options(int argc, const char **argv,
 		enum device_action action, const struct option *options,
 		const char *usage, struct daxctl_ctx *ctx)
@@ -108,6 +139,9 @@ static const char *parse_device_options(int argc, const char **argv,
 		case ACTION_OFFLINE:
 			action_string = "offline memory for";
 			break;
+		case ACTION_DESTROY:
+			action_string = "destroy";
+			break;
 		default:
 			action_string = "<>";
 			break;
@@ -158,6 +192,7 @@ static const char *parse_device_options(int argc, const char **argv,
 			mem_zone = MEM_ZONE_NORMAL;
 		/* fall through */
 	case ACTION_OFFLINE:
+	case ACTION_DESTROY:
 		/* nothing special */
 		break;
 	}
@@ -434,7 +469,8 @@ static int do_reconfig(struct daxctl_dev *dev, enum dev_mode mode,
 	if (rc < 0)
 		return rc;
 
-	*jdevs = json_object_new_array();
+	if (!*jdevs)
+		*jdevs = json_object_new_array();
 	if (*jdevs) {
 		jdev = util_daxctl_dev_to_json(dev, flags);
 		if (jdev)
@@ -471,44 +507,245 @@ static int do_xline(struct daxctl_dev *dev, enum device_action action)
 	return rc;
 }
 
-static int do_xaction_device(const char *device, enum device_action action,
+/* returns 1 when @dev is the seed, which is skipped */
+static int do_destroy(struct daxctl_dev *dev)
+{
+	struct daxctl_region *region = daxctl_dev_get_region(dev);
+	const char *devname = daxctl_dev_get_devname(dev);
+	int rc;
+
+	/* the empty seed is where the next device is carved, leave it be */
+	if (!daxctl_dev_get_size(dev)
+			&& dev == daxctl_region_get_dev_seed(region))
+		return 1;
+
+	if (daxctl_dev_is_enabled(dev)) {
+		if (daxctl_dev_get_memory(dev)) {
+			fprintf(stderr,
+				"%s: in system-ram mode, reconfigure it to devdax first\n",
+				devname);
+			return -EBUSY;
+		}
+		if (!param.force) {
+			fprintf(stderr, "%s: is enabled, use --force to disable it\n",
+				devname);
+			return -EBUSY;
+		}
+		rc = daxctl_dev_disable(dev);
+		if (rc) {
+			fprintf(stderr, "%s: disable failed: %s\n", devname,
+				strerror(-rc));
+			return rc;
+		}
+	}
+
+	rc = daxctl_dev_set_size(dev, 0);
+	if (rc) {
+		fprintf(stderr, "%s: failed to release capacity: %s\n",
+			devname, strerror(-rc));
+		return rc;
+	}
+
+	rc = daxctl_region_destroy_dev(region, dev);
+	if (rc) {
+		fprintf(stderr, "%s: destroy failed: %s\n", devname,
+			strerror(-rc));
+		return rc;
+	}
+
+	return 0;
+}
+
+static int do_xaction_one(struct daxctl_dev *dev, enum device_action action,
+		struct json_object **jdevs)
+{
+	switch (action) {
+	case ACTION_RECONFIG:
+		return do_reconfig(dev, reconfig_mode, jdevs);
+	case ACTION_ONLINE:
+	case ACTION_OFFLINE:
+		return do_xline(dev, action);
+	case ACTION_DESTROY:
+		return do_destroy(dev);
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Devices that share a target node are handled in order by one job so
+ * that memory onlined by one device does not race the zone placement of
+ * the next. Independent nodes proceed in parallel.
+ */
+struct node_group {
+	int node;
+	enum device_action action;
+	struct daxctl_dev **devs;
+	int num_devs;
+};
+
+/* runs in a child, reports one json line per successfully handled device */
+static int xaction_node_group(void *arg, FILE *f_out)
+{
+	struct node_group *group = arg;
+	int i, rc, err = 0;
+
+	for (i = 0; i < group->num_devs; i++) {
+		struct daxctl_dev *dev = group->devs[i];
+		struct json_object *jdevs = NULL, *jdev;
+
+		rc = do_xaction_one(dev, group->action, &jdevs);
+		json_object_put(jdevs);
+		if (rc) {
+			if (rc < 0)
+				err = rc;
+			continue;
+		}
+
+		jdev = util_daxctl_dev_to_json(dev, flags);
+		fprintf(f_out, "%s\n", jdev ? json_object_to_json_string_ext(
+					jdev, JSON_C_TO_STRING_PLAIN) : "{}");
+		json_object_put(jdev);
+	}
+
+	return err;
+}
+
+static int do_xaction_parallel(const char *device, enum device_action action,
 		struct daxctl_ctx *ctx, int *processed)
 {
+	struct node_group *groups = NULL, *group;
 	struct json_object *jdevs = NULL;
+	struct util_job *jobs = NULL;
+	int num_groups = 0, i, j, rc;
 	struct daxctl_region *region;
 	struct daxctl_dev *dev;
+
+	daxctl_region_foreach(ctx, region) {
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+
+		daxctl_dev_foreach(region, dev) {
+			struct daxctl_dev **devs;
+			int node;
+
+			if (!util_daxctl_dev_filter(dev, device))
+				continue;
+
+			node = daxctl_dev_get_target_node(dev);
+			for (i = 0; i < num_groups; i++)
+				if (groups[i].node == node)
+					break;
+			if (i == num_groups) {
+				group = realloc(groups, (num_groups + 1)
+						* sizeof(*groups));
+				if (!group) {
+					rc = -ENOMEM;
+					goto out;
+				}
+				groups = group;
+				groups[num_groups++] = (struct node_group) {
+					.node = node,
+					.action = action,
+				};
+			}
+
+			group = &groups[i];
+			devs = realloc(group->devs, (group->num_devs + 1)
+					* sizeof(*devs));
+			if (!devs) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			group->devs = devs;
+			group->devs[group->num_devs++] = dev;
+		}
+	}
+
+	if (!num_groups) {
+		rc = -ENXIO;
+		goto out;
+	}
+
+	jobs = calloc(num_groups, sizeof(*jobs));
+	if (!jobs) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < num_groups; i++) {
+		jobs[i].run = xaction_node_group;
+		jobs[i].arg = &groups[i];
+	}
+
+	rc = util_jobs_run(jobs, num_groups, param.jobs);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < num_groups; i++) {
+		char *line, *save;
+
+		if (jobs[i].rc < 0)
+			rc = jobs[i].rc;
+
+		for (line = jobs[i].out ? strtok_r(jobs[i].out, "\n", &save)
+					: NULL; line;
+				line = strtok_r(NULL, "\n", &save)) {
+			struct json_object *jdev = json_tokener_parse(line);
+
+			(*processed)++;
+			if (action != ACTION_RECONFIG || !jdev) {
+				json_object_put(jdev);
+				continue;
+			}
+			if (!jdevs)
+				jdevs = json_object_new_array();
+			if (jdevs)
+				json_object_array_add(jdevs, jdev);
+			else
+				json_object_put(jdev);
+		}
+	}
+
+	if (jdevs)
+		util_display_json_array(stdout, jdevs, flags);
+out:
+	for (j = 0; jobs && j < num_groups; j++)
+		free(jobs[j].out);
+	for (j = 0; j < num_groups; j++)
+		free(groups[j].devs);
+	free(groups);
+	free(jobs);
+	return rc;
+}
+
+static int do_xaction_device(const char *device, enum device_action action,
+		struct daxctl_ctx *ctx, int *processed)
+{
+	struct json_object *jdevs = NULL;
+	struct daxctl_region *region;
+	struct daxctl_dev *dev, *_dev;
 	int rc = -ENXIO;
 
 	*processed = 0;
 
+	if (param.jobs > 1)
+		return do_xaction_parallel(device, action, ctx, processed);
+
 	daxctl_region_foreach(ctx, region) {
 		if (!util_daxctl_region_filter(region, param.region))
 			continue;
 
-		daxctl_dev_foreach(region, dev) {
+		/* destroy frees @dev */
+		daxctl_dev_foreach_safe(region, dev, _dev) {
 			if (!util_daxctl_dev_filter(dev, device))
 				continue;
 
-			switch (action) {
-			case ACTION_RECONFIG:
-				rc = do_reconfig(dev, reconfig_mode, &jdevs);
-				if (rc == 0)
-					(*processed)++;
-				break;
-			case ACTION_ONLINE:
-				rc = do_xline(dev, action);
-				if (rc == 0)
-					(*processed)++;
-				break;
-			case ACTION_OFFLINE:
-				rc = do_xline(dev, action);
-				if (rc == 0)
-					(*processed)++;
-				break;
-			default:
-				rc = -EINVAL;
-				break;
-			}
+			rc = do_xaction_one(dev, action, &jdevs);
+			if (rc == 0)
+				(*processed)++;
+			/* destroy skipped the seed, that is not a failure */
+			else if (rc > 0 && action == ACTION_DESTROY)
+				rc = 0;
 		}
 	}
 
@@ -573,3 +810,189 @@ int cmd_offline_memory(int argc, const char **argv, struct daxctl_ctx *ctx)
 			processed == 1 ? "" : "s");
 	return rc;
 }
+
+int cmd_destroy_device(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	char *usage = "daxctl destroy-device <device> [<options>]";
+	const char *device = parse_device_options(argc, argv, ACTION_DESTROY,
+			destroy_options, usage, ctx);
+	int processed, rc;
+
+	rc = do_xaction_device(device, ACTION_DESTROY, ctx, &processed);
+	if (rc < 0)
+		fprintf(stderr, "error destroying devices: %s\n",
+				strerror(-rc));
+
+	fprintf(stderr, "destroyed %d device%s\n", processed,
+			processed == 1 ? "" : "s");
+	return rc;
+}
+
+static int region_target_node(struct daxctl_region *region)
+{
+	struct daxctl_dev *dev = daxctl_dev_get_first(region);
+
+	return dev ? daxctl_dev_get_target_node(dev) : -1;
+}
+
+/*
+ * Pick the region to carve from: for a sized request the region with
+ * the least available space that still fits (keeping large regions free
+ * for large requests), otherwise the region with the most space.
+ */
+static struct daxctl_region *create_pick_region(struct daxctl_ctx *ctx,
+		unsigned long long size)
+{
+	struct daxctl_region *region, *best = NULL;
+	unsigned long long best_avail = 0;
+
+	daxctl_region_foreach(ctx, region) {
+		unsigned long long avail;
+
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+		if (param.target_node >= 0
+				&& region_target_node(region) != param.target_node)
+			continue;
+
+		avail = daxctl_region_get_available_size(region);
+		if (!avail || avail < size)
+			continue;
+
+		if (!best || (size ? avail < best_avail : avail > best_avail)) {
+			best = region;
+			best_avail = avail;
+		}
+	}
+
+	return best;
+}
+
+static int do_create(struct daxctl_region *region, unsigned long long size,
+		unsigned long align, struct json_object **jdevs)
+{
+	struct json_object *jdev;
+	struct daxctl_dev *dev;
+	const char *devname;
+	int rc;
+
+	rc = daxctl_region_create_dev(region);
+	if (rc)
+		return rc;
+
+	dev = daxctl_region_get_dev_seed(region);
+	if (!dev)
+		return -ENOSPC;
+	devname = daxctl_dev_get_devname(dev);
+
+	if (align) {
+		rc = daxctl_dev_set_align(dev, align);
+		if (rc) {
+			fprintf(stderr, "%s: failed to set align: %s\n",
+				devname, strerror(-rc));
+			goto err;
+		}
+	}
+
+	if (!align)
+		align = daxctl_dev_get_align(dev);
+	if (!size) {
+		size = daxctl_region_get_available_size(region);
+		if (align)
+			size = ALIGN_DOWN(size, align);
+	}
+	if (!size)
+		return -ENOSPC;
+
+	rc = daxctl_dev_set_size(dev, size);
+	if (rc) {
+		fprintf(stderr, "%s: failed to allocate %#llx: %s\n", devname,
+			size, strerror(-rc));
+		goto err;
+	}
+
+	rc = daxctl_dev_enable_devdax(dev);
+	if (rc) {
+		fprintf(stderr, "%s: enable failed: %s\n", devname,
+			strerror(-rc));
+		goto err;
+	}
+
+	*jdevs = json_object_new_array();
+	if (*jdevs) {
+		jdev = util_daxctl_dev_to_json(dev, flags);
+		if (jdev)
+			json_object_array_add(*jdevs, jdev);
+	}
+
+	return 0;
+err:
+	/* hand back any capacity taken, the seed is reused by the next create */
+	if (daxctl_dev_get_size(dev) && daxctl_dev_set_size(dev, 0))
+		fprintf(stderr, "%s: failed to release capacity\n", devname);
+	return rc;
+}
+
+int cmd_create_device(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char * const u[] = {
+		"daxctl create-device [<options>]",
+		NULL
+	};
+	unsigned long long size = 0, align = 0;
+	struct json_object *jdevs = NULL;
+	struct daxctl_region *region;
+	int i, rc;
+
+	param.target_node = -1;
+	argc = parse_options(argc, argv, create_options, u, 0);
+	for (i = 0; i < argc; i++)
+		error("unknown parameter \"%s\"\n", argv[i]);
+	if (argc)
+		usage_with_options(u, create_options);
+
+	if (param.verbose)
+		daxctl_set_log_priority(ctx, LOG_DEBUG);
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+
+	if (param.align) {
+		align = parse_size64(param.align);
+		if (align != SZ_4K && align != SZ_2M && align != SZ_1G) {
+			fprintf(stderr, "error: align must be 4K, 2M, or 1G\n");
+			usage_with_options(u, create_options);
+		}
+	}
+
+	if (param.size) {
+		size = parse_size64(param.size);
+		if (size == ULLONG_MAX || !size) {
+			fprintf(stderr, "error: invalid size '%s'\n",
+				param.size);
+			usage_with_options(u, create_options);
+		}
+		if (align && !IS_ALIGNED(size, align)) {
+			fprintf(stderr, "error: size must be a multiple of align\n");
+			usage_with_options(u, create_options);
+		}
+	}
+
+	region = create_pick_region(ctx, size);
+	if (!region) {
+		fprintf(stderr, "no region with %s available capacity%s\n",
+			size ? "enough" : "any",
+			param.target_node >= 0 ? " on the requested node" : "");
+		return -ENOSPC;
+	}
+
+	rc = do_create(region, size, align, &jdevs);
+	if (rc < 0) {
+		fprintf(stderr, "error creating devices: %s\n", strerror(-rc));
+		return rc;
+	}
+
+	if (jdevs)
+		util_display_json_array(stdout, jdevs, flags);
+	fprintf(stderr, "created 1 device\n");
+	return 0;
+}
@@ -24,8 +24,8 @@ enum dax_subsystem {
 };
 
 static const char *dax_subsystems[] = {
-	[DAX_CLASS] = "/sys/class/dax",
-	[DAX_BUS] = "/sys/bus/dax/devices",
+	[DAX_CLASS] = "class/dax",
+	[DAX_BUS] = "bus/dax/devices",
 };
 
 enum daxctl_dev_mode {
@@ -103,6 +103,7 @@ struct daxctl_dev {
 	struct daxctl_region *region;
 	struct daxctl_memory *mem;
 	int target_node;
+	unsigned long align;
 };
 
 struct daxctl_memory {
@@ -112,6 +113,10 @@ struct daxctl_memory {
 	char *node_path;
 	unsigned long block_size;
 	enum memory_zones zone;
+	unsigned long start_block;
+	unsigned long num_blocks;
+	unsigned long *present_map;
+	unsigned long *online_map;
 };
 
 
@@ -27,6 +27,7 @@
 #include <util/log.h>
 #include <util/sysfs.h>
 #include <util/iomem.h>
+#include <util/bitmap.h>
 #include <daxctl/libdaxctl.h>
 #include "libdaxctl-private.h"
 
@@ -50,6 +51,7 @@ struct daxctl_ctx {
 	int regions_init;
 	struct list_head regions;
 	struct kmod_ctx *kmod_ctx;
+	char *sysfs_root;
 };
 
 /**
@@ -90,12 +92,21 @@ DAXCTL_EXPORT int daxctl_new(struct daxctl_ctx **ctx)
 {
 	struct kmod_ctx *kmod_ctx;
 	struct daxctl_ctx *c;
+	const char *env;
 	int rc = 0;
 
 	c = calloc(1, sizeof(struct daxctl_ctx));
 	if (!c)
 		return -ENOMEM;
 
+	/* allow enumeration of a synthetic topology outside of /sys */
+	env = secure_getenv("DAXCTL_SYSFS_ROOT");
+	c->sysfs_root = strdup(env && env[0] ? env : "/sys");
+	if (!c->sysfs_root) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
 	kmod_ctx = kmod_new(NULL, NULL);
 	if (check_kmod(kmod_ctx) != 0) {
 		rc = -ENXIO;
@@ -106,12 +117,14 @@ DAXCTL_EXPORT int daxctl_new(struct daxctl_ctx **ctx)
 	log_init(&c->ctx, "libdaxctl", "DAXCTL_LOG");
 	info(c, "ctx %p created\n", c);
 	dbg(c, "log_priority=%d\n", c->ctx.log_priority);
+	dbg(c, "sysfs_root=%s\n", c->sysfs_root);
 	*ctx = c;
 	list_head_init(&c->regions);
 	c->kmod_ctx = kmod_ctx;
 
 	return 0;
 out:
+	free(c->sysfs_root);
 	free(c);
 	return rc;
 }
@@ -150,6 +163,7 @@ DAXCTL_EXPORT void daxctl_unref(struct daxctl_ctx *ctx)
 
 	kmod_unref(ctx->kmod_ctx);
 	info(ctx, "context %p released\n", ctx);
+	free(ctx->sysfs_root);
 	free(ctx);
 }
 
@@ -191,6 +205,43 @@ DAXCTL_EXPORT void daxctl_set_log_priority(struct daxctl_ctx *ctx, int priority)
 	ctx->ctx.log_priority = priority;
 }
 
+/**
+ * daxctl_get_sysfs_root - where the library enumerates sysfs
+ * @ctx: daxctl library context
+ *
+ * "/sys", unless overridden with the DAXCTL_SYSFS_ROOT environment
+ * variable or daxctl_set_sysfs_root().
+ */
+DAXCTL_EXPORT const char *daxctl_get_sysfs_root(struct daxctl_ctx *ctx)
+{
+	return ctx->sysfs_root;
+}
+
+/**
+ * daxctl_set_sysfs_root - enumerate sysfs below @root
+ * @ctx: daxctl library context
+ * @root: replacement for "/sys"
+ *
+ * Only valid before the first region is enumerated, so that all the
+ * objects of a context come from the same hierarchy.
+ */
+DAXCTL_EXPORT int daxctl_set_sysfs_root(struct daxctl_ctx *ctx,
+		const char *root)
+{
+	char *sysfs_root;
+
+	if (!list_empty(&ctx->regions))
+		return -EBUSY;
+
+	sysfs_root = strdup(root);
+	if (!sysfs_root)
+		return -ENOMEM;
+	free(ctx->sysfs_root);
+	ctx->sysfs_root = sysfs_root;
+	dbg(ctx, "sysfs_root=%s\n", ctx->sysfs_root);
+	return 0;
+}
+
 DAXCTL_EXPORT struct daxctl_ctx *daxctl_region_get_ctx(
 		struct daxctl_region *region)
 {
@@ -207,6 +258,8 @@ static void free_mem(struct daxctl_dev *dev)
 	if (dev->mem) {
 		free(dev->mem->node_path);
 		free(dev->mem->mem_buf);
+		free(dev->mem->present_map);
+		free(dev->mem->online_map);
 		free(dev->mem);
 		dev->mem = NULL;
 	}
@@ -339,21 +392,12 @@ static bool device_model_is_dax_bus(struct daxctl_dev *dev)
 {
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	char *path = dev->dev_buf, *resolved;
+	char *path = dev->dev_buf, *resolved, *dax_bus;
 	size_t len = dev->buf_len;
-	struct stat sb;
-
-	if (snprintf(path, len, "/dev/%s", devname) < 0)
-		return false;
-
-	if (lstat(path, &sb) < 0) {
-		err(ctx, "%s: stat for %s failed: %s\n",
-			devname, path, strerror(errno));
-		return false;
-	}
+	bool rc;
 
-	if (snprintf(path, len, "/sys/dev/char/%d:%d/subsystem",
-			major(sb.st_rdev), minor(sb.st_rdev)) < 0)
+	if (snprintf(path, len, "%s/dev/char/%d:%d/subsystem", ctx->sysfs_root,
+			dev->major, dev->minor) >= (int) len)
 		return false;
 
 	resolved = realpath(path, NULL);
@@ -363,13 +407,16 @@ static bool device_model_is_dax_bus(struct daxctl_dev *dev)
 		return false;
 	}
 
-	if (strcmp(resolved, "/sys/bus/dax") == 0) {
+	if (snprintf(path, len, "%s/bus/dax", ctx->sysfs_root) >= (int) len) {
 		free(resolved);
-		return true;
+		return false;
 	}
 
+	dax_bus = realpath(path, NULL);
+	rc = dax_bus && strcmp(resolved, dax_bus) == 0;
+	free(dax_bus);
 	free(resolved);
-	return false;
+	return rc;
 }
 
 static int dev_is_system_ram_capable(struct daxctl_dev *dev)
@@ -411,10 +458,9 @@ static int dev_is_system_ram_capable(struct daxctl_dev *dev)
  */
 static struct daxctl_memory *daxctl_dev_alloc_mem(struct daxctl_dev *dev)
 {
-	const char *size_path = "/sys/devices/system/memory/block_size_bytes";
-	const char *node_base = "/sys/devices/system/node/node";
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	char size_path[PATH_MAX], node_base[PATH_MAX];
 	struct daxctl_memory *mem;
 	char buf[SYSFS_ATTR_SIZE];
 	int node_num;
@@ -422,6 +468,12 @@ static struct daxctl_memory *daxctl_dev_alloc_mem(struct daxctl_dev *dev)
 	if (!dev_is_system_ram_capable(dev))
 		return NULL;
 
+	snprintf(size_path, sizeof(size_path),
+			"%s/devices/system/memory/block_size_bytes",
+			ctx->sysfs_root);
+	snprintf(node_base, sizeof(node_base), "%s/devices/system/node/node",
+			ctx->sysfs_root);
+
 	mem = calloc(1, sizeof(*mem));
 	if (!mem)
 		return NULL;
@@ -481,11 +533,16 @@ static void *add_dax_dev(void *parent, int id, const char *daxdev_base)
 	dev->id = id;
 	dev->region = region;
 
-	sprintf(path, "/dev/%s", devname);
-	if (stat(path, &st) < 0)
-		goto err_read;
-	dev->major = major(st.st_rdev);
-	dev->minor = minor(st.st_rdev);
+	/* prefer sysfs, the device node may not have been created yet */
+	sprintf(path, "%s/dev", daxdev_base);
+	if (sysfs_read_attr(ctx, path, buf) < 0
+			|| sscanf(buf, "%d:%d", &dev->major, &dev->minor) != 2) {
+		sprintf(path, "/dev/%s", devname);
+		if (stat(path, &st) < 0)
+			goto err_read;
+		dev->major = major(st.st_rdev);
+		dev->minor = minor(st.st_rdev);
+	}
 
 	sprintf(path, "%s/resource", daxdev_base);
 	if (sysfs_read_attr(ctx, path, buf) == 0)
@@ -513,6 +570,11 @@ static void *add_dax_dev(void *parent, int id, const char *daxdev_base)
 	else
 		dev->target_node = -1;
 
+	/* older kernels do not support per-device alignment */
+	sprintf(path, "%s/align", daxdev_base);
+	if (sysfs_read_attr(ctx, path, buf) == 0)
+		dev->align = strtoul(buf, NULL, 0);
+
 	daxctl_dev_foreach(region, dev_dup)
 		if (dev_dup->id == dev->id) {
 			free_dev(dev, NULL);
@@ -601,12 +663,72 @@ DAXCTL_EXPORT struct daxctl_dev *daxctl_region_get_dev_seed(
 	if (sysfs_read_attr(ctx, path, buf) < 0)
 		return NULL;
 
+	daxctl_dev_foreach(region, dev)
+		if (strcmp(buf, daxctl_dev_get_devname(dev)) == 0)
+			return dev;
+
+	/* the seed may have been created since the devices were listed */
+	region->devices_init = 0;
 	daxctl_dev_foreach(region, dev)
 		if (strcmp(buf, daxctl_dev_get_devname(dev)) == 0)
 			return dev;
 	return NULL;
 }
 
+/*
+ * daxctl_region_create_dev() - ask the region for a new zero-sized seed
+ * device, retrieve it with daxctl_region_get_dev_seed() and size it with
+ * daxctl_dev_set_size()
+ */
+DAXCTL_EXPORT int daxctl_region_create_dev(struct daxctl_region *region)
+{
+	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
+	char *path = region->region_buf;
+	int len = region->buf_len;
+
+	if (snprintf(path, len, "%s/%s/create", region->region_path,
+				attrs) >= len) {
+		err(ctx, "%s: buffer too small!\n",
+				daxctl_region_get_devname(region));
+		return -ENXIO;
+	}
+
+	return sysfs_write_attr(ctx, path, "1");
+}
+
+/*
+ * daxctl_region_destroy_dev() - delete a disabled device, @dev is freed
+ * on success, see daxctl_dev_foreach_safe()
+ */
+DAXCTL_EXPORT int daxctl_region_destroy_dev(struct daxctl_region *region,
+		struct daxctl_dev *dev)
+{
+	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
+	const char *devname = daxctl_dev_get_devname(dev);
+	char *path = region->region_buf;
+	int len = region->buf_len;
+	int rc;
+
+	if (daxctl_dev_is_enabled(dev)) {
+		err(ctx, "%s: must be disabled before it is destroyed\n",
+				devname);
+		return -EBUSY;
+	}
+
+	if (snprintf(path, len, "%s/%s/delete", region->region_path,
+				attrs) >= len) {
+		err(ctx, "%s: buffer too small!\n", devname);
+		return -ENXIO;
+	}
+
+	rc = sysfs_write_attr(ctx, path, devname);
+	if (rc)
+		return rc;
+
+	free_dev(dev, &region->devices);
+	return 0;
+}
+
 static void dax_devices_init(struct daxctl_region *region)
 {
 	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
@@ -638,11 +760,13 @@ static void dax_devices_init(struct daxctl_region *region)
 	}
 }
 
-static char *dax_region_path(const char *device, enum dax_subsystem subsys)
+static char *dax_region_path(struct daxctl_ctx *ctx, const char *device,
+		enum dax_subsystem subsys)
 {
 	char *path, *region_path, *c;
 
-	if (asprintf(&path, "%s/%s", dax_subsystems[subsys], device) < 0)
+	if (asprintf(&path, "%s/%s/%s", ctx->sysfs_root,
+				dax_subsystems[subsys], device) < 0)
 		return NULL;
 
 	/* dax_region must be the instance's direct parent */
@@ -678,13 +802,15 @@ static char *dax_region_path(const char *device, enum dax_subsystem subsys)
 
 static void __dax_regions_init(struct daxctl_ctx *ctx, enum dax_subsystem subsys)
 {
+	char path[PATH_MAX];
 	struct dirent *de;
 	DIR *dir = NULL;
 
-	dir = opendir(dax_subsystems[subsys]);
+	snprintf(path, sizeof(path), "%s/%s", ctx->sysfs_root,
+			dax_subsystems[subsys]);
+	dir = opendir(path);
 	if (!dir) {
-		dbg(ctx, "no dax regions found via: %s\n",
-				dax_subsystems[subsys]);
+		dbg(ctx, "no dax regions found via: %s\n", path);
 		return;
 	}
 
@@ -697,7 +823,7 @@ static void __dax_regions_init(struct daxctl_ctx *ctx, enum dax_subsystem subsys
 			continue;
 		if (sscanf(de->d_name, "dax%d.%d", &region_id, &id) != 2)
 			continue;
-		dev_path = dax_region_path(de->d_name, subsys);
+		dev_path = dax_region_path(ctx, de->d_name, subsys);
 		if (!dev_path) {
 			err(ctx, "dax region path allocation failure\n");
 			continue;
@@ -750,7 +876,7 @@ static int daxctl_bind(struct daxctl_ctx *ctx, const char *devname,
 		return -EINVAL;
 	}
 
-	if (snprintf(path, len, "/sys/bus/dax/drivers") >= len) {
+	if (snprintf(path, len, "%s/bus/dax/drivers", ctx->sysfs_root) >= len) {
 		err(ctx, "%s: buffer too small!\n", devname);
 		return -ENXIO;
 	}
@@ -1019,6 +1145,90 @@ DAXCTL_EXPORT unsigned long long daxctl_dev_get_size(struct daxctl_dev *dev)
 	return dev->size;
 }
 
+/*
+ * daxctl_dev_set_size() - allocate (or release, with @size == 0)
+ * capacity for a disabled device from its region's available space
+ */
+DAXCTL_EXPORT int daxctl_dev_set_size(struct daxctl_dev *dev,
+		unsigned long long size)
+{
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	char buf[SYSFS_ATTR_SIZE];
+	char *path = dev->dev_buf;
+	int len = dev->buf_len, rc;
+
+	if (daxctl_dev_is_enabled(dev)) {
+		err(ctx, "%s: must be disabled to change size\n", devname);
+		return -EBUSY;
+	}
+
+	if (dev->align && size % dev->align) {
+		err(ctx, "%s: size %#llx is not aligned to %#lx\n", devname,
+				size, dev->align);
+		return -EINVAL;
+	}
+
+	if (snprintf(path, len, "%s/size", dev->dev_path) >= len) {
+		err(ctx, "%s: buffer too small!\n", devname);
+		return -ENXIO;
+	}
+
+	sprintf(buf, "%#llx\n", size);
+	rc = sysfs_write_attr(ctx, path, buf);
+	if (rc)
+		return rc;
+	dev->size = size;
+
+	/* the allocation decides where the device lands */
+	if (snprintf(path, len, "%s/resource", dev->dev_path) < len
+			&& sysfs_read_attr(ctx, path, buf) == 0)
+		dev->resource = strtoull(buf, NULL, 0);
+	else
+		dev->resource = size ? iomem_get_dev_resource(ctx,
+				dev->dev_path) : 0;
+
+	return 0;
+}
+
+DAXCTL_EXPORT unsigned long daxctl_dev_get_align(struct daxctl_dev *dev)
+{
+	return dev->align;
+}
+
+/*
+ * daxctl_dev_set_align() - set the mapping granularity of a disabled,
+ * zero-sized device, so its capacity is carved at 2M or 1G boundaries
+ * and can be mapped with huge pages
+ */
+DAXCTL_EXPORT int daxctl_dev_set_align(struct daxctl_dev *dev,
+		unsigned long align)
+{
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	char buf[SYSFS_ATTR_SIZE];
+	char *path = dev->dev_buf;
+	int len = dev->buf_len, rc;
+
+	if (!align || (align & (align - 1))) {
+		err(ctx, "%s: invalid alignment %#lx\n", devname, align);
+		return -EINVAL;
+	}
+
+	if (snprintf(path, len, "%s/align", dev->dev_path) >= len) {
+		err(ctx, "%s: buffer too small!\n", devname);
+		return -ENXIO;
+	}
+
+	sprintf(buf, "%#lx\n", align);
+	rc = sysfs_write_attr(ctx, path, buf);
+	if (rc)
+		return rc;
+	dev->align = align;
+
+	return 0;
+}
+
 DAXCTL_EXPORT int daxctl_dev_get_target_node(struct daxctl_dev *dev)
 {
 	return dev->target_node;
@@ -1096,10 +1306,6 @@ static int online_one_memblock(struct daxctl_memory *mem, char *memblock,
 	if (rc < 0)
 		return -ENOMEM;
 
-	rc = memblock_is_online(mem, memblock);
-	if (rc)
-		return rc;
-
 	switch (zone) {
 	case MEM_ZONE_MOVABLE:
 	case MEM_ZONE_NORMAL:
@@ -1139,13 +1345,6 @@ static int offline_one_memblock(struct daxctl_memory *mem, char *memblock)
 	if (rc < 0)
 		return -ENOMEM;
 
-	/* if already offline, there is nothing to do */
-	rc = memblock_is_online(mem, memblock);
-	if (rc < 0)
-		return rc;
-	if (!rc)
-		return 1;
-
 	rc = sysfs_write_attr_quiet(ctx, path, mode);
 	if (rc) {
 		/* check if something raced us to offline (unlikely) */
@@ -1169,12 +1368,6 @@ static int memblock_find_zone(struct daxctl_memory *mem, char *memblock,
 	char *path = mem->mem_buf;
 	const char *node_path;
 
-	rc = memblock_is_online(mem, memblock);
-	if (rc < 0)
-		return rc;
-	if (rc == 0)
-		return -ENXIO;
-
 	node_path = daxctl_memory_get_node_path(mem);
 	if (!node_path)
 		return -ENXIO;
@@ -1209,44 +1402,28 @@ static int memblock_find_zone(struct daxctl_memory *mem, char *memblock,
 	return 0;
 }
 
-static int memblock_in_dev(struct daxctl_memory *mem, const char *memblock)
+/*
+ * Compute the memory block index range spanned by the device from its
+ * resource and the memory block size, rather than scanning the node
+ * directory and reading the phys_index of every block on the node.
+ */
+static int memblock_range_init(struct daxctl_memory *mem)
 {
-	const char *mem_base = "/sys/devices/system/memory/";
 	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
-	unsigned long long memblock_res, dev_start, dev_end;
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	int rc, path_len = mem->buf_len;
+	unsigned long long dev_start, dev_size;
+	unsigned long start_block, num_blocks;
 	unsigned long memblock_size;
-	char buf[SYSFS_ATTR_SIZE];
-	unsigned long phys_index;
-	char *path = mem->mem_buf;
-
-	if (snprintf(path, path_len, "%s/%s/phys_index",
-			mem_base, memblock) < 0)
-		return -ENXIO;
-
-	rc = sysfs_read_attr(ctx, path, buf);
-	if (rc == 0) {
-		phys_index = strtoul(buf, NULL, 16);
-		if (phys_index == 0 || phys_index == ULONG_MAX) {
-			rc = -errno;
-			err(ctx, "%s: %s: Unable to determine phys_index: %s\n",
-				devname, memblock, strerror(-rc));
-			return rc;
-		}
-	} else {
-		err(ctx, "%s: %s: Unable to determine phys_index: %s\n",
-			devname, memblock, strerror(-rc));
-		return rc;
-	}
 
 	dev_start = daxctl_dev_get_resource(dev);
 	if (!dev_start) {
 		err(ctx, "%s: Unable to determine resource\n", devname);
 		return -EACCES;
 	}
-	dev_end = dev_start + daxctl_dev_get_size(dev);
+	dev_size = daxctl_dev_get_size(dev);
+	if (!dev_size)
+		return -ENXIO;
 
 	memblock_size = daxctl_memory_get_block_size(mem);
 	if (!memblock_size) {
@@ -1254,43 +1431,125 @@ static int memblock_in_dev(struct daxctl_memory *mem, const char *memblock)
 			devname);
 		return -ENXIO;
 	}
-	memblock_res = phys_index * memblock_size;
 
-	if (memblock_res >= dev_start && memblock_res <= dev_end)
-		return 1;
+	start_block = dev_start / memblock_size;
+	num_blocks = (dev_start + dev_size - 1) / memblock_size
+		- start_block + 1;
+	if (mem->online_map && mem->start_block == start_block
+			&& mem->num_blocks == num_blocks)
+		return 0;
+
+	free(mem->present_map);
+	free(mem->online_map);
+	mem->present_map = bitmap_alloc(num_blocks);
+	mem->online_map = bitmap_alloc(num_blocks);
+	if (!mem->present_map || !mem->online_map) {
+		free(mem->present_map);
+		free(mem->online_map);
+		mem->present_map = NULL;
+		mem->online_map = NULL;
+		return -ENOMEM;
+	}
+	mem->start_block = start_block;
+	mem->num_blocks = num_blocks;
+
+	return 0;
+}
+
+static void memblock_name(struct daxctl_memory *mem, unsigned long idx,
+		char *buf, size_t len)
+{
+	snprintf(buf, len, "memory%lu", mem->start_block + idx);
+}
+
+/*
+ * Refresh the present and online state of every block in the device
+ * range in one pass. Blocks that are not linked under the target node
+ * (holes, or blocks not yet hot-added) are not present.
+ */
+static int memblock_map_refresh(struct daxctl_memory *mem)
+{
+	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	const char *node_path = daxctl_memory_get_node_path(mem);
+	int len = mem->buf_len, rc;
+	char buf[SYSFS_ATTR_SIZE];
+	char *path = mem->mem_buf;
+	unsigned long i;
+
+	rc = memblock_range_init(mem);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < mem->num_blocks; i++) {
+		bitmap_clear(mem->present_map, i, 1);
+		bitmap_clear(mem->online_map, i, 1);
+
+		if (snprintf(path, len, "%s/memory%lu/state", node_path,
+				mem->start_block + i) < 0)
+			return -ENOMEM;
+
+		rc = sysfs_read_attr(ctx, path, buf);
+		if (rc == -ENOENT)
+			continue;
+		if (rc) {
+			err(ctx, "%s: Failed to read %s: %s\n",
+				devname, path, strerror(-rc));
+			return rc;
+		}
+
+		bitmap_set(mem->present_map, i, 1);
+		if (strncmp(buf, "online", 6) == 0)
+			bitmap_set(mem->online_map, i, 1);
+	}
 
 	return 0;
 }
 
-static int op_for_one_memblock(struct daxctl_memory *mem, char *memblock,
+static int op_for_one_memblock(struct daxctl_memory *mem, unsigned long idx,
 		enum memory_op op, int *status)
 {
 	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	bool online = test_bit(idx, mem->online_map);
+	char memblock[32];
 	int rc;
 
+	memblock_name(mem, idx, memblock, sizeof(memblock));
+
 	switch (op) {
 	case MEM_SET_ONLINE:
-		return online_one_memblock(mem, memblock, MEM_ZONE_MOVABLE,
-				status);
 	case MEM_SET_ONLINE_NO_MOVABLE:
-		return online_one_memblock(mem, memblock, MEM_ZONE_NORMAL,
-				status);
+		/* if already online, there is nothing to do */
+		if (online)
+			return 1;
+		rc = online_one_memblock(mem, memblock,
+				op == MEM_SET_ONLINE ? MEM_ZONE_MOVABLE
+				: MEM_ZONE_NORMAL, status);
+		if (rc == 0)
+			bitmap_set(mem->online_map, idx, 1);
+		return rc;
 	case MEM_SET_OFFLINE:
-		return offline_one_memblock(mem, memblock);
+		/* if already offline, there is nothing to do */
+		if (!online)
+			return 1;
+		rc = offline_one_memblock(mem, memblock);
+		if (rc >= 0)
+			bitmap_clear(mem->online_map, idx, 1);
+		return rc;
 	case MEM_IS_ONLINE:
-		rc = memblock_is_online(mem, memblock);
-		if (rc < 0)
-			return rc;
 		/*
 		 * Retain the 'normal' semantics for if (memblock_is_online()),
 		 * but since count needs rc == 0, we'll just flip rc for this op
 		 */
-		return !rc;
+		return !online;
 	case MEM_COUNT:
 		return 0;
 	case MEM_GET_ZONE:
+		if (!online)
+			return -ENXIO;
 		return memblock_find_zone(mem, memblock, status);
 	}
 
@@ -1304,51 +1563,32 @@ static int daxctl_memory_op(struct daxctl_memory *mem, enum memory_op op)
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	int rc, count = 0, status_flags = 0;
-	const char *node_path;
-	struct dirent *de;
-	DIR *node_dir;
+	unsigned long i;
 
-	node_path = daxctl_memory_get_node_path(mem);
-	if (!node_path) {
+	if (!daxctl_memory_get_node_path(mem)) {
 		err(ctx, "%s: Failed to get node_path\n", devname);
 		return -ENXIO;
 	}
 
-	node_dir = opendir(node_path);
-	if (!node_dir)
-		return -errno;
-
-	errno = 0;
-	while ((de = readdir(node_dir)) != NULL) {
-		if (strncmp(de->d_name, "memory", 6) == 0) {
-			rc = memblock_in_dev(mem, de->d_name);
-			if (rc < 0)
-				goto out_dir;
-			if (rc == 0) /* memblock not in dev */
-				continue;
-			/* memblock is in dev, perform op */
-			rc = op_for_one_memblock(mem, de->d_name, op,
-					&status_flags);
-			if (rc < 0)
-				goto out_dir;
-			if (rc == 0)
-				count++;
-		}
-		errno = 0;
+	rc = memblock_map_refresh(mem);
+	if (rc)
+		return rc;
+
+	for (i = find_next_bit(mem->present_map, mem->num_blocks, 0);
+			i < mem->num_blocks;
+			i = find_next_bit(mem->present_map, mem->num_blocks,
+				i + 1)) {
+		rc = op_for_one_memblock(mem, i, op, &status_flags);
+		if (rc < 0)
+			return rc;
+		if (rc == 0)
+			count++;
 	}
 
 	if (status_flags & MEM_ST_ZONE_INCONSISTENT)
 		mem->zone = MEM_ZONE_UNKNOWN;
 
-	if (errno) {
-		rc = -errno;
-		goto out_dir;
-	}
-	rc = count;
-
-out_dir:
-	closedir(node_dir);
-	return rc;
+	return count;
 }
 
 /*
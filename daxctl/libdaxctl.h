@@ -37,6 +37,8 @@ void daxctl_set_log_fn(struct daxctl_ctx *ctx,
 int daxctl_get_log_priority(struct daxctl_ctx *ctx);
 void daxctl_set_log_priority(struct daxctl_ctx *ctx, int priority);
 void daxctl_set_userdata(struct daxctl_ctx *ctx, void *userdata);
+const char *daxctl_get_sysfs_root(struct daxctl_ctx *ctx);
+int daxctl_set_sysfs_root(struct daxctl_ctx *ctx, const char *root);
 void *daxctl_get_userdata(struct daxctl_ctx *ctx);
 
 struct daxctl_region;
@@ -57,6 +59,7 @@ const char *daxctl_region_get_devname(struct daxctl_region *region);
 const char *daxctl_region_get_path(struct daxctl_region *region);
 
 struct daxctl_dev *daxctl_region_get_dev_seed(struct daxctl_region *region);
+int daxctl_region_create_dev(struct daxctl_region *region);
 
 struct daxctl_dev;
 struct daxctl_dev *daxctl_dev_get_first(struct daxctl_region *region);
@@ -74,6 +77,11 @@ int daxctl_dev_disable(struct daxctl_dev *dev);
 int daxctl_dev_enable_devdax(struct daxctl_dev *dev);
 int daxctl_dev_enable_ram(struct daxctl_dev *dev);
 int daxctl_dev_get_target_node(struct daxctl_dev *dev);
+int daxctl_dev_set_size(struct daxctl_dev *dev, unsigned long long size);
+unsigned long daxctl_dev_get_align(struct daxctl_dev *dev);
+int daxctl_dev_set_align(struct daxctl_dev *dev, unsigned long align);
+int daxctl_region_destroy_dev(struct daxctl_region *region,
+		struct daxctl_dev *dev);
 
 struct daxctl_memory;
 struct daxctl_memory *daxctl_dev_get_memory(struct daxctl_dev *dev);
@@ -92,6 +100,13 @@ int daxctl_memory_online_no_movable(struct daxctl_memory *mem);
              dev != NULL; \
              dev = daxctl_dev_get_next(dev))
 
+#define daxctl_dev_foreach_safe(region, dev, _dev) \
+        for (dev = daxctl_dev_get_first(region), \
+             _dev = dev ? daxctl_dev_get_next(dev) : NULL; \
+             dev != NULL; \
+             dev = _dev, \
+             _dev = _dev ? daxctl_dev_get_next(_dev) : NULL)
+
 
 #define daxctl_region_foreach(ctx, region) \
         for (region = daxctl_region_get_first(ctx); \
@@ -27,6 +27,9 @@ static struct {
 	bool regions;
 	bool idle;
 	bool human;
+	bool ndjson;
+	bool csv;
+	const char *fields;
 } list;
 
 static unsigned long listopts_to_flags(void)
@@ -61,6 +64,186 @@ static int num_list_flags(void)
 	return list.regions + list.devs;
 }
 
+static struct json_object *region_field_id(void *region, unsigned long flags)
+{
+	return json_object_new_int(daxctl_region_get_id(region));
+}
+
+static struct json_object *region_field_size(void *region, unsigned long flags)
+{
+	unsigned long long size = daxctl_region_get_size(region);
+
+	if (size == ULLONG_MAX)
+		return NULL;
+	return util_json_object_size(size, flags);
+}
+
+static struct json_object *region_field_available_size(void *region,
+		unsigned long flags)
+{
+	unsigned long long size = daxctl_region_get_available_size(region);
+
+	if (size == ULLONG_MAX)
+		return NULL;
+	return util_json_object_size(size, flags);
+}
+
+static struct json_object *region_field_align(void *region,
+		unsigned long flags)
+{
+	unsigned long align = daxctl_region_get_align(region);
+
+	if (align == ULONG_MAX)
+		return NULL;
+	return json_object_new_int64(align);
+}
+
+static struct json_object *region_field_path(void *region,
+		unsigned long flags)
+{
+	return json_object_new_string(daxctl_region_get_path(region));
+}
+
+static const struct util_json_field region_fields[] = {
+	{ "id", region_field_id },
+	{ "size", region_field_size },
+	{ "available_size", region_field_available_size },
+	{ "align", region_field_align },
+	{ "path", region_field_path },
+};
+
+static struct json_object *dev_field_chardev(void *dev, unsigned long flags)
+{
+	return json_object_new_string(daxctl_dev_get_devname(dev));
+}
+
+static struct json_object *dev_field_region(void *dev, unsigned long flags)
+{
+	return json_object_new_int(daxctl_region_get_id(
+				daxctl_dev_get_region(dev)));
+}
+
+static struct json_object *dev_field_size(void *dev, unsigned long flags)
+{
+	return util_json_object_size(daxctl_dev_get_size(dev), flags);
+}
+
+static struct json_object *dev_field_target_node(void *dev,
+		unsigned long flags)
+{
+	int node = daxctl_dev_get_target_node(dev);
+
+	if (node < 0)
+		return NULL;
+	return json_object_new_int(node);
+}
+
+static struct json_object *dev_field_mode(void *dev, unsigned long flags)
+{
+	return json_object_new_string(daxctl_dev_get_memory(dev)
+			? "system-ram" : "devdax");
+}
+
+static struct json_object *dev_field_state(void *dev, unsigned long flags)
+{
+	return json_object_new_string(daxctl_dev_is_enabled(dev)
+			? "enabled" : "disabled");
+}
+
+static struct json_object *dev_field_major(void *dev, unsigned long flags)
+{
+	return json_object_new_int(daxctl_dev_get_major(dev));
+}
+
+static struct json_object *dev_field_minor(void *dev, unsigned long flags)
+{
+	return json_object_new_int(daxctl_dev_get_minor(dev));
+}
+
+static const struct util_json_field dev_fields[] = {
+	{ "chardev", dev_field_chardev },
+	{ "region", dev_field_region },
+	{ "size", dev_field_size },
+	{ "target_node", dev_field_target_node },
+	{ "mode", dev_field_mode },
+	{ "state", dev_field_state },
+	{ "major", dev_field_major },
+	{ "minor", dev_field_minor },
+};
+
+/*
+ * Flat output (--fields, --csv): one row per region or device, built
+ * only from the getters behind the requested fields.
+ */
+static int list_flat(struct daxctl_ctx *ctx, unsigned long flags,
+		enum util_json_stream_format format)
+{
+	const struct util_json_field **sel;
+	const struct util_json_field *table = dev_fields;
+	int table_len = ARRAY_SIZE(dev_fields);
+	const char *fields = "chardev,size,mode,state";
+	struct util_json_stream stream;
+	struct daxctl_region *region;
+	int num_sel, rc = 0;
+
+	if (list.regions && list.devs) {
+		error("--fields and --csv list one of --regions or --devices\n");
+		return -EINVAL;
+	}
+
+	if (list.regions) {
+		table = region_fields;
+		table_len = ARRAY_SIZE(region_fields);
+		fields = "id,size,available_size,align";
+	}
+	if (list.fields)
+		fields = list.fields;
+
+	sel = calloc(table_len, sizeof(*sel));
+	if (!sel)
+		return -ENOMEM;
+	num_sel = util_json_fields_parse(fields, table, table_len, sel,
+			table_len);
+	if (num_sel < 0) {
+		rc = num_sel;
+		goto out;
+	}
+
+	util_json_stream_init(&stream, stdout, flags, format);
+	daxctl_region_foreach(ctx, region) {
+		struct daxctl_dev *dev;
+
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+
+		if (list.regions) {
+			if (util_json_stream_add(&stream,
+					util_json_fields_to_json(region, sel,
+						num_sel, flags)))
+				fail("\n");
+			continue;
+		}
+
+		daxctl_dev_foreach(region, dev) {
+			if (!util_daxctl_dev_filter(dev, param.dev))
+				continue;
+			if (!list.idle && !daxctl_dev_get_size(dev))
+				continue;
+			if (util_json_stream_add(&stream,
+					util_json_fields_to_json(dev, sel,
+						num_sel, flags)))
+				fail("\n");
+		}
+	}
+	util_json_stream_end(&stream);
+
+	if (did_fail)
+		rc = -ENOMEM;
+out:
+	free(sel);
+	return rc;
+}
+
 int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 {
 	const struct option options[] = {
@@ -73,14 +256,20 @@ int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 		OPT_BOOLEAN('i', "idle", &list.idle, "include idle devices"),
 		OPT_BOOLEAN('u', "human", &list.human,
 				"use human friendly number formats "),
+		OPT_BOOLEAN('\0', "ndjson", &list.ndjson,
+				"emit one json object per line"),
+		OPT_BOOLEAN('\0', "csv", &list.csv,
+				"emit comma separated values"),
+		OPT_STRING('\0', "fields", &list.fields, "field list",
+				"list only these comma separated fields"),
 		OPT_END(),
 	};
 	const char * const u[] = {
 		"daxctl list [<options>]",
 		NULL
 	};
-	struct json_object *jregions = NULL;
-	struct json_object *jdevs = NULL;
+	enum util_json_stream_format format = UTIL_JSON_STREAM_ARRAY;
+	struct util_json_stream stream;
 	struct daxctl_region *region;
 	unsigned long list_flags;
 	int i;
@@ -102,37 +291,51 @@ int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 
 	list_flags = listopts_to_flags();
 
+	if (list.csv && list.ndjson) {
+		error("--csv and --ndjson are mutually exclusive\n");
+		usage_with_options(u, options);
+	}
+	if (list.csv)
+		format = UTIL_JSON_STREAM_CSV;
+	else if (list.ndjson)
+		format = UTIL_JSON_STREAM_NDJSON;
+
+	if (list.fields || list.csv)
+		return list_flat(ctx, list_flags, format);
+
+	util_json_stream_init(&stream, stdout, list_flags, format);
 	daxctl_region_foreach(ctx, region) {
-		struct json_object *jregion = NULL;
+		struct json_object *jdevs;
+		int j, len;
 
 		if (!util_daxctl_region_filter(region, param.region))
 			continue;
 
 		if (list.regions) {
-			if (!jregions) {
-				jregions = json_object_new_array();
-				if (!jregions) {
-					fail("\n");
-					continue;
-				}
-			}
-
-			jregion = util_daxctl_region_to_json(region,
-					param.dev, list_flags);
-			if (!jregion) {
+			if (util_json_stream_add(&stream,
+					util_daxctl_region_to_json(region,
+						param.dev, list_flags)))
 				fail("\n");
-				continue;
-			}
-			json_object_array_add(jregions, jregion);
-		} else if (list.devs)
-			jdevs = util_daxctl_devs_to_list(region, jdevs,
-					param.dev, list_flags);
-	}
+			continue;
+		} else if (!list.devs)
+			continue;
+
+		/* emit each device of the region as its own element */
+		jdevs = util_daxctl_devs_to_list(region, NULL, param.dev,
+				list_flags);
+		if (!jdevs)
+			continue;
+		len = json_object_array_length(jdevs);
+		for (j = 0; j < len; j++) {
+			struct json_object *jdev;
 
-	if (jregions)
-		util_display_json_array(stdout, jregions, list_flags);
-	else if (jdevs)
-		util_display_json_array(stdout, jdevs, list_flags);
+			jdev = json_object_array_get_idx(jdevs, j);
+			if (util_json_stream_add(&stream, json_object_get(jdev)))
+				fail("\n");
+		}
+		json_object_put(jdevs);
+	}
+	util_json_stream_end(&stream);
 
 	if (did_fail)
 		return -ENOMEM;
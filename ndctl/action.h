@@ -16,5 +16,7 @@ enum device_action {
 	ACTION_CLEAR,
 	ACTION_READ_INFOBLOCK,
 	ACTION_WRITE_INFOBLOCK,
+	ACTION_ZERO,
+	ACTION_SCAN,
 };
 #endif /* __NDCTL_ACTION_H__ */
@@ -6,17 +6,23 @@
 #include <unistd.h>
 #include "action.h"
 #include <syslog.h>
+#include <ndctl.h>
 #include <builtin.h>
 #include <util/json.h>
+#include <util/size.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <util/parse-options.h>
 #include <ndctl/libndctl.h>
+#include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
 
 static struct {
 	bool verbose;
 	unsigned int poll_interval;
+	const char *namespace;
+	const char *region;
+	const char *range;
 } param;
 
 
@@ -26,8 +32,18 @@ static struct {
 #define WAIT_OPTIONS() \
 	OPT_UINTEGER('p', "poll", &param.poll_interval, "poll interval (seconds)")
 
+#define TARGET_OPTIONS() \
+	OPT_STRING('n', "namespace", &param.namespace, "namespace-id", \
+		"scrub only the address range of <namespace-id>"), \
+	OPT_STRING('r', "region", &param.region, "region-id", \
+		"scrub only the address range of <region-id>"), \
+	OPT_STRING(0, "range", &param.range, "address,length", \
+		"scrub only the given system physical address range")
+
 static const struct option start_options[] = {
 	BASE_OPTIONS(),
+	TARGET_OPTIONS(),
+	WAIT_OPTIONS(),
 	OPT_END(),
 };
 
@@ -50,6 +66,345 @@ static int scrub_action(struct ndctl_bus *bus, enum device_action action)
 	}
 }
 
+static int range_cmp(const void *a, const void *b)
+{
+	const struct ndctl_range *ra = a, *rb = b;
+
+	if (ra->address < rb->address)
+		return -1;
+	return ra->address > rb->address;
+}
+
+/* sort @ranges and coalesce overlapping or adjacent records in place */
+static int merge_ranges(struct ndctl_range *ranges, int num)
+{
+	int i, n = 0;
+
+	if (!num)
+		return 0;
+
+	qsort(ranges, num, sizeof(*ranges), range_cmp);
+	for (i = 1; i < num; i++) {
+		struct ndctl_range *last = &ranges[n];
+
+		if (ranges[i].address <= last->address + last->length) {
+			last->length = max(last->length, ranges[i].address
+					+ ranges[i].length - last->address);
+			continue;
+		}
+		ranges[++n] = ranges[i];
+	}
+	return n + 1;
+}
+
+/*
+ * Scrub one pass starting at @address, wait for it to finish, and
+ * append the records that fall within the target to @records. Returns
+ * where to continue from, or @end when the target is covered.
+ */
+static int ars_scrub_pass(struct ndctl_bus *bus, unsigned long long address,
+		unsigned long long end, struct ndctl_range **records,
+		int *num_records, unsigned long long *next)
+{
+	const char *busname = ndctl_bus_get_provider(bus);
+	struct ndctl_cmd *cmd_cap, *cmd_start, *cmd_stat = NULL;
+	struct ndctl_range range, restart, *r;
+	unsigned int i, num;
+	int rc, overflow;
+
+	cmd_cap = ndctl_bus_cmd_new_ars_cap(bus, address, end - address);
+	if (!cmd_cap) {
+		error("%s: failed to create ars_cap cmd\n", busname);
+		return -ENOTTY;
+	}
+
+	rc = ndctl_cmd_submit_xlat(cmd_cap);
+	if (rc < 0) {
+		error("%s: ars_cap failed: %s\n", busname, strerror(-rc));
+		goto out_cap;
+	}
+
+	cmd_start = ndctl_bus_cmd_new_ars_start(cmd_cap, ND_ARS_PERSISTENT);
+	if (!cmd_start) {
+		error("%s: failed to create ars_start cmd\n", busname);
+		rc = -ENOTTY;
+		goto out_cap;
+	}
+
+	rc = ndctl_cmd_submit_xlat(cmd_start);
+	if (rc >= 0 && (ndctl_cmd_get_firmware_status(cmd_start)
+				& ARS_STATUS_MASK) == 6)
+		rc = -EBUSY;
+	else if (rc >= 0 && (ndctl_cmd_get_firmware_status(cmd_start)
+				& ARS_STATUS_MASK))
+		rc = -ENXIO;
+	ndctl_cmd_unref(cmd_start);
+	if (rc < 0) {
+		error("%s: ars_start failed: %s\n", busname,
+				rc == -EBUSY ? "scrub already in progress"
+				: strerror(-rc));
+		goto out_cap;
+	}
+
+	for (;;) {
+		ndctl_cmd_unref(cmd_stat);
+		cmd_stat = ndctl_bus_cmd_new_ars_status(cmd_cap);
+		if (!cmd_stat) {
+			error("%s: failed to create ars_status cmd\n", busname);
+			rc = -ENOTTY;
+			goto out_cap;
+		}
+
+		rc = ndctl_cmd_submit_xlat(cmd_stat);
+		if (rc >= 0 && (ndctl_cmd_get_firmware_status(cmd_stat)
+					& ARS_STATUS_MASK))
+			rc = -ENXIO;
+		if (rc < 0) {
+			error("%s: ars_status failed: %s\n", busname,
+					strerror(-rc));
+			goto out_stat;
+		}
+		if (!ndctl_cmd_ars_in_progress(cmd_stat))
+			break;
+		sleep(param.poll_interval ? param.poll_interval : 1);
+	}
+
+	if (ndctl_cmd_ars_stat_get_range(cmd_stat, &range) < 0
+			|| ndctl_cmd_ars_stat_get_restart(cmd_stat, &restart) < 0
+			|| range.address != address) {
+		error("%s: ars_status does not match the scrub started\n",
+				busname);
+		rc = -EBUSY;
+		goto out_stat;
+	}
+
+	num = ndctl_cmd_ars_num_records(cmd_stat);
+	r = realloc(*records, (*num_records + num) * sizeof(*r));
+	if (num && !r) {
+		rc = -ENOMEM;
+		goto out_stat;
+	}
+	*records = r;
+	for (i = 0; i < num; i++) {
+		unsigned long long start, last;
+
+		start = ndctl_cmd_ars_get_record_addr(cmd_stat, i);
+		last = start + ndctl_cmd_ars_get_record_len(cmd_stat, i);
+		start = max(start, address);
+		last = min(last, end);
+		if (start >= last)
+			continue;
+		r[(*num_records)++] = (struct ndctl_range) {
+			.address = start,
+			.length = last - start,
+		};
+	}
+
+	/*
+	 * Continue where the firmware asks to when it ran out of room for
+	 * records, or when it stopped short of the end of the target.
+	 */
+	overflow = ndctl_cmd_ars_stat_get_flag_overflow(cmd_stat) > 0;
+	*next = range.address + range.length;
+	if ((overflow || *next < end) && restart.length)
+		*next = restart.address;
+	if (*next >= end)
+		*next = end;
+	else if (*next <= address) {
+		error("%s: scrub made no progress at %#llx\n", busname,
+				address);
+		rc = -EIO;
+	}
+
+ out_stat:
+	ndctl_cmd_unref(cmd_stat);
+ out_cap:
+	ndctl_cmd_unref(cmd_cap);
+	return rc < 0 ? rc : 0;
+}
+
+static int ars_scrub_target(struct ndctl_bus *bus, const char *devname,
+		unsigned long long address, unsigned long long length,
+		struct json_object *jtargets)
+{
+	unsigned long long next, end = address + length;
+	struct json_object *jtarget, *jrecords = NULL, *jrecord, *jobj;
+	struct ndctl_range *records = NULL;
+	int i, rc = 0, num = 0, passes = 0;
+
+	for (next = address; next < end; passes++) {
+		rc = ars_scrub_pass(bus, next, end, &records, &num, &next);
+		if (rc < 0)
+			goto out;
+	}
+	num = merge_ranges(records, num);
+
+	rc = -ENOMEM;
+	jtarget = json_object_new_object();
+	if (!jtarget)
+		goto out;
+	json_object_array_add(jtargets, jtarget);
+
+	jobj = json_object_new_string(ndctl_bus_get_provider(bus));
+	if (jobj)
+		json_object_object_add(jtarget, "provider", jobj);
+	if (devname) {
+		jobj = json_object_new_string(devname);
+		if (jobj)
+			json_object_object_add(jtarget, "dev", jobj);
+	}
+	jobj = util_json_object_hex(address, 0);
+	if (jobj)
+		json_object_object_add(jtarget, "address", jobj);
+	jobj = util_json_object_size(length, 0);
+	if (jobj)
+		json_object_object_add(jtarget, "size", jobj);
+	jobj = json_object_new_int(passes);
+	if (jobj)
+		json_object_object_add(jtarget, "passes", jobj);
+	jobj = json_object_new_int(num);
+	if (jobj)
+		json_object_object_add(jtarget, "record_count", jobj);
+
+	if (num) {
+		jrecords = json_object_new_array();
+		if (!jrecords)
+			goto out;
+		json_object_object_add(jtarget, "records", jrecords);
+	}
+	for (i = 0; i < num; i++) {
+		jrecord = json_object_new_object();
+		if (!jrecord)
+			goto out;
+		json_object_array_add(jrecords, jrecord);
+		jobj = util_json_object_hex(records[i].address, 0);
+		if (jobj)
+			json_object_object_add(jrecord, "address", jobj);
+		jobj = json_object_new_int64(records[i].length);
+		if (jobj)
+			json_object_object_add(jrecord, "length", jobj);
+	}
+	rc = 0;
+ out:
+	free(records);
+	return rc;
+}
+
+static int parse_range(unsigned long long *address, unsigned long long *length)
+{
+	char *end;
+
+	*address = strtoull(param.range, &end, 0);
+	if (end == param.range || *end != ',')
+		return -EINVAL;
+	*length = parse_size64(end + 1);
+	if (*length == ULLONG_MAX || !*length)
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * Scrub the address ranges selected by --namespace, --region, and
+ * --range on the buses selected by @argv, rather than asking the kernel
+ * to scrub each bus end to end.
+ */
+static int scrub_targets(struct ndctl_ctx *ctx, int argc, const char **argv)
+{
+	unsigned long long address = 0, length = 0, start;
+	int i, rc = 0, success = 0, fail = 0;
+	struct ndctl_namespace *ndns;
+	struct json_object *jtargets;
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+
+	if (param.range && parse_range(&address, &length) < 0) {
+		error("invalid --range=%s, expected <address>,<length>\n",
+				param.range);
+		return -EINVAL;
+	}
+
+	jtargets = json_object_new_array();
+	if (!jtargets)
+		return -ENOMEM;
+
+	ndctl_bus_foreach(ctx, bus) {
+		bool range_found = false;
+
+		for (i = 0; i < argc; i++)
+			if (util_bus_filter(bus, argv[i]))
+				break;
+		if (i >= argc)
+			continue;
+
+		ndctl_region_foreach(bus, region) {
+			start = ndctl_region_get_resource(region);
+			if (start == ULLONG_MAX)
+				continue;
+
+			if (param.range && !range_found && address >= start
+					&& address < start
+					+ ndctl_region_get_size(region)) {
+				range_found = true;
+				rc = ars_scrub_target(bus, NULL, address,
+						length, jtargets);
+				if (rc == 0)
+					success++;
+				else if (!fail)
+					fail = rc;
+			}
+
+			if (param.region
+					&& util_region_filter(region, param.region)) {
+				rc = ars_scrub_target(bus,
+						ndctl_region_get_devname(region),
+						start, ndctl_region_get_size(region),
+						jtargets);
+				if (rc == 0)
+					success++;
+				else if (!fail)
+					fail = rc;
+			}
+
+			if (!param.namespace)
+				continue;
+
+			ndctl_namespace_foreach(region, ndns) {
+				const char *devname
+					= ndctl_namespace_get_devname(ndns);
+
+				if (!util_namespace_filter(ndns, param.namespace))
+					continue;
+				if (!ndctl_namespace_get_size(ndns))
+					continue;
+				start = ndctl_namespace_get_resource(ndns);
+				if (start == ULLONG_MAX) {
+					error("%s: unknown address range\n",
+							devname);
+					if (!fail)
+						fail = -ENXIO;
+					continue;
+				}
+				rc = ars_scrub_target(bus, devname, start,
+						ndctl_namespace_get_size(ndns),
+						jtargets);
+				if (rc == 0)
+					success++;
+				else if (!fail)
+					fail = rc;
+			}
+		}
+	}
+
+	if (success)
+		util_display_json_array(stdout, jtargets, 0);
+	else
+		json_object_put(jtargets);
+
+	if (success)
+		return success;
+	return fail ? fail : -ENXIO;
+}
+
 static int bus_action(int argc, const char **argv, const char *usage,
 		const struct option *options, enum device_action action,
 		struct ndctl_ctx *ctx)
@@ -79,6 +434,10 @@ static int bus_action(int argc, const char **argv, const char *usage,
 				break;
 			}
 
+	if (action == ACTION_START && (param.namespace || param.region
+				|| param.range))
+		return scrub_targets(ctx, argc, argv);
+
 	jbuses = json_object_new_array();
 	if (!jbuses)
 		return -ENOMEM;
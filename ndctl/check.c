@@ -22,6 +22,9 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <util/log.h>
 #include <uuid/uuid.h>
 #include <sys/types.h>
@@ -48,6 +51,7 @@ struct btt_chk {
 	char *path;
 	int fd;
 	uuid_t parent_uuid;
+	bool adopt_parent;
 	unsigned long long rawsize;
 	unsigned long long nlba;
 	int start_off;
@@ -308,13 +312,22 @@ static int btt_info_verify(struct btt_chk *bttc, struct btt_sb *btt_sb)
 	if (memcmp(btt_sb->signature, BTT_SIG, BTT_SIG_LEN) != 0)
 		return -ENXIO;
 
+	if (!verify_infoblock_checksum((union info_block *) btt_sb))
+		return -ENXIO;
+
+	/*
+	 * An image carries no namespace uuid to compare against, take the
+	 * one from the first valid info block and hold the rest to it.
+	 */
+	if (bttc->adopt_parent && !uuid_is_null(btt_sb->parent_uuid)) {
+		uuid_copy(bttc->parent_uuid, btt_sb->parent_uuid);
+		bttc->adopt_parent = false;
+	}
+
 	if (!uuid_is_null(btt_sb->parent_uuid))
 		if (uuid_compare(bttc->parent_uuid, btt_sb->parent_uuid) != 0)
 			return -ENXIO;
 
-	if (!verify_infoblock_checksum((union info_block *) btt_sb))
-		return -ENXIO;
-
 	return 0;
 }
 
@@ -1168,28 +1181,42 @@ static int btt_recover_first_sb(struct btt_chk *bttc)
 	return rc;
 }
 
-int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
-		bool repair, bool logfix)
+static int btt_get_size(struct btt_chk *bttc)
 {
-	const char *devname = ndctl_namespace_get_devname(ndns);
-	struct check_opts __opts = {
-		.verbose = verbose,
-		.force = force,
-		.repair = repair,
-		.logfix = logfix,
-	}, *opts = &__opts;
-	int raw_mode, rc, disabled_flag = 0, open_flags;
-	struct btt_sb *btt_sb;
-	struct btt_chk *bttc;
-	struct sigaction act;
-	char path[50];
-	int i;
+	unsigned long long size;
+	struct stat st;
 
-	bttc = calloc(1, sizeof(*bttc));
-	if (bttc == NULL)
-		return -ENOMEM;
+	if (fstat(bttc->fd, &st) < 0) {
+		err(bttc, "unable to stat %s: %s\n", bttc->path,
+			strerror(errno));
+		return -errno;
+	}
 
-	log_init(&bttc->ctx, devname, "NDCTL_CHECK_NAMESPACE");
+	if (S_ISBLK(st.st_mode)) {
+		if (ioctl(bttc->fd, BLKGETSIZE64, &size) < 0) {
+			err(bttc, "unable to get the size of %s: %s\n",
+				bttc->path, strerror(errno));
+			return -errno;
+		}
+	} else
+		size = st.st_size;
+
+	bttc->rawsize = size;
+	return 0;
+}
+
+/*
+ * btt_chk_init - common setup for checking a namespace or an image
+ * @bttc:	the main btt_chk structure for this btt
+ * @name:	prefix for the messages of the checker
+ * @opts:	check options, must outlive @bttc
+ */
+static int btt_chk_init(struct btt_chk *bttc, const char *name,
+		struct check_opts *opts)
+{
+	struct sigaction act;
+
+	log_init(&bttc->ctx, name, "NDCTL_CHECK_NAMESPACE");
 	if (opts->verbose)
 		bttc->ctx.log_priority = LOG_DEBUG;
 
@@ -1199,15 +1226,13 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 
 	if (sigaction(SIGBUS, &act, 0)) {
 		err(bttc, "Unable to set sigaction\n");
-		rc = -errno;
-		goto out_bttc;
+		return -errno;
 	}
 
 	if (opts->logfix) {
 		if (!opts->repair) {
 			err(bttc, "--rewrite-log also requires --repair\n");
-			rc = -EINVAL;
-			goto out_bttc;
+			return -EINVAL;
 		}
 		info(bttc,
 			"WARNING: interruption may cause unrecoverable metadata corruption\n");
@@ -1215,56 +1240,25 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 
 	bttc->opts = opts;
 	bttc->sys_page_size = sysconf(_SC_PAGESIZE);
-	bttc->rawsize = ndctl_namespace_get_size(ndns);
-	ndctl_namespace_get_uuid(ndns, bttc->parent_uuid);
-
-	info(bttc, "checking %s\n", devname);
-	if (ndctl_namespace_is_active(ndns)) {
-		if (opts->force) {
-			rc = ndctl_namespace_disable_safe(ndns);
-			if (rc)
-				goto out_bttc;
-			disabled_flag = 1;
-		} else {
-			err(bttc, "%s: check aborted, namespace online\n",
-				devname);
-			rc = -EBUSY;
-			goto out_bttc;
-		}
-	}
-
-	/* In typical usage, the current raw_mode should be false. */
-	raw_mode = ndctl_namespace_get_raw_mode(ndns);
-
-	/*
-	 * Putting the namespace into raw mode will allow us to access
-	 * the btt metadata.
-	 */
-	rc = ndctl_namespace_set_raw_mode(ndns, 1);
-	if (rc < 0) {
-		err(bttc, "%s: failed to set the raw mode flag: %s (%d)\n",
-			devname, strerror(abs(rc)), rc);
-		goto out_ns;
-	}
-	/*
-	 * Now enable the namespace.  This will result in a pmem device
-	 * node showing up in /dev that is in raw mode.
-	 */
-	rc = ndctl_namespace_enable(ndns);
-	if (rc != 0) {
-		err(bttc, "%s: failed to enable in raw mode: %s (%d)\n",
-			devname, strerror(abs(rc)), rc);
-		goto out_ns;
-	}
+	return 0;
+}
 
-	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
-	bttc->path = path;
+/*
+ * btt_check_path - check, and optionally repair, the BTT at bttc->path
+ *
+ * The path is either the block device of a namespace in raw mode, or
+ * an image of one. A zero bttc->rawsize is taken from the size of the
+ * file or block device.
+ */
+static int btt_check_path(struct btt_chk *bttc)
+{
+	struct btt_sb *btt_sb;
+	int rc, open_flags;
+	int i;
 
 	btt_sb = malloc(sizeof(*btt_sb));
-	if (btt_sb == NULL) {
-		rc = -ENOMEM;
-		goto out_ns;
-	}
+	if (btt_sb == NULL)
+		return -ENOMEM;
 
 	if (!bttc->opts->repair)
 		open_flags = O_RDONLY|O_EXCL;
@@ -1279,6 +1273,12 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 		goto out_sb;
 	}
 
+	if (!bttc->rawsize) {
+		rc = btt_get_size(bttc);
+		if (rc)
+			goto out_close;
+	}
+
 	/*
 	 * This is where we jump to if we receive a SIGBUS, prior to doing any
 	 * mmaped reads, and can safely abort
@@ -1342,6 +1342,77 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 	close(bttc->fd);
  out_sb:
 	free(btt_sb);
+	return rc;
+}
+
+int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
+		bool repair, bool logfix)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	struct check_opts __opts = {
+		.verbose = verbose,
+		.force = force,
+		.repair = repair,
+		.logfix = logfix,
+	}, *opts = &__opts;
+	int raw_mode, rc, disabled_flag = 0;
+	struct btt_chk *bttc;
+	char path[50];
+
+	bttc = calloc(1, sizeof(*bttc));
+	if (bttc == NULL)
+		return -ENOMEM;
+
+	rc = btt_chk_init(bttc, devname, opts);
+	if (rc)
+		goto out_bttc;
+
+	bttc->rawsize = ndctl_namespace_get_size(ndns);
+	ndctl_namespace_get_uuid(ndns, bttc->parent_uuid);
+
+	info(bttc, "checking %s\n", devname);
+	if (ndctl_namespace_is_active(ndns)) {
+		if (opts->force) {
+			rc = ndctl_namespace_disable_safe(ndns);
+			if (rc)
+				goto out_bttc;
+			disabled_flag = 1;
+		} else {
+			err(bttc, "%s: check aborted, namespace online\n",
+				devname);
+			rc = -EBUSY;
+			goto out_bttc;
+		}
+	}
+
+	/* In typical usage, the current raw_mode should be false. */
+	raw_mode = ndctl_namespace_get_raw_mode(ndns);
+
+	/*
+	 * Putting the namespace into raw mode will allow us to access
+	 * the btt metadata.
+	 */
+	rc = ndctl_namespace_set_raw_mode(ndns, 1);
+	if (rc < 0) {
+		err(bttc, "%s: failed to set the raw mode flag: %s (%d)\n",
+			devname, strerror(abs(rc)), rc);
+		goto out_ns;
+	}
+	/*
+	 * Now enable the namespace.  This will result in a pmem device
+	 * node showing up in /dev that is in raw mode.
+	 */
+	rc = ndctl_namespace_enable(ndns);
+	if (rc != 0) {
+		err(bttc, "%s: failed to enable in raw mode: %s (%d)\n",
+			devname, strerror(abs(rc)), rc);
+		goto out_ns;
+	}
+
+	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
+	bttc->path = path;
+
+	rc = btt_check_path(bttc);
  out_ns:
 	ndctl_namespace_set_raw_mode(ndns, raw_mode);
 	ndctl_namespace_disable_invalidate(ndns);
@@ -1353,3 +1424,40 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 	free(bttc);
 	return rc;
 }
+
+/*
+ * namespace_check_file - check the BTT in an image of a raw namespace
+ * @path:	a file or block device holding a copy of the raw namespace,
+ *		e.g. a 'dd' copy or a block level snapshot
+ *
+ * Runs the same checks, and with @repair the same repairs, as
+ * namespace_check(), without access to the namespace itself.
+ */
+int namespace_check_file(const char *path, bool verbose, bool repair,
+		bool logfix)
+{
+	struct check_opts __opts = {
+		.verbose = verbose,
+		.repair = repair,
+		.logfix = logfix,
+	}, *opts = &__opts;
+	struct btt_chk *bttc;
+	int rc;
+
+	bttc = calloc(1, sizeof(*bttc));
+	if (bttc == NULL)
+		return -ENOMEM;
+
+	rc = btt_chk_init(bttc, path, opts);
+	if (rc)
+		goto out_bttc;
+
+	bttc->path = (char *) path;
+	bttc->adopt_parent = true;
+
+	info(bttc, "checking %s\n", path);
+	rc = btt_check_path(bttc);
+ out_bttc:
+	free(bttc);
+	return rc;
+}
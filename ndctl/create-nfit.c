@@ -11,6 +11,8 @@
  * General Public License for more details.
  */
 #include <stdio.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -28,6 +30,39 @@
 static const char *nfit_file = DEFAULT_NFIT;
 static LIST_HEAD(spas);
 
+/*
+ * Generated topology: @dimms NVDIMMs of @dimm_size each, grouped into
+ * interleave sets of @ways DIMMs that are each backed by a persistent
+ * memory SPA range starting at @base, followed by one page of flush
+ * hint addresses per DIMM.
+ */
+static struct parameters {
+	unsigned int dimms;
+	unsigned int ways;
+	unsigned int flush_hints;
+	const char *dimm_size;
+	const char *line_size;
+	const char *base;
+} param = {
+	.ways = 1,
+	.flush_hints = 1,
+	.dimm_size = "16G",
+	.line_size = "4K",
+	.base = "1T",
+};
+
+static struct topology {
+	unsigned long long dimm_size;
+	unsigned long long line_size;
+	unsigned long long base;
+	unsigned int sets;
+} topo;
+
+#define DIMMS_PER_SOCKET 12
+/* the socket field of the device handle is 4 bits */
+#define MAX_DIMMS (16 * DIMMS_PER_SOCKET)
+#define MAX_FLUSH_HINTS (SZ_4K / 64)
+
 struct spa {
 	struct list_node list;
 	unsigned long long size, offset;
@@ -85,9 +120,9 @@ static void writeq(unsigned long long v, void *a)
 	*p = htole64(v);
 }
 
-static void writel(unsigned long v, void *a)
+static void writel(unsigned int v, void *a)
 {
-	unsigned long *p = a;
+	unsigned int *p = a;
 
 	*p = htole32(v);
 }
@@ -106,6 +141,213 @@ static void writeb(unsigned char v, void *a)
 	*p = v;
 }
 
+/*
+ * Intel style device handle: dimm[3:0], channel[7:4], memory
+ * controller[11:8], socket[15:12], with 2 DIMMs per channel and 3
+ * channels per memory controller.
+ */
+static unsigned int dimm_handle(unsigned int dimm)
+{
+	unsigned int socket = dimm / DIMMS_PER_SOCKET;
+
+	dimm %= DIMMS_PER_SOCKET;
+	return socket << 12 | (dimm / 6) << 8 | (dimm / 2 % 3) << 4 | dimm % 2;
+}
+
+static bool ranges_overlap(unsigned long long a, unsigned long long a_len,
+		unsigned long long b, unsigned long long b_len)
+{
+	return a < b + b_len && b < a + a_len;
+}
+
+static int validate_topology(void)
+{
+	unsigned long long set_size, len;
+	unsigned int num_spas = 0;
+	struct spa *s;
+
+	if (!param.dimms)
+		return 0;
+
+	if (param.dimms > MAX_DIMMS) {
+		error("at most %d --dimms\n", MAX_DIMMS);
+		return -EINVAL;
+	}
+
+	topo.dimm_size = parse_size64(param.dimm_size);
+	topo.line_size = parse_size64(param.line_size);
+	topo.base = parse_size64(param.base);
+	if (topo.dimm_size == ULLONG_MAX || !topo.dimm_size) {
+		error("invalid --dimm-size=%s\n", param.dimm_size);
+		return -EINVAL;
+	}
+	if (topo.line_size == ULLONG_MAX || topo.line_size < 256
+			|| topo.line_size > UINT_MAX
+			|| (topo.line_size & (topo.line_size - 1))) {
+		error("--line-size must be a power of 2 from 256 to 2G\n");
+		return -EINVAL;
+	}
+	if (topo.base == ULLONG_MAX || !IS_ALIGNED(topo.base, SZ_4K)) {
+		error("invalid --base=%s\n", param.base);
+		return -EINVAL;
+	}
+	if (!param.ways || param.dimms % param.ways) {
+		error("--dimms must be a multiple of --interleave-ways\n");
+		return -EINVAL;
+	}
+	if (param.ways > 1 && topo.dimm_size % topo.line_size) {
+		error("--dimm-size must be a multiple of --line-size\n");
+		return -EINVAL;
+	}
+	if (param.flush_hints > MAX_FLUSH_HINTS) {
+		error("at most %d --flush-hints per DIMM\n", MAX_FLUSH_HINTS);
+		return -EINVAL;
+	}
+	topo.sets = param.dimms / param.ways;
+
+	/* range, physical id and control region indexes are 16 bits */
+	list_for_each(&spas, s, list)
+		num_spas++;
+	if (num_spas + topo.sets > USHRT_MAX) {
+		error("too many SPA ranges\n");
+		return -EINVAL;
+	}
+
+	/* the interleave sets, followed by a flush hint page per DIMM */
+	set_size = topo.dimm_size * param.ways;
+	if (set_size / param.ways != topo.dimm_size
+			|| set_size > (ULLONG_MAX - SZ_4K * MAX_DIMMS)
+				/ topo.sets) {
+		error("--dimm-size is too large\n");
+		return -EINVAL;
+	}
+	len = set_size * topo.sets + (unsigned long long) SZ_4K * param.dimms;
+	if (topo.base > ULLONG_MAX - len) {
+		error("--base is too large for the topology\n");
+		return -EINVAL;
+	}
+
+	list_for_each(&spas, s, list)
+		if (ranges_overlap(s->offset, s->size, topo.base, len)) {
+			error("--add-spa=%#llx,%#llx overlaps the generated range %#llx-%#llx\n",
+					s->size, s->offset, topo.base,
+					topo.base + len - 1);
+			return -EINVAL;
+		}
+
+	return 0;
+}
+
+static size_t idt_size(void)
+{
+	return sizeof(struct nfit_idt) + sizeof(uint32_t);
+}
+
+static size_t flush_size(void)
+{
+	return sizeof(struct nfit_flush)
+		+ param.flush_hints * sizeof(uint64_t);
+}
+
+static void write_spa(struct nfit_spa *nfit_spa, int range_index,
+		unsigned long long base, unsigned long long size)
+{
+	writew(NFIT_TABLE_SPA, &nfit_spa->type);
+	writew(sizeof(*nfit_spa), &nfit_spa->length);
+	nfit_spa_uuid_pm(&nfit_spa->type_uuid);
+	writew(range_index, &nfit_spa->range_index);
+	writeq(base, &nfit_spa->spa_base);
+	writeq(size, &nfit_spa->spa_length);
+}
+
+/* append the generated tables at @buf, return the end of the tables */
+static char *create_topology(char *buf, int first_range)
+{
+	unsigned long long set_size = topo.dimm_size * param.ways;
+	unsigned long long flush_base = topo.base + set_size * topo.sets;
+	unsigned int set, i, j;
+
+	for (set = 0; set < topo.sets; set++) {
+		struct nfit_spa *nfit_spa = (struct nfit_spa *) buf;
+		unsigned int socket = set * param.ways / DIMMS_PER_SOCKET;
+
+		write_spa(nfit_spa, first_range + set,
+				topo.base + set * set_size, set_size);
+		writew(NFIT_SPA_PROXIMITY_VALID, &nfit_spa->flags);
+		writel(socket, &nfit_spa->proximity_domain);
+		buf += sizeof(*nfit_spa);
+	}
+
+	for (i = 0; i < param.dimms; i++) {
+		struct nfit_mem *mem = (struct nfit_mem *) buf;
+		unsigned int pos = i % param.ways;
+
+		set = i / param.ways;
+
+		writew(NFIT_TABLE_MEM, &mem->type);
+		writew(sizeof(*mem), &mem->length);
+		writel(dimm_handle(i), &mem->device_handle);
+		writew(i, &mem->physical_id);
+		writew(first_range + set, &mem->spa_index);
+		writew(i + 1, &mem->dcr_index);
+		writeq(topo.dimm_size, &mem->region_size);
+		if (param.ways > 1) {
+			writeq(pos * topo.line_size, &mem->region_offset);
+			writew(set + 1, &mem->idt_index);
+		}
+		writew(param.ways, &mem->interleave_ways);
+		buf += sizeof(*mem);
+	}
+
+	for (set = 0; param.ways > 1 && set < topo.sets; set++) {
+		struct nfit_idt *idt = (struct nfit_idt *) buf;
+
+		writew(NFIT_TABLE_IDT, &idt->type);
+		writew(idt_size(), &idt->length);
+		writew(set + 1, &idt->interleave_index);
+		writel(1, &idt->line_count);
+		writel(topo.line_size, &idt->line_size);
+		writel(0, &idt->line_offset[0]);
+		buf += idt_size();
+	}
+
+	for (i = 0; i < param.dimms; i++) {
+		struct nfit_dcr *dcr = (struct nfit_dcr *) buf;
+
+		writew(NFIT_TABLE_DCR, &dcr->type);
+		writew(sizeof(*dcr), &dcr->length);
+		writew(i + 1, &dcr->dcr_index);
+		writew(0x8086, &dcr->vendor_id);
+		writew(0x097a, &dcr->device_id);
+		writew(0x0001, &dcr->revision_id);
+		writew(0x8086, &dcr->sub_vendor_id);
+		writew(0x097a, &dcr->sub_device_id);
+		writew(0x0001, &dcr->sub_revision_id);
+		writeb(NFIT_DCR_MFG_VALID, &dcr->valid_fields);
+		writeb(0x01, &dcr->manufacturing_location);
+		writew(0x1918, &dcr->manufacturing_date);
+		writel(0x10000 + i, &dcr->serial_number);
+		/* byte addressable, energy backed */
+		writew(0x0201, &dcr->code);
+		buf += sizeof(*dcr);
+	}
+
+	for (i = 0; param.flush_hints && i < param.dimms; i++) {
+		struct nfit_flush *flush = (struct nfit_flush *) buf;
+
+		writew(NFIT_TABLE_FLUSH, &flush->type);
+		writew(flush_size(), &flush->length);
+		writel(dimm_handle(i), &flush->device_handle);
+		writew(param.flush_hints, &flush->hint_count);
+		for (j = 0; j < param.flush_hints; j++)
+			writeq(flush_base + i * SZ_4K + j * 64,
+					&flush->hint_address[j]);
+		buf += flush_size();
+	}
+
+	return buf;
+}
+
 static struct nfit *create_nfit(struct list_head *spa_list)
 {
 	struct nfit_spa *nfit_spa;
@@ -118,6 +360,13 @@ static struct nfit *create_nfit(struct list_head *spa_list)
 	size = sizeof(struct nfit);
 	list_for_each(spa_list, s, list)
 		size += sizeof(struct nfit_spa);
+	size += topo.sets * sizeof(struct nfit_spa);
+	size += param.dimms * (sizeof(struct nfit_mem)
+			+ sizeof(struct nfit_dcr));
+	if (param.ways > 1)
+		size += topo.sets * idt_size();
+	if (param.flush_hints)
+		size += param.dimms * flush_size();
 
 	buf = calloc(1, size);
 	if (!buf)
@@ -137,15 +386,13 @@ static struct nfit *create_nfit(struct list_head *spa_list)
 	nfit_spa = (struct nfit_spa *) (buf + sizeof(*nfit));
 	i = 1;
 	list_for_each(spa_list, s, list) {
-		writew(NFIT_TABLE_SPA, &nfit_spa->type);
-		writew(sizeof(*nfit_spa), &nfit_spa->length);
-		nfit_spa_uuid_pm(&nfit_spa->type_uuid);
-		writew(i++, &nfit_spa->range_index);
-		writeq(s->offset, &nfit_spa->spa_base);
-		writeq(s->size, &nfit_spa->spa_length);
+		write_spa(nfit_spa, i++, s->offset, s->size);
 		nfit_spa++;
 	}
 
+	if (param.dimms)
+		create_topology((char *) nfit_spa, i);
+
 	writeb(nfit_checksum(buf, size), &nfit->checksum);
 
 	return nfit;
@@ -190,6 +437,18 @@ int cmd_create_nfit(int argc, const char **argv, struct ndctl_ctx *ctx)
 	OPT_STRING('o', NULL, &nfit_file, "file",
 			"output to <file> (default: " DEFAULT_NFIT ")"),
 	OPT_INCR('f', "force", &force, "overwrite <file> if it already exists"),
+	OPT_UINTEGER('d', "dimms", &param.dimms,
+			"generate a topology of this many DIMMs (at most 192)"),
+	OPT_STRING('s', "dimm-size", &param.dimm_size, "size",
+			"capacity of each generated DIMM (default: 16G)"),
+	OPT_UINTEGER('w', "interleave-ways", &param.ways,
+			"DIMMs per interleave set (default: 1)"),
+	OPT_STRING('l', "line-size", &param.line_size, "size",
+			"interleave granularity (default: 4K)"),
+	OPT_UINTEGER('F', "flush-hints", &param.flush_hints,
+			"flush hint addresses per DIMM (default: 1)"),
+	OPT_STRING('b', "base", &param.base, "address",
+			"start of the generated address ranges (default: 1T)"),
 	OPT_END(),
 	};
 	struct spa *s, *_s;
@@ -199,12 +458,17 @@ int cmd_create_nfit(int argc, const char **argv, struct ndctl_ctx *ctx)
 
 	for (i = 0; i < argc; i++)
 		error("unknown parameter \"%s\"\n", argv[i]);
-	if (list_empty(&spas))
-		error("specify at least one --add-spa= option\n");
+	if (list_empty(&spas) && !param.dimms)
+		error("specify at least one --add-spa= or --dimms= option\n");
 
-	if (argc || list_empty(&spas))
+	if (argc || (list_empty(&spas) && !param.dimms))
 		usage_with_options(u, options);
 
+	rc = validate_topology();
+	if (rc)
+		goto out;
+	rc = -ENXIO;
+
 	nfit = create_nfit(&spas);
 	if (!nfit)
 		goto out;
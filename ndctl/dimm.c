@@ -15,10 +15,13 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
 #include <unistd.h>
+#include <time.h>
 #include <limits.h>
 #include <syslog.h>
 #include <util/log.h>
+#include <util/clock.h>
 #include <util/size.h>
 #include <uuid/uuid.h>
 #include <util/json.h>
@@ -30,6 +33,7 @@
 #include <util/parse-options.h>
 #include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
+#include <ccan/list/list.h>
 #include <ndctl/firmware-update.h>
 #include <util/keys.h>
 
@@ -39,6 +43,8 @@ struct action_context {
 	FILE *f_out;
 	FILE *f_in;
 	struct update_context update;
+	struct list_head overwrites;
+	int num_overwrites;
 };
 
 static struct parameters {
@@ -51,6 +57,7 @@ static struct parameters {
 	unsigned offset;
 	bool crypto_erase;
 	bool overwrite;
+	bool wait;
 	bool zero_key;
 	bool master_pass;
 	bool human;
@@ -680,72 +687,78 @@ out:
 	return rc;
 }
 
-static int query_fw_finish_status(struct ndctl_dimm *dimm,
+/*
+ * A DIMM that has received a new image and is waiting for its
+ * firmware to finish verifying it. Queries for all DIMMs being updated
+ * are driven from a single loop, see query_fw_finish_all().
+ */
+struct fw_query {
+	struct list_node list;
+	struct ndctl_dimm *dimm;
+	struct ndctl_cmd *start;
+	struct ndctl_cmd *cmd;
+	unsigned long long interval;
+	unsigned long long next;
+	unsigned long long expire;
+};
+
+static int queue_fw_finish_query(struct ndctl_dimm *dimm,
 		struct action_context *actx)
 {
 	struct update_context *uctx = &actx->update;
 	struct fw_info *fw = &uctx->dimm_fw;
-	struct ndctl_cmd *cmd;
-	int rc;
-	enum ND_FW_STATUS status;
-	struct timespec now, before, after;
-	uint64_t ver;
+	unsigned long long now = now_ns();
+	struct fw_query *query;
 
-	cmd = ndctl_dimm_cmd_new_fw_finish_query(uctx->start);
-	if (!cmd)
-		return -ENXIO;
+	query = calloc(1, sizeof(*query));
+	if (!query)
+		return -ENOMEM;
 
-	rc = clock_gettime(CLOCK_MONOTONIC, &before);
-	if (rc < 0)
-		goto unref;
+	query->cmd = ndctl_dimm_cmd_new_fw_finish_query(uctx->start);
+	if (!query->cmd) {
+		free(query);
+		return -ENXIO;
+	}
 
-	now.tv_nsec = fw->query_interval / 1000;
-	now.tv_sec = 0;
+	/* the query interval and max query time are in microseconds */
+	query->dimm = dimm;
+	query->start = uctx->start;
+	query->interval = fw->query_interval * 1000ULL;
+	query->next = now;
+	query->expire = now + fw->max_query * 1000ULL;
+	list_add_tail(&uctx->queries, &query->list);
+	uctx->start = NULL;
 
-again:
-	rc = ndctl_cmd_submit(cmd);
-	if (rc < 0)
-		goto unref;
+	return 0;
+}
 
-	status = ndctl_cmd_fw_xlat_firmware_status(cmd);
-	if (status == FW_EBUSY) {
-		/* Still on going, continue */
-		rc = clock_gettime(CLOCK_MONOTONIC, &after);
-		if (rc < 0) {
-			rc = -errno;
-			goto unref;
-		}
+/*
+ * Submit one finish query, return -EAGAIN while the firmware is still
+ * busy, 0 once the DIMM has the new image, or a negative error code.
+ */
+static int query_fw_finish_status(struct fw_query *query)
+{
+	struct ndctl_dimm *dimm = query->dimm;
+	enum ND_FW_STATUS status;
+	uint64_t ver;
+	int rc;
 
-		/*
-		 * If we expire max query time,
-		 * we timed out
-		 */
-		if (after.tv_sec - before.tv_sec >
-				fw->max_query / 1000000) {
-			rc = -ETIMEDOUT;
-			goto unref;
-		}
+	rc = ndctl_cmd_submit(query->cmd);
+	if (rc < 0)
+		return rc;
 
-		/*
-		 * Sleep the interval dictated by firmware
-		 * before query again.
-		 */
-		rc = nanosleep(&now, NULL);
-		if (rc < 0) {
-			rc = -errno;
-			goto unref;
-		}
-		goto again;
-	}
+	status = ndctl_cmd_fw_xlat_firmware_status(query->cmd);
+	if (status == FW_EBUSY)
+		return -EAGAIN;
 
 	/* We are done determine error code */
 	switch (status) {
 	case FW_SUCCESS:
-		ver = ndctl_cmd_fw_fquery_get_fw_rev(cmd);
+		ver = ndctl_cmd_fw_fquery_get_fw_rev(query->cmd);
 		if (ver == 0) {
 			fprintf(stderr, "No firmware updated.\n");
 			rc = -ENXIO;
-			goto unref;
+			break;
 		}
 
 		fprintf(stderr, "Image updated successfully to DIMM %s.\n",
@@ -777,11 +790,66 @@ again:
 		break;
 	}
 
-unref:
-	ndctl_cmd_unref(cmd);
 	return rc;
 }
 
+/*
+ * Poll every queued DIMM at its own firmware advertised interval until
+ * all of them have completed or timed out, so that the verification
+ * of the new image proceeds on all DIMMs in parallel. Returns the
+ * number of DIMMs that failed, and the first error in @err.
+ */
+static int query_fw_finish_all(struct action_context *actx, int *err)
+{
+	struct update_context *uctx = &actx->update;
+	struct fw_query *query, *_q;
+	int failed = 0;
+
+	while (!list_empty(&uctx->queries)) {
+		unsigned long long next = ULLONG_MAX, now;
+		struct timespec ts;
+		int rc;
+
+		list_for_each(&uctx->queries, query, list)
+			next = min(next, query->next);
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL) == EINTR)
+			;
+
+		list_for_each_safe(&uctx->queries, query, _q, list) {
+			now = now_ns();
+			if (query->next > now)
+				continue;
+
+			rc = query_fw_finish_status(query);
+			if (rc == -EAGAIN && now < query->expire) {
+				query->next = now + query->interval;
+				continue;
+			}
+			if (rc == -EAGAIN) {
+				fprintf(stderr,
+					"Firmware verification timed out: %s\n",
+					ndctl_dimm_get_devname(query->dimm));
+				rc = -ETIMEDOUT;
+			}
+			if (rc < 0) {
+				failed++;
+				if (!*err)
+					*err = rc;
+			}
+
+			list_del_from(&uctx->queries, &query->list);
+			ndctl_cmd_unref(query->cmd);
+			ndctl_cmd_unref(query->start);
+			free(query);
+		}
+	}
+
+	return failed;
+}
+
 static int update_firmware(struct ndctl_dimm *dimm,
 		struct action_context *actx)
 {
@@ -822,11 +890,8 @@ static int update_firmware(struct ndctl_dimm *dimm,
 		return rc;
 	}
 
-	rc = query_fw_finish_status(dimm, actx);
-	if (rc < 0)
-		return rc;
-
-	return 0;
+	/* completion is collected once all DIMMs have been sent the image */
+	return queue_fw_finish_query(dimm, actx);
 }
 
 static int action_update(struct ndctl_dimm *dimm, struct action_context *actx)
@@ -921,6 +986,154 @@ static int action_security_freeze(struct ndctl_dimm *dimm,
 	return rc;
 }
 
+/*
+ * A DIMM with an overwrite in flight. Completion of all of them is
+ * awaited from a single epoll set, see wait_overwrite_all().
+ */
+struct overwrite_wait {
+	struct list_node list;
+	struct ndctl_dimm *dimm;
+	int fd;
+};
+
+static int queue_overwrite_wait(struct ndctl_dimm *dimm,
+		struct action_context *actx)
+{
+	struct overwrite_wait *ow;
+	char buf;
+	int fd;
+
+	fd = ndctl_dimm_open_security(dimm);
+	if (fd < 0)
+		return fd;
+
+	/* arm the sysfs notification before checking the state */
+	if (pread(fd, &buf, sizeof(buf), 0) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	if (ndctl_dimm_get_security(dimm) != NDCTL_SECURITY_OVERWRITE) {
+		close(fd);
+		return 0;
+	}
+
+	ow = calloc(1, sizeof(*ow));
+	if (!ow) {
+		close(fd);
+		return -ENOMEM;
+	}
+	ow->dimm = dimm;
+	ow->fd = fd;
+	list_add_tail(&actx->overwrites, &ow->list);
+	actx->num_overwrites++;
+	return 0;
+}
+
+static void overwrite_wait_free(struct action_context *actx,
+		struct overwrite_wait *ow)
+{
+	list_del(&ow->list);
+	close(ow->fd);
+	free(ow);
+}
+
+/*
+ * Wait for every queued overwrite to finish, reporting each DIMM as
+ * its 'security' attribute leaves the "overwrite" state. Returns the
+ * number of DIMMs whose overwrite failed and records the first error in
+ * @err.
+ */
+static int wait_overwrite_all(struct action_context *actx, int *err)
+{
+	struct overwrite_wait *ow, *_ow;
+	int total = actx->num_overwrites;
+	struct epoll_event ev, *events;
+	int epollfd, nfds, i, rc = 0;
+	int done = 0, failed = 0;
+	char buf;
+
+	if (list_empty(&actx->overwrites))
+		return 0;
+
+	events = calloc(total, sizeof(*events));
+	epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (!events || epollfd < 0) {
+		rc = events ? -errno : -ENOMEM;
+		goto out;
+	}
+
+	list_for_each(&actx->overwrites, ow, list) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLPRI;
+		ev.data.ptr = ow;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, ow->fd, &ev) < 0) {
+			rc = -errno;
+			goto out;
+		}
+	}
+
+	fprintf(stderr, "waiting for overwrite on %d nmem%s...\n", total,
+			total > 1 ? "s" : "");
+	while (!list_empty(&actx->overwrites)) {
+		nfds = epoll_wait(epollfd, events, total, -1);
+		if (nfds < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			error("epoll_wait: %s\n", strerror(errno));
+			goto out;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			enum ndctl_security_state state;
+
+			ow = events[i].data.ptr;
+			if (pread(ow->fd, &buf, sizeof(buf), 0) < 0) {
+				rc = -errno;
+				goto out;
+			}
+
+			state = ndctl_dimm_get_security(ow->dimm);
+			if (state == NDCTL_SECURITY_OVERWRITE)
+				continue;
+
+			done++;
+			if (state == NDCTL_SECURITY_DISABLED)
+				printf("%s: overwrite completed. (%d/%d)\n",
+						ndctl_dimm_get_devname(ow->dimm),
+						done, total);
+			else {
+				error("%s: overwrite failed (%d/%d)\n",
+						ndctl_dimm_get_devname(ow->dimm),
+						done, total);
+				if (!*err)
+					*err = -EIO;
+				failed++;
+			}
+			epoll_ctl(epollfd, EPOLL_CTL_DEL, ow->fd, NULL);
+			overwrite_wait_free(actx, ow);
+		}
+	}
+
+ out:
+	if (rc < 0) {
+		list_for_each_safe(&actx->overwrites, ow, _ow, list) {
+			error("%s: failed to wait for overwrite: %s\n",
+					ndctl_dimm_get_devname(ow->dimm),
+					strerror(-rc));
+			overwrite_wait_free(actx, ow);
+			failed++;
+		}
+		if (!*err)
+			*err = rc;
+	}
+	if (epollfd >= 0)
+		close(epollfd);
+	free(events);
+	return failed;
+}
+
 static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 		struct action_context *actx)
 {
@@ -965,6 +1178,8 @@ static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 		rc = ndctl_dimm_overwrite_key(dimm);
 		if (rc < 0)
 			return rc;
+		if (param.wait)
+			return queue_overwrite_wait(dimm, actx);
 	}
 
 	return 0;
@@ -973,19 +1188,13 @@ static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 static int action_wait_overwrite(struct ndctl_dimm *dimm,
 		struct action_context *actx)
 {
-	int rc;
-
 	if (ndctl_dimm_get_security(dimm) < 0) {
 		error("%s: security operation not supported\n",
 				ndctl_dimm_get_devname(dimm));
 		return -EOPNOTSUPP;
 	}
 
-	rc = ndctl_dimm_wait_overwrite(dimm);
-	if (rc == 1)
-		printf("%s: overwrite completed.\n",
-				ndctl_dimm_get_devname(dimm));
-	return rc;
+	return queue_overwrite_wait(dimm, actx);
 }
 
 static int __action_init(struct ndctl_dimm *dimm,
@@ -1089,7 +1298,9 @@ OPT_BOOLEAN('c', "crypto-erase", &param.crypto_erase, \
 OPT_BOOLEAN('o', "overwrite", &param.overwrite, \
 		"overwrite a dimm"), \
 OPT_BOOLEAN('z', "zero-key", &param.zero_key, \
-		"pass in a zero key")
+		"pass in a zero key"), \
+OPT_BOOLEAN('w', "wait", &param.wait, \
+		"wait for the overwrite to complete")
 
 #define MASTER_OPTIONS() \
 OPT_BOOLEAN('m', "master-passphrase", &param.master_pass, \
@@ -1255,6 +1466,8 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 	rc = 0;
 	err = 0;
 	count = 0;
+	list_head_init(&actx.update.queries);
+	list_head_init(&actx.overwrites);
 	for (i = 0; i < argc; i++) {
 		struct ndctl_dimm *dimm;
 		struct ndctl_bus *bus;
@@ -1282,6 +1495,10 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 			}
 		}
 	}
+
+	if (action == action_update)
+		count -= query_fw_finish_all(&actx, &err);
+	count -= wait_overwrite_all(&actx, &err);
 	rc = err;
 
 	if (action == action_write) {
@@ -1441,7 +1658,10 @@ int cmd_sanitize_dimm(int argc, const char **argv, void *ctx)
 			sanitize_options,
 			"ndctl sanitize-dimm <nmem0> [<nmem1>..<nmemN>] [<options>]");
 
-	if (param.overwrite)
+	if (param.overwrite && param.wait)
+		fprintf(stderr, "overwrote %d nmem%s.\n",
+				count >= 0 ? count : 0, count > 1 ? "s" : "");
+	else if (param.overwrite)
 		fprintf(stderr, "overwrite issued for %d nmem%s.\n",
 				count >= 0 ? count : 0, count > 1 ? "s" : "");
 	else
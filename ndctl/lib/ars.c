@@ -301,6 +301,42 @@ NDCTL_EXPORT int ndctl_cmd_ars_stat_get_flag_overflow(
 	return !!(ars_stat->ars_status->flags & ND_ARS_STAT_FLAG_OVERFLOW);
 }
 
+/*
+ * The range that the scrub reported by @ars_stat covered, which falls
+ * short of the requested range if the scrub was interrupted.
+ */
+NDCTL_EXPORT int ndctl_cmd_ars_stat_get_range(struct ndctl_cmd *ars_stat,
+		struct ndctl_range *range)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(cmd_to_bus(ars_stat));
+
+	if (!range || !validate_ars_stat(ctx, ars_stat))
+		return -EINVAL;
+
+	range->address = ars_stat->ars_status->address;
+	range->length = ars_stat->ars_status->length;
+	return 0;
+}
+
+/*
+ * Where to restart a scrub to pick up the rest of the requested range,
+ * or the records that did not fit in the output buffer (see
+ * ndctl_cmd_ars_stat_get_flag_overflow()). A zero length means there is
+ * nothing left to scrub.
+ */
+NDCTL_EXPORT int ndctl_cmd_ars_stat_get_restart(struct ndctl_cmd *ars_stat,
+		struct ndctl_range *range)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(cmd_to_bus(ars_stat));
+
+	if (!range || !validate_ars_stat(ctx, ars_stat))
+		return -EINVAL;
+
+	range->address = ars_stat->ars_status->restart_address;
+	range->length = ars_stat->ars_status->restart_length;
+	return 0;
+}
+
 NDCTL_EXPORT struct ndctl_cmd *ndctl_bus_cmd_new_clear_error(
 		unsigned long long address, unsigned long long len,
 		struct ndctl_cmd *ars_cap)
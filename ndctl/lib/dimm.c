@@ -783,14 +783,16 @@ NDCTL_EXPORT int ndctl_dimm_overwrite(struct ndctl_dimm *dimm, long key)
 	return write_security(dimm, buf);
 }
 
-NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
+/*
+ * Open the 'security' attribute for POLLPRI notification of overwrite
+ * completion. The caller owns, and must close, the returned fd.
+ */
+NDCTL_EXPORT int ndctl_dimm_open_security(struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	struct pollfd fds;
-	char buf[SYSFS_ATTR_SIZE];
-	int fd = 0, rc;
 	char *path = dimm->dimm_buf;
 	int len = dimm->buf_len;
+	int fd, rc;
 
 	if (snprintf(path, len, "%s/security", dimm->dimm_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -804,9 +806,32 @@ NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
 		err(ctx, "open: %s\n", strerror(errno));
 		return rc;
 	}
+
+	return fd;
+}
+
+NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
+	struct pollfd fds;
+	char buf[SYSFS_ATTR_SIZE];
+	int fd = 0, rc;
+	char *path = dimm->dimm_buf;
+	int len = dimm->buf_len;
+
+	fd = ndctl_dimm_open_security(dimm);
+	if (fd < 0)
+		return fd;
 	memset(&fds, 0, sizeof(fds));
 	fds.fd = fd;
 
+	if (snprintf(path, len, "%s/security", dimm->dimm_path) >= len) {
+		err(ctx, "%s: buffer too small!\n",
+				ndctl_dimm_get_devname(dimm));
+		rc = -ERANGE;
+		goto out;
+	}
+
 	rc = sysfs_read_attr(ctx, path, buf);
 	if (rc < 0) {
 		rc = -EOPNOTSUPP;
@@ -0,0 +1,617 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <util/clock.h>
+#include <util/size.h>
+#include <util/log.h>
+#include <ccan/minmax/minmax.h>
+#include <ndctl/libndctl.h>
+#include "private.h"
+#include "intel.h"
+
+/*
+ * In-process command emulation, selected with the NDCTL_EMULATE
+ * environment variable. ndctl_cmd_submit() hands every transfer to
+ * emulate_cmd() instead of ioctl()ing the control device, so the
+ * command paths of the library and tools can be exercised and timed
+ * without an NVDIMM, typically against a synthetic NDCTL_SYSFS_ROOT.
+ *
+ * NDCTL_EMULATE is a comma separated list of <command>=<usec> pairs
+ * giving the latency of each command, where <command> is the name used
+ * in debug messages (e.g. "ars_status", "get_data", "smart") or
+ * "default". Any other token just enables emulation.
+ *
+ * Emulated state (labels, smart values, firmware update progress, and
+ * media errors) lives as long as the bus or dimm object. Media errors
+ * are seeded from the badblocks of the regions of a bus.
+ */
+
+#define EMU_LABEL_SIZE SZ_128K
+#define EMU_MAX_XFER SZ_4K
+#define EMU_ARS_MAX_OUT SZ_4K
+#define EMU_CLEAR_ERR_UNIT 256
+#define EMU_SCRUB_NS 10000000ULL
+#define EMU_FW_STORAGE SZ_4M
+#define EMU_FW_MAX_SEND SZ_4K
+#define EMU_FW_QUERY_INTERVAL 100
+#define EMU_FW_MAX_QUERY 1000000
+#define EMU_FW_BUSY_NS 10000000ULL
+#define EMU_MAX_LATENCY 32
+
+struct emulate_latency {
+	char name[32];
+	unsigned long long ns;
+};
+
+struct ndctl_emulate {
+	unsigned long long default_ns;
+	int num_latency;
+	struct emulate_latency latency[EMU_MAX_LATENCY];
+};
+
+struct emulate_error {
+	unsigned long long address;
+	unsigned long long length;
+};
+
+struct emulate_bus {
+	unsigned long long scrub_start;
+	unsigned long long scrub_address;
+	unsigned long long scrub_length;
+	int scrub_type;
+	int num_errors;
+	int max_errors;
+	struct emulate_error *errors;
+};
+
+enum emulate_fw_state {
+	FW_IDLE,
+	FW_UPDATING,
+	FW_FINISHING,
+};
+
+struct emulate_dimm {
+	unsigned char label[EMU_LABEL_SIZE];
+	struct nd_intel_smart smart;
+	struct nd_intel_smart_threshold thresh;
+	enum emulate_fw_state fw_state;
+	unsigned int fw_context;
+	unsigned long long fw_finish;
+	unsigned long long run_version;
+	unsigned long long updated_version;
+};
+
+struct ndctl_emulate *emulate_new(struct ndctl_ctx *ctx, const char *spec)
+{
+	struct ndctl_emulate *emu;
+	char *buf, *tok, *save;
+
+	emu = calloc(1, sizeof(*emu));
+	buf = strdup(spec);
+	if (!emu || !buf) {
+		free(emu);
+		free(buf);
+		return NULL;
+	}
+
+	for (tok = strtok_r(buf, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		struct emulate_latency *lat;
+		char *eq = strchr(tok, '='), *end;
+		unsigned long long usec;
+
+		if (!eq)
+			continue;
+		*eq = '\0';
+		usec = strtoull(eq + 1, &end, 0);
+		if (*end || end == eq + 1) {
+			err(ctx, "NDCTL_EMULATE: invalid latency for %s\n", tok);
+			continue;
+		}
+		if (strcmp(tok, "default") == 0) {
+			emu->default_ns = usec * 1000;
+			continue;
+		}
+		if (emu->num_latency >= EMU_MAX_LATENCY) {
+			err(ctx, "NDCTL_EMULATE: too many commands\n");
+			break;
+		}
+		lat = &emu->latency[emu->num_latency++];
+		snprintf(lat->name, sizeof(lat->name), "%s", tok);
+		lat->ns = usec * 1000;
+	}
+	free(buf);
+
+	return emu;
+}
+
+void emulate_free(struct ndctl_emulate *emu)
+{
+	free(emu);
+}
+
+void emulate_bus_free(struct emulate_bus *ebus)
+{
+	if (!ebus)
+		return;
+	free(ebus->errors);
+	free(ebus);
+}
+
+void emulate_dimm_free(struct emulate_dimm *edimm)
+{
+	free(edimm);
+}
+
+static void emulate_delay(struct ndctl_emulate *emu, const char *name)
+{
+	unsigned long long ns = emu->default_ns;
+	struct timespec ts;
+	int i;
+
+	for (i = 0; i < emu->num_latency; i++)
+		if (strcmp(emu->latency[i].name, name) == 0) {
+			ns = emu->latency[i].ns;
+			break;
+		}
+	if (!ns)
+		return;
+
+	ts.tv_sec = ns / 1000000000ULL;
+	ts.tv_nsec = ns % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+		;
+}
+
+static int add_error(struct emulate_bus *ebus, unsigned long long address,
+		unsigned long long length)
+{
+	if (ebus->num_errors == ebus->max_errors) {
+		int max = ebus->max_errors ? ebus->max_errors * 2 : 16;
+		struct emulate_error *errors;
+
+		errors = realloc(ebus->errors, max * sizeof(*errors));
+		if (!errors)
+			return -ENOMEM;
+		ebus->errors = errors;
+		ebus->max_errors = max;
+	}
+	ebus->errors[ebus->num_errors++] = (struct emulate_error) {
+		.address = address,
+		.length = length,
+	};
+	return 0;
+}
+
+static struct emulate_bus *to_emulate_bus(struct ndctl_bus *bus)
+{
+	struct ndctl_region *region;
+	struct emulate_bus *ebus;
+
+	if (bus->emulate)
+		return bus->emulate;
+
+	ebus = calloc(1, sizeof(*ebus));
+	if (!ebus)
+		return NULL;
+
+	ndctl_region_foreach(bus, region) {
+		unsigned long long start = ndctl_region_get_resource(region);
+		struct badblock *bb;
+
+		if (start == ULLONG_MAX)
+			continue;
+		ndctl_region_badblock_foreach(region, bb)
+			if (add_error(ebus, start + (bb->offset << 9),
+						(unsigned long long) bb->len << 9)) {
+				emulate_bus_free(ebus);
+				return NULL;
+			}
+	}
+
+	bus->emulate = ebus;
+	return ebus;
+}
+
+static struct emulate_dimm *to_emulate_dimm(struct ndctl_dimm *dimm)
+{
+	struct emulate_dimm *edimm;
+
+	if (dimm->emulate)
+		return dimm->emulate;
+
+	edimm = calloc(1, sizeof(*edimm));
+	if (!edimm)
+		return NULL;
+
+	edimm->smart.flags = ND_INTEL_SMART_HEALTH_VALID
+		| ND_INTEL_SMART_SPARES_VALID | ND_INTEL_SMART_USED_VALID
+		| ND_INTEL_SMART_MTEMP_VALID | ND_INTEL_SMART_CTEMP_VALID
+		| ND_INTEL_SMART_SHUTDOWN_COUNT_VALID
+		| ND_INTEL_SMART_ALARM_VALID | ND_INTEL_SMART_SHUTDOWN_VALID;
+	edimm->smart.spares = 100;
+	edimm->smart.life_used = 5;
+	/* temperatures are in 1/16 degree Celsius */
+	edimm->smart.media_temperature = 23 * 16;
+	edimm->smart.ctrl_temperature = 25 * 16;
+	edimm->thresh.spares = 50;
+	edimm->thresh.media_temperature = 40 * 16;
+	edimm->thresh.ctrl_temperature = 30 * 16;
+	edimm->run_version = 0x0102030405060708ULL;
+
+	dimm->emulate = edimm;
+	return edimm;
+}
+
+static int error_cmp(const void *a, const void *b)
+{
+	const struct emulate_error *ea = a, *eb = b;
+
+	if (ea->address < eb->address)
+		return -1;
+	return ea->address > eb->address;
+}
+
+/*
+ * Report the errors within the range of the last scrub in address
+ * order. When they do not all fit, flag the overflow and point the
+ * restart range at the first error that was left out.
+ */
+static void scrub_status(struct emulate_bus *ebus, struct nd_cmd_ars_status *stat,
+		unsigned int out_length)
+{
+	unsigned int max = (out_length - sizeof(*stat))
+		/ sizeof(stat->records[0]);
+	unsigned long long start, end;
+	int i;
+
+	stat->status = 0;
+	stat->num_records = 0;
+	stat->flags = 0;
+	stat->restart_address = 0;
+	stat->restart_length = 0;
+	if (!ebus->scrub_type) {
+		/* no scrub has been started */
+		stat->status = 2 << 16;
+		return;
+	}
+	if (now_ns() - ebus->scrub_start < EMU_SCRUB_NS) {
+		stat->status = 1 << 16;
+		return;
+	}
+
+	stat->address = ebus->scrub_address;
+	stat->length = ebus->scrub_length;
+	stat->type = ebus->scrub_type;
+	qsort(ebus->errors, ebus->num_errors, sizeof(ebus->errors[0]),
+			error_cmp);
+	for (i = 0; i < ebus->num_errors; i++) {
+		struct emulate_error *e = &ebus->errors[i];
+
+		start = max(e->address, ebus->scrub_address);
+		end = min(e->address + e->length,
+				ebus->scrub_address + ebus->scrub_length);
+		if (start >= end)
+			continue;
+		if (stat->num_records >= max) {
+			stat->flags |= ND_ARS_STAT_FLAG_OVERFLOW;
+			stat->restart_address = start;
+			stat->restart_length = ebus->scrub_address
+				+ ebus->scrub_length - start;
+			break;
+		}
+		stat->records[stat->num_records++] = (struct nd_ars_record) {
+			.err_address = start,
+			.length = end - start,
+		};
+	}
+	stat->out_length = sizeof(*stat)
+		+ stat->num_records * sizeof(stat->records[0]);
+}
+
+static int clear_error(struct emulate_bus *ebus, struct nd_cmd_clear_error *clear)
+{
+	unsigned long long start = clear->address;
+	unsigned long long end = clear->address + clear->length;
+	int i;
+
+	if (!clear->length || start % EMU_CLEAR_ERR_UNIT
+			|| clear->length % EMU_CLEAR_ERR_UNIT) {
+		clear->status = 2;
+		return 0;
+	}
+
+	for (i = 0; i < ebus->num_errors; i++) {
+		struct emulate_error *e = &ebus->errors[i];
+		unsigned long long e_end = e->address + e->length;
+
+		if (e_end <= start || e->address >= end)
+			continue;
+		if (e->address < start && e_end > end) {
+			/* split, the tail is visited again as a new entry */
+			if (add_error(ebus, end, e_end - end))
+				return -ENOMEM;
+			e = &ebus->errors[i];
+			e->length = start - e->address;
+		} else if (e->address < start) {
+			e->length = start - e->address;
+		} else if (e_end > end) {
+			e->length = e_end - end;
+			e->address = end;
+		} else {
+			ebus->errors[i--] = ebus->errors[--ebus->num_errors];
+		}
+	}
+
+	clear->status = 0;
+	clear->cleared = clear->length;
+	return 0;
+}
+
+static int emulate_bus_cmd(struct ndctl_cmd *cmd)
+{
+	struct emulate_bus *ebus = to_emulate_bus(cmd->bus);
+
+	if (!ebus)
+		return -ENOMEM;
+
+	switch (cmd->type) {
+	case ND_CMD_ARS_CAP:
+		cmd->ars_cap->status = (ND_ARS_VOLATILE | ND_ARS_PERSISTENT) << 16;
+		cmd->ars_cap->max_ars_out = EMU_ARS_MAX_OUT;
+		cmd->ars_cap->clear_err_unit = EMU_CLEAR_ERR_UNIT;
+		cmd->ars_cap->flags = 0;
+		return 0;
+	case ND_CMD_ARS_START:
+		if (ebus->scrub_type && now_ns() - ebus->scrub_start
+				< EMU_SCRUB_NS) {
+			cmd->ars_start->status = 6;
+			return 0;
+		}
+		ebus->scrub_type = cmd->ars_start->type;
+		ebus->scrub_start = now_ns();
+		ebus->scrub_address = cmd->ars_start->address;
+		ebus->scrub_length = cmd->ars_start->length;
+		cmd->ars_start->status = 0;
+		cmd->ars_start->scrub_time = EMU_SCRUB_NS / 1000000000ULL + 1;
+		return 0;
+	case ND_CMD_ARS_STATUS:
+		scrub_status(ebus, cmd->ars_status, cmd->size - sizeof(*cmd));
+		return 0;
+	case ND_CMD_CLEAR_ERROR:
+		return clear_error(ebus, cmd->clear_err);
+	}
+
+	return -ENOTTY;
+}
+
+static void smart_update_alarms(struct emulate_dimm *edimm)
+{
+	struct nd_intel_smart *smart = &edimm->smart;
+	struct nd_intel_smart_threshold *thresh = &edimm->thresh;
+
+	smart->alarm_flags = 0;
+	if ((thresh->alarm_control & ND_INTEL_SMART_SPARE_TRIP)
+			&& smart->spares <= thresh->spares)
+		smart->alarm_flags |= ND_INTEL_SMART_SPARE_TRIP;
+	if ((thresh->alarm_control & ND_INTEL_SMART_TEMP_TRIP)
+			&& smart->media_temperature
+			>= thresh->media_temperature)
+		smart->alarm_flags |= ND_INTEL_SMART_TEMP_TRIP;
+	if ((thresh->alarm_control & ND_INTEL_SMART_CTEMP_TRIP)
+			&& smart->ctrl_temperature >= thresh->ctrl_temperature)
+		smart->alarm_flags |= ND_INTEL_SMART_CTEMP_TRIP;
+}
+
+static void fw_send_status(struct nd_intel_fw_send_data *send, u32 status)
+{
+	memcpy(send->data + send->length, &status, sizeof(status));
+}
+
+static int emulate_intel_cmd(struct emulate_dimm *edimm, struct nd_pkg_intel *pkg)
+{
+	const u32 extend = ND_INTEL_STATUS_EXTEND;
+
+	if (pkg->gen.nd_family != NVDIMM_FAMILY_INTEL)
+		return -ENOTTY;
+	pkg->gen.nd_fw_size = pkg->gen.nd_size_out;
+
+	switch (pkg->gen.nd_command) {
+	case ND_INTEL_SMART:
+		memcpy(pkg->smart.data, edimm->smart.data,
+				sizeof(pkg->smart.data));
+		pkg->smart.status = 0;
+		return 0;
+	case ND_INTEL_SMART_THRESHOLD:
+		memcpy(pkg->thresh.data, edimm->thresh.data,
+				sizeof(pkg->thresh.data));
+		pkg->thresh.status = 0;
+		return 0;
+	case ND_INTEL_SMART_SET_THRESHOLD:
+		edimm->thresh.alarm_control = pkg->set_thresh.alarm_control;
+		edimm->thresh.spares = pkg->set_thresh.spares;
+		edimm->thresh.media_temperature =
+			pkg->set_thresh.media_temperature;
+		edimm->thresh.ctrl_temperature =
+			pkg->set_thresh.ctrl_temperature;
+		smart_update_alarms(edimm);
+		pkg->set_thresh.status = 0;
+		return 0;
+	case ND_INTEL_SMART_INJECT: {
+		struct nd_intel_smart_inject *inj = &pkg->inject;
+		struct nd_intel_smart *smart = &edimm->smart;
+
+		if (inj->flags & ND_INTEL_SMART_INJECT_MTEMP)
+			smart->media_temperature = inj->mtemp_enable
+				? inj->media_temperature : 23 * 16;
+		if (inj->flags & ND_INTEL_SMART_INJECT_SPARE)
+			smart->spares = inj->spare_enable ? inj->spares : 100;
+		if (inj->flags & ND_INTEL_SMART_INJECT_FATAL)
+			smart->health = inj->fatal_enable
+				? ND_INTEL_SMART_FATAL_HEALTH : 0;
+		if ((inj->flags & ND_INTEL_SMART_INJECT_SHUTDOWN)
+				&& inj->unsafe_shutdown_enable) {
+			smart->shutdown_state = 1;
+			smart->shutdown_count++;
+		} else if (inj->flags & ND_INTEL_SMART_INJECT_SHUTDOWN)
+			smart->shutdown_state = 0;
+		smart_update_alarms(edimm);
+		inj->status = 0;
+		return 0;
+	}
+	case ND_INTEL_FW_GET_INFO:
+		pkg->info = (struct nd_intel_fw_info) {
+			.storage_size = EMU_FW_STORAGE,
+			.max_send_len = EMU_FW_MAX_SEND,
+			.query_interval = EMU_FW_QUERY_INTERVAL,
+			.max_query_time = EMU_FW_MAX_QUERY,
+			.update_cap = 0,
+			.fis_version = 0x0105,
+			.run_version = edimm->run_version,
+			.updated_version = edimm->updated_version,
+		};
+		return 0;
+	case ND_INTEL_FW_START_UPDATE:
+		if (edimm->fw_state != FW_IDLE) {
+			pkg->start.status = extend | ND_INTEL_STATUS_START_BUSY;
+			return 0;
+		}
+		edimm->fw_state = FW_UPDATING;
+		pkg->start.context = ++edimm->fw_context;
+		pkg->start.status = 0;
+		return 0;
+	case ND_INTEL_FW_SEND_DATA: {
+		struct nd_intel_fw_send_data *send = &pkg->send;
+
+		if (edimm->fw_state != FW_UPDATING
+				|| send->context != edimm->fw_context)
+			fw_send_status(send, extend
+					| ND_INTEL_STATUS_SEND_CTXINVAL);
+		else if (send->length > EMU_FW_MAX_SEND
+				|| (u64) send->offset + send->length
+				> EMU_FW_STORAGE)
+			fw_send_status(send, ND_INTEL_STATUS_INVALPARM);
+		else
+			fw_send_status(send, 0);
+		return 0;
+	}
+	case ND_INTEL_FW_FINISH_UPDATE: {
+		struct nd_intel_fw_finish_update *finish = &pkg->finish;
+
+		if (edimm->fw_state != FW_UPDATING
+				|| finish->context != edimm->fw_context) {
+			finish->status = extend | ND_INTEL_STATUS_FIN_CTXINVAL;
+			return 0;
+		}
+		if (finish->ctrl_flags & 1) {
+			edimm->fw_state = FW_IDLE;
+			finish->status = 0;
+			return 0;
+		}
+		edimm->fw_state = FW_FINISHING;
+		edimm->fw_finish = now_ns();
+		finish->status = 0;
+		return 0;
+	}
+	case ND_INTEL_FW_FINISH_STATUS_QUERY: {
+		struct nd_intel_fw_finish_query *fquery = &pkg->fquery;
+
+		if (fquery->context != edimm->fw_context) {
+			fquery->status = extend | ND_INTEL_STATUS_FQ_CTXINVAL;
+			return 0;
+		}
+		if (edimm->fw_state == FW_UPDATING) {
+			fquery->status = extend | ND_INTEL_STATUS_FQ_ORDER;
+			return 0;
+		}
+		if (edimm->fw_state == FW_FINISHING) {
+			if (now_ns() - edimm->fw_finish < EMU_FW_BUSY_NS) {
+				fquery->status = extend
+					| ND_INTEL_STATUS_FQ_BUSY;
+				return 0;
+			}
+			edimm->fw_state = FW_IDLE;
+			edimm->updated_version = edimm->run_version + 1;
+		}
+		fquery->updated_fw_rev = edimm->updated_version;
+		fquery->status = 0;
+		return 0;
+	}
+	}
+
+	pkg->gen.nd_fw_size = 0;
+	return -ENOTTY;
+}
+
+static int emulate_dimm_cmd(struct ndctl_cmd *cmd)
+{
+	struct emulate_dimm *edimm = to_emulate_dimm(cmd->dimm);
+
+	if (!edimm)
+		return -ENOMEM;
+
+	switch (cmd->type) {
+	case ND_CMD_GET_CONFIG_SIZE:
+		cmd->get_size->status = 0;
+		cmd->get_size->config_size = EMU_LABEL_SIZE;
+		cmd->get_size->max_xfer = EMU_MAX_XFER;
+		return 0;
+	case ND_CMD_GET_CONFIG_DATA: {
+		struct nd_cmd_get_config_data_hdr *get = cmd->get_data;
+
+		if (get->in_offset > EMU_LABEL_SIZE
+				|| get->in_length > EMU_LABEL_SIZE - get->in_offset) {
+			get->status = 3;
+			return 0;
+		}
+		memcpy(get->out_buf, edimm->label + get->in_offset,
+				get->in_length);
+		get->status = 0;
+		return 0;
+	}
+	case ND_CMD_SET_CONFIG_DATA: {
+		struct nd_cmd_set_config_hdr *set = cmd->set_data;
+		u32 status = 0;
+
+		if (set->in_offset > EMU_LABEL_SIZE
+				|| set->in_length > EMU_LABEL_SIZE - set->in_offset)
+			status = 3;
+		else
+			memcpy(edimm->label + set->in_offset, set->in_buf,
+					set->in_length);
+		memcpy(set->in_buf + set->in_length, &status, sizeof(status));
+		return 0;
+	}
+	case ND_CMD_CALL:
+		return emulate_intel_cmd(edimm, cmd->intel);
+	}
+
+	return -ENOTTY;
+}
+
+/*
+ * Complete one transfer of @cmd with ioctl() semantics, i.e. return 0
+ * or -1 with errno set. The firmware status is left in the payload.
+ */
+int emulate_cmd(struct ndctl_cmd *cmd, const char *name)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(cmd_to_bus(cmd));
+	int rc;
+
+	emulate_delay(ctx->emulate, name);
+
+	if (cmd->dimm)
+		rc = emulate_dimm_cmd(cmd);
+	else
+		rc = emulate_bus_cmd(cmd);
+
+	if (rc < 0) {
+		errno = -rc;
+		return -1;
+	}
+	return 0;
+}
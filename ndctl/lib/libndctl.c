@@ -12,6 +12,7 @@
  */
 #include <poll.h>
 #include <stdio.h>
+#include <time.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -33,6 +34,7 @@
 #include <ndctl.h>
 #include <util/util.h>
 #include <util/size.h>
+#include <util/clock.h>
 #include <util/sysfs.h>
 #include <ndctl/libndctl.h>
 #include <ndctl/namespace.h>
@@ -312,6 +314,25 @@ NDCTL_EXPORT int ndctl_new(struct ndctl_ctx **ctx)
 		goto err_ctx;
 	}
 
+	/* allow enumeration of a synthetic topology outside of /sys */
+	env = secure_getenv("NDCTL_SYSFS_ROOT");
+	c->sysfs_root = strdup(env && env[0] ? env : "/sys");
+	if (!c->sysfs_root) {
+		free(c);
+		rc = -ENOMEM;
+		goto err_ctx;
+	}
+
+	/* dax regions are found via namespaces, keep them in one hierarchy */
+	if (env && env[0]) {
+		rc = daxctl_set_sysfs_root(daxctl_ctx, c->sysfs_root);
+		if (rc) {
+			free(c->sysfs_root);
+			free(c);
+			goto err_ctx;
+		}
+	}
+
 	c->refcount = 1;
 	log_init(&c->ctx, "libndctl", "NDCTL_LOG");
 	c->udev = udev;
@@ -320,6 +341,20 @@ NDCTL_EXPORT int ndctl_new(struct ndctl_ctx **ctx)
 
 	info(c, "ctx %p created\n", c);
 	dbg(c, "log_priority=%d\n", c->ctx.log_priority);
+	dbg(c, "sysfs_root=%s\n", c->sysfs_root);
+
+	/* complete commands in-process rather than via the kernel */
+	env = secure_getenv("NDCTL_EMULATE");
+	if (env && env[0]) {
+		c->emulate = emulate_new(c, env);
+		if (!c->emulate) {
+			free(c->sysfs_root);
+			free(c);
+			rc = -ENOMEM;
+			goto err_ctx;
+		}
+		info(c, "emulating commands: %s\n", env);
+	}
 	*ctx = c;
 
 	env = secure_getenv("NDCTL_TIMEOUT");
@@ -368,6 +403,19 @@ NDCTL_EXPORT struct daxctl_ctx *ndctl_get_daxctl_ctx(struct ndctl_ctx *ctx)
 	return ctx->daxctl_ctx;
 }
 
+/**
+ * ndctl_get_sysfs_root - where the library enumerates sysfs
+ * @ctx: ndctl library context
+ *
+ * "/sys", unless overridden with the NDCTL_SYSFS_ROOT environment
+ * variable, for other sysfs lookups to stay consistent with the
+ * enumerated topology.
+ */
+NDCTL_EXPORT const char *ndctl_get_sysfs_root(struct ndctl_ctx *ctx)
+{
+	return ctx->sysfs_root;
+}
+
 /**
  * ndctl_ref - take an additional reference on the context
  * @ctx: context established by ndctl_new()
@@ -606,6 +654,8 @@ static void free_dimm(struct ndctl_dimm *dimm)
 	if (dimm->health_eventfd > -1)
 		close(dimm->health_eventfd);
 	ndctl_cmd_unref(dimm->ndd.cmd_read);
+	cmd_stats_free(&dimm->cmd_stats);
+	emulate_dimm_free(dimm->emulate);
 	free(dimm);
 }
 
@@ -627,6 +677,8 @@ static void free_bus(struct ndctl_bus *bus, struct list_head *head)
 	free(bus->bus_buf);
 	free(bus->wait_probe_path);
 	free(bus->scrub_path);
+	cmd_stats_free(&bus->cmd_stats);
+	emulate_bus_free(bus->emulate);
 	free(bus);
 }
 
@@ -636,6 +688,8 @@ static void free_context(struct ndctl_ctx *ctx)
 
 	list_for_each_safe(&ctx->busses, bus, _b, list)
 		free_bus(bus, &ctx->busses);
+	free(ctx->sysfs_root);
+	emulate_free(ctx->emulate);
 	free(ctx);
 }
 
@@ -702,12 +756,13 @@ NDCTL_EXPORT void ndctl_set_log_priority(struct ndctl_ctx *ctx, int priority)
 	daxctl_set_log_priority(ctx->daxctl_ctx, priority);
 }
 
-static char *__dev_path(char *type, int major, int minor, int parent)
+static char *__dev_path(struct ndctl_ctx *ctx, char *type, int major,
+		int minor, int parent)
 {
 	char *path, *dev_path;
 
-	if (asprintf(&path, "/sys/dev/%s/%d:%d%s", type, major, minor,
-				parent ? "/device" : "") < 0)
+	if (asprintf(&path, "%s/dev/%s/%d:%d%s", ctx->sysfs_root, type,
+				major, minor, parent ? "/device" : "") < 0)
 		return NULL;
 
 	dev_path = realpath(path, NULL);
@@ -715,9 +770,10 @@ static char *__dev_path(char *type, int major, int minor, int parent)
 	return dev_path;
 }
 
-static char *parent_dev_path(char *type, int major, int minor)
+static char *parent_dev_path(struct ndctl_ctx *ctx, char *type, int major,
+		int minor)
 {
-        return __dev_path(type, major, minor, 1);
+        return __dev_path(ctx, type, major, minor, 1);
 }
 
 static int device_parse(struct ndctl_ctx *ctx, struct ndctl_bus *bus,
@@ -856,6 +912,7 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 		goto err_bus;
 	list_head_init(&bus->dimms);
 	list_head_init(&bus->regions);
+	list_head_init(&bus->cmd_stats);
 	bus->ctx = ctx;
 	bus->id = id;
 
@@ -908,7 +965,7 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 	if (!bus->scrub_path)
 		goto err_read;
 
-	bus->bus_path = parent_dev_path("char", bus->major, bus->minor);
+	bus->bus_path = parent_dev_path(ctx, "char", bus->major, bus->minor);
 	if (!bus->bus_path)
 		goto err_dev_path;
 
@@ -947,11 +1004,18 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 
 static void busses_init(struct ndctl_ctx *ctx)
 {
+	char *path;
+
 	if (ctx->busses_init)
 		return;
 	ctx->busses_init = 1;
 
-	device_parse(ctx, NULL, "/sys/class/nd", "ndctl", ctx, add_bus);
+	if (asprintf(&path, "%s/class/nd", ctx->sysfs_root) < 0) {
+		err(ctx, "bus path allocation failure\n");
+		return;
+	}
+	device_parse(ctx, NULL, path, "ndctl", ctx, add_bus);
+	free(path);
 }
 
 NDCTL_EXPORT void ndctl_invalidate(struct ndctl_ctx *ctx)
@@ -1677,6 +1741,7 @@ static void *add_dimm(void *parent, int id, const char *dimm_base)
 	dimm->revision_id = -1;
 	dimm->health_eventfd = -1;
 	dimm->dirty_shutdown = -ENOENT;
+	list_head_init(&dimm->cmd_stats);
 	dimm->subsystem_vendor_id = -1;
 	dimm->subsystem_device_id = -1;
 	dimm->subsystem_revision_id = -1;
@@ -3041,6 +3106,29 @@ NDCTL_EXPORT int ndctl_cmd_get_type(struct ndctl_cmd *cmd)
 	return cmd->type;
 }
 
+/*
+ * Return a submitted command to its freshly allocated state so that it
+ * can be submitted again, i.e. clear the output payload, and restore
+ * the status and firmware size that its family's constructor set up,
+ * while preserving the input payload. Limited to ND_CMD_CALL packages,
+ * which covers all the DIMM family commands, since the other command
+ * types interleave their input and output fields.
+ */
+NDCTL_EXPORT int ndctl_cmd_reset(struct ndctl_cmd *cmd)
+{
+	struct nd_cmd_pkg *pkg = cmd->pkg;
+
+	if (cmd->type != ND_CMD_CALL)
+		return -EOPNOTSUPP;
+
+	memset(pkg->nd_payload + pkg->nd_size_in, 0, pkg->nd_size_out);
+	if (cmd->submitted) {
+		pkg->nd_fw_size = cmd->fresh_fw_size;
+		cmd->status = cmd->fresh_status;
+	}
+	return 0;
+}
+
 static int to_ioctl_cmd(int cmd, int dimm)
 {
 	if (!dimm) {
@@ -3089,6 +3177,16 @@ NDCTL_EXPORT int ndctl_cmd_xlat_firmware_status(struct ndctl_cmd *cmd)
 	return ops->xlat_firmware_status(cmd);
 }
 
+static int cmd_ioctl(int fd, int ioctl_cmd, struct ndctl_cmd *cmd,
+		const char *name)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(cmd_to_bus(cmd));
+
+	if (ctx->emulate)
+		return emulate_cmd(cmd, name);
+	return ioctl(fd, ioctl_cmd, cmd->cmd_buf);
+}
+
 static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 {
 	int rc;
@@ -3107,7 +3205,8 @@ static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 
 
 	if (iter->total_xfer == 0) {
-		rc = ioctl(fd, ioctl_cmd, cmd->cmd_buf);
+		rc = cmd_ioctl(fd, ioctl_cmd, cmd,
+				sub_name ? sub_name : name);
 		dbg(ctx, "bus: %d dimm: %#x cmd: %s%s%s status: %d fw: %d (%s)\n",
 				bus->id, dimm ? ndctl_dimm_get_handle(dimm) : 0,
 				name, sub_name ? ":" : "", sub_name ? sub_name : "",
@@ -3126,7 +3225,8 @@ static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 		if (iter->dir == WRITE)
 			memcpy(iter->data, iter->total_buf + offset,
 					cmd->get_xfer(cmd));
-		rc = ioctl(fd, ioctl_cmd, cmd->cmd_buf);
+		rc = cmd_ioctl(fd, ioctl_cmd, cmd,
+				sub_name ? sub_name : name);
 		if (rc < 0) {
 			rc = -errno;
 			break;
@@ -3151,6 +3251,16 @@ static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 	return rc;
 }
 
+static int do_cmd_timed(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
+{
+	unsigned long long start = now_ns();
+	int rc;
+
+	rc = do_cmd(fd, ioctl_cmd, cmd);
+	cmd_stats_account(cmd, rc, now_ns() - start);
+	return rc;
+}
+
 NDCTL_EXPORT int ndctl_cmd_submit(struct ndctl_cmd *cmd)
 {
 	struct stat st;
@@ -3166,11 +3276,23 @@ NDCTL_EXPORT int ndctl_cmd_submit(struct ndctl_cmd *cmd)
 		return -EINVAL;
 	}
 
+	if (!cmd->submitted) {
+		cmd->submitted = true;
+		cmd->fresh_status = cmd->status;
+		if (cmd->type == ND_CMD_CALL)
+			cmd->fresh_fw_size = cmd->pkg->nd_fw_size;
+	}
+
 	if (ioctl_cmd == 0) {
 		rc = -EINVAL;
 		goto out;
 	}
 
+	if (ctx->emulate) {
+		rc = do_cmd_timed(-1, ioctl_cmd, cmd);
+		goto out;
+	}
+
 	if (cmd->dimm) {
 		prefix = "nmem";
 		id = ndctl_dimm_get_id(cmd->dimm);
@@ -3198,7 +3320,7 @@ NDCTL_EXPORT int ndctl_cmd_submit(struct ndctl_cmd *cmd)
 	if (fstat(fd, &st) >= 0 && S_ISCHR(st.st_mode)
 			&& major(st.st_rdev) == major
 			&& minor(st.st_rdev) == minor) {
-		rc = do_cmd(fd, ioctl_cmd, cmd);
+		rc = do_cmd_timed(fd, ioctl_cmd, cmd);
 	} else {
 		err(ctx, "failed to validate %s as a control node\n", path);
 		rc = -ENXIO;
@@ -4090,7 +4212,7 @@ NDCTL_EXPORT struct badblock *ndctl_namespace_get_first_badblock(
 		return NULL;
 	}
 
-	if (snprintf(path, len, "/sys/block/%s", bdev) >= len) {
+	if (snprintf(path, len, "%s/block/%s", ctx->sysfs_root, bdev) >= len) {
 		err(ctx, "%s: buffer too small!\n", dev);
 		return NULL;
 	}
@@ -4122,7 +4244,7 @@ static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
 		}
 	}
 
-	if (snprintf(path, len, "/sys/bus/nd/drivers") >= len) {
+	if (snprintf(path, len, "%s/bus/nd/drivers", ctx->sysfs_root) >= len) {
 		err(ctx, "%s: buffer too small!\n", devname);
 		return -ENXIO;
 	}
@@ -4684,7 +4806,8 @@ static int __ndctl_namespace_set_write_cache(struct ndctl_namespace *ndns,
 	if (!bdev)
 		return -ENXIO;
 
-	if (snprintf(path, len, "/sys/block/%s/dax/write_cache", bdev) >= len) {
+	if (snprintf(path, len, "%s/block/%s/dax/write_cache",
+				ctx->sysfs_root, bdev) >= len) {
 		err(ctx, "%s: buffer too small!\n",
 				ndctl_namespace_get_devname(ndns));
 		return -ENXIO;
@@ -4724,7 +4847,8 @@ NDCTL_EXPORT int ndctl_namespace_write_cache_is_enabled(
 	if (!bdev)
 		return -ENXIO;
 
-	if (snprintf(path, len, "/sys/block/%s/dax/write_cache", bdev) >= len) {
+	if (snprintf(path, len, "%s/block/%s/dax/write_cache",
+				ctx->sysfs_root, bdev) >= len) {
 		err(ctx, "%s: buffer too small!\n",
 				ndctl_namespace_get_devname(ndns));
 		return -ENXIO;
@@ -100,6 +100,8 @@ struct ndctl_dimm {
 	} flags;
 	int locked;
 	int aliased;
+	struct list_head cmd_stats;
+	struct emulate_dimm *emulate;
 	struct list_node list;
 	int formats;
 	int format[0];
@@ -143,6 +145,8 @@ struct ndctl_ctx {
 	struct kmod_ctx *kmod_ctx;
 	struct daxctl_ctx *daxctl_ctx;
 	unsigned long timeout;
+	char *sysfs_root;
+	struct ndctl_emulate *emulate;
 	void *private_data;
 };
 
@@ -176,6 +180,8 @@ struct ndctl_bus {
 	char *scrub_path;
 	unsigned long cmd_mask;
 	unsigned long nfit_dsm_mask;
+	struct list_head cmd_stats;
+	struct emulate_bus *emulate;
 };
 
 /**
@@ -253,6 +259,10 @@ struct ndctl_cmd {
 	int type;
 	int size;
 	int status;
+	/* state as constructed, saved at first submit for ndctl_cmd_reset() */
+	bool submitted;
+	int fresh_status;
+	u32 fresh_fw_size;
 	u32 (*get_firmware_status)(struct ndctl_cmd *cmd);
 	u32 (*get_xfer)(struct ndctl_cmd *cmd);
 	u32 (*get_offset)(struct ndctl_cmd *cmd);
@@ -287,6 +297,41 @@ struct ndctl_cmd {
 	};
 };
 
+#define NDCTL_CMD_STATS_BUCKETS 32
+
+/**
+ * struct ndctl_cmd_stats - submission statistics for one command type
+ * @type: ND_CMD_* command
+ * @func: family function number for ND_CMD_CALL, -1 otherwise
+ * @head: the owning bus or dimm list, for ndctl_cmd_stats_get_next()
+ * @buckets: log2 histogram of the submission latency in microseconds
+ */
+struct ndctl_cmd_stats {
+	int type;
+	int func;
+	const char *name;
+	unsigned long long count;
+	unsigned long long errors;
+	unsigned long long fw_errors;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long long buckets[NDCTL_CMD_STATS_BUCKETS];
+	struct list_head *head;
+	struct list_node list;
+};
+
+void cmd_stats_account(struct ndctl_cmd *cmd, int rc, unsigned long long ns);
+void cmd_stats_free(struct list_head *head);
+
+struct ndctl_emulate;
+struct emulate_bus;
+struct emulate_dimm;
+struct ndctl_emulate *emulate_new(struct ndctl_ctx *ctx, const char *spec);
+void emulate_free(struct ndctl_emulate *emu);
+void emulate_bus_free(struct emulate_bus *ebus);
+void emulate_dimm_free(struct emulate_dimm *edimm);
+int emulate_cmd(struct ndctl_cmd *cmd, const char *name);
+
 struct ndctl_bb {
 	u64 block;
 	u64 count;
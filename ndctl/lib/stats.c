@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <stdlib.h>
+#include <limits.h>
+#include <util/log.h>
+#include <ndctl/libndctl.h>
+#include "private.h"
+
+/*
+ * Per-object, per-command statistics maintained by ndctl_cmd_submit().
+ * Entries are allocated the first time a given command (and, for
+ * ND_CMD_CALL, a given family function) is submitted to a bus or dimm,
+ * so steady state submission does not allocate.
+ */
+
+static struct list_head *cmd_stats_head(struct ndctl_cmd *cmd)
+{
+	if (cmd->dimm)
+		return &cmd->dimm->cmd_stats;
+	return &cmd->bus->cmd_stats;
+}
+
+static const char *cmd_stats_name(struct ndctl_cmd *cmd, int func)
+{
+	struct ndctl_dimm *dimm = cmd->dimm;
+	const char *name = NULL;
+
+	if (!dimm)
+		return ndctl_bus_get_cmd_name(cmd->bus, cmd->type);
+
+	if (func >= 0 && dimm->ops && dimm->ops->cmd_desc)
+		name = dimm->ops->cmd_desc(func);
+	if (!name)
+		name = ndctl_dimm_get_cmd_name(dimm, cmd->type);
+	return name;
+}
+
+static struct ndctl_cmd_stats *cmd_stats_get(struct ndctl_cmd *cmd)
+{
+	struct list_head *head = cmd_stats_head(cmd);
+	struct ndctl_cmd_stats *stats;
+	int func = -1;
+
+	if (cmd->type == ND_CMD_CALL)
+		func = cmd->pkg->nd_command;
+
+	list_for_each(head, stats, list)
+		if (stats->type == cmd->type && stats->func == func)
+			return stats;
+
+	stats = calloc(1, sizeof(*stats));
+	if (!stats)
+		return NULL;
+	stats->type = cmd->type;
+	stats->func = func;
+	stats->name = cmd_stats_name(cmd, func);
+	stats->head = head;
+	list_add_tail(head, &stats->list);
+	return stats;
+}
+
+void cmd_stats_account(struct ndctl_cmd *cmd, int rc, unsigned long long ns)
+{
+	struct ndctl_cmd_stats *stats = cmd_stats_get(cmd);
+	unsigned long long usec = ns / 1000;
+	unsigned int bucket = 0;
+
+	if (!stats)
+		return;
+
+	/* bucket N counts latencies less than 2^N microseconds */
+	if (usec)
+		bucket = 64 - __builtin_clzll(usec);
+	if (bucket >= NDCTL_CMD_STATS_BUCKETS)
+		bucket = NDCTL_CMD_STATS_BUCKETS - 1;
+	stats->buckets[bucket]++;
+
+	stats->count++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	if (rc < 0)
+		stats->errors++;
+	else if (cmd->get_firmware_status(cmd))
+		stats->fw_errors++;
+}
+
+void cmd_stats_free(struct list_head *head)
+{
+	struct ndctl_cmd_stats *stats, *_s;
+
+	list_for_each_safe(head, stats, _s, list) {
+		list_del_from(head, &stats->list);
+		free(stats);
+	}
+}
+
+NDCTL_EXPORT struct ndctl_cmd_stats *ndctl_dimm_get_first_cmd_stats(
+		struct ndctl_dimm *dimm)
+{
+	return list_top(&dimm->cmd_stats, struct ndctl_cmd_stats, list);
+}
+
+NDCTL_EXPORT struct ndctl_cmd_stats *ndctl_bus_get_first_cmd_stats(
+		struct ndctl_bus *bus)
+{
+	return list_top(&bus->cmd_stats, struct ndctl_cmd_stats, list);
+}
+
+NDCTL_EXPORT struct ndctl_cmd_stats *ndctl_cmd_stats_get_next(
+		struct ndctl_cmd_stats *stats)
+{
+	return list_next(stats->head, stats, list);
+}
+
+NDCTL_EXPORT void ndctl_dimm_reset_cmd_stats(struct ndctl_dimm *dimm)
+{
+	cmd_stats_free(&dimm->cmd_stats);
+}
+
+NDCTL_EXPORT void ndctl_bus_reset_cmd_stats(struct ndctl_bus *bus)
+{
+	cmd_stats_free(&bus->cmd_stats);
+}
+
+NDCTL_EXPORT const char *ndctl_cmd_stats_get_name(
+		struct ndctl_cmd_stats *stats)
+{
+	return stats->name ? stats->name : "unknown";
+}
+
+NDCTL_EXPORT int ndctl_cmd_stats_get_type(struct ndctl_cmd_stats *stats)
+{
+	return stats->type;
+}
+
+NDCTL_EXPORT unsigned long long ndctl_cmd_stats_get_count(
+		struct ndctl_cmd_stats *stats)
+{
+	return stats->count;
+}
+
+NDCTL_EXPORT unsigned long long ndctl_cmd_stats_get_errors(
+		struct ndctl_cmd_stats *stats)
+{
+	return stats->errors;
+}
+
+NDCTL_EXPORT unsigned long long ndctl_cmd_stats_get_fw_errors(
+		struct ndctl_cmd_stats *stats)
+{
+	return stats->fw_errors;
+}
+
+NDCTL_EXPORT unsigned long long ndctl_cmd_stats_get_total_ns(
+		struct ndctl_cmd_stats *stats)
+{
+	return stats->total_ns;
+}
+
+NDCTL_EXPORT unsigned long long ndctl_cmd_stats_get_max_ns(
+		struct ndctl_cmd_stats *stats)
+{
+	return stats->max_ns;
+}
+
+NDCTL_EXPORT unsigned int ndctl_cmd_stats_get_num_buckets(
+		struct ndctl_cmd_stats *stats)
+{
+	return NDCTL_CMD_STATS_BUCKETS;
+}
+
+/*
+ * Bucket @bucket counts the submissions that took less than 2^@bucket
+ * microseconds and at least 2^(@bucket - 1), the last bucket has no
+ * upper bound.
+ */
+NDCTL_EXPORT unsigned long long ndctl_cmd_stats_get_bucket(
+		struct ndctl_cmd_stats *stats, unsigned int bucket)
+{
+	if (bucket >= NDCTL_CMD_STATS_BUCKETS)
+		return 0;
+	return stats->buckets[bucket];
+}
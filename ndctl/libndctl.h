@@ -93,6 +93,7 @@ void ndctl_set_private_data(struct ndctl_ctx *ctx, void *data);
 void *ndctl_get_private_data(struct ndctl_ctx *ctx);
 struct daxctl_ctx;
 struct daxctl_ctx *ndctl_get_daxctl_ctx(struct ndctl_ctx *ctx);
+const char *ndctl_get_sysfs_root(struct ndctl_ctx *ctx);
 void ndctl_invalidate(struct ndctl_ctx *ctx);
 void ndctl_set_log_fn(struct ndctl_ctx *ctx,
                   void (*log_fn)(struct ndctl_ctx *ctx,
@@ -226,6 +227,10 @@ unsigned long long ndctl_cmd_clear_error_get_cleared(
 		struct ndctl_cmd *clear_err);
 unsigned int ndctl_cmd_ars_cap_get_clear_unit(struct ndctl_cmd *ars_cap);
 int ndctl_cmd_ars_stat_get_flag_overflow(struct ndctl_cmd *ars_stat);
+int ndctl_cmd_ars_stat_get_range(struct ndctl_cmd *ars_stat,
+		struct ndctl_range *range);
+int ndctl_cmd_ars_stat_get_restart(struct ndctl_cmd *ars_stat,
+		struct ndctl_range *range);
 
 /*
  * Note: ndctl_cmd_smart_get_temperature is an alias for
@@ -338,10 +343,36 @@ ssize_t ndctl_cmd_cfg_write_zero_data(struct ndctl_cmd *cfg_write);
 void ndctl_cmd_unref(struct ndctl_cmd *cmd);
 void ndctl_cmd_ref(struct ndctl_cmd *cmd);
 int ndctl_cmd_get_type(struct ndctl_cmd *cmd);
+int ndctl_cmd_reset(struct ndctl_cmd *cmd);
 int ndctl_cmd_get_status(struct ndctl_cmd *cmd);
 unsigned int ndctl_cmd_get_firmware_status(struct ndctl_cmd *cmd);
 int ndctl_cmd_submit(struct ndctl_cmd *cmd);
 
+struct ndctl_cmd_stats;
+struct ndctl_cmd_stats *ndctl_dimm_get_first_cmd_stats(struct ndctl_dimm *dimm);
+struct ndctl_cmd_stats *ndctl_bus_get_first_cmd_stats(struct ndctl_bus *bus);
+struct ndctl_cmd_stats *ndctl_cmd_stats_get_next(struct ndctl_cmd_stats *stats);
+#define ndctl_dimm_cmd_stats_foreach(dimm, stats) \
+        for (stats = ndctl_dimm_get_first_cmd_stats(dimm); \
+             stats != NULL; \
+             stats = ndctl_cmd_stats_get_next(stats))
+#define ndctl_bus_cmd_stats_foreach(bus, stats) \
+        for (stats = ndctl_bus_get_first_cmd_stats(bus); \
+             stats != NULL; \
+             stats = ndctl_cmd_stats_get_next(stats))
+void ndctl_dimm_reset_cmd_stats(struct ndctl_dimm *dimm);
+void ndctl_bus_reset_cmd_stats(struct ndctl_bus *bus);
+const char *ndctl_cmd_stats_get_name(struct ndctl_cmd_stats *stats);
+int ndctl_cmd_stats_get_type(struct ndctl_cmd_stats *stats);
+unsigned long long ndctl_cmd_stats_get_count(struct ndctl_cmd_stats *stats);
+unsigned long long ndctl_cmd_stats_get_errors(struct ndctl_cmd_stats *stats);
+unsigned long long ndctl_cmd_stats_get_fw_errors(struct ndctl_cmd_stats *stats);
+unsigned long long ndctl_cmd_stats_get_total_ns(struct ndctl_cmd_stats *stats);
+unsigned long long ndctl_cmd_stats_get_max_ns(struct ndctl_cmd_stats *stats);
+unsigned int ndctl_cmd_stats_get_num_buckets(struct ndctl_cmd_stats *stats);
+unsigned long long ndctl_cmd_stats_get_bucket(struct ndctl_cmd_stats *stats,
+		unsigned int bucket);
+
 struct badblock {
 	unsigned long long offset;
 	unsigned int len;
@@ -730,6 +761,7 @@ int ndctl_dimm_freeze_security(struct ndctl_dimm *dimm);
 int ndctl_dimm_secure_erase(struct ndctl_dimm *dimm, long key);
 int ndctl_dimm_overwrite(struct ndctl_dimm *dimm, long key);
 int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm);
+int ndctl_dimm_open_security(struct ndctl_dimm *dimm);
 int ndctl_dimm_update_master_passphrase(struct ndctl_dimm *dimm,
 		long ckey, long nkey);
 int ndctl_dimm_master_secure_erase(struct ndctl_dimm *dimm, long key);
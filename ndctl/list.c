@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <string.h>
+#include <uuid/uuid.h>
 
 #include <util/json.h>
 #include <util/filter.h>
@@ -38,6 +40,10 @@ static struct {
 	bool firmware;
 	bool capabilities;
 	bool configured;
+	bool stats;
+	bool ndjson;
+	bool csv;
+	const char *fields;
 	int verbose;
 } list;
 
@@ -240,22 +246,57 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 	return NULL;
 }
 
+/*
+ * In streaming mode hand the last top-level container (bus, or region
+ * when buses are not listed) to the output once all of its children
+ * have been collected.
+ */
+static void list_stream_flush(struct list_filter_arg *lfa)
+{
+	struct json_object **jtop = NULL;
+
+	if (list.buses)
+		jtop = &lfa->jbus;
+	else if (list.regions)
+		jtop = &lfa->jregion;
+
+	if (!jtop || !*jtop)
+		return;
+
+	if (util_json_stream_add(lfa->stream, *jtop))
+		fail("\n");
+	*jtop = NULL;
+}
+
+static bool namespace_is_listed(struct ndctl_namespace *ndns)
+{
+	unsigned long long size = ndctl_namespace_get_size(ndns);
+
+	if (ndctl_namespace_is_active(ndns))
+		return true;
+	if (list.idle)
+		return true;
+	if (list.configured && (size > 0 && size < ULLONG_MAX))
+		return true;
+	return false;
+}
+
 static void filter_namespace(struct ndctl_namespace *ndns,
 		struct util_filter_ctx *ctx)
 {
 	struct json_object *jndns;
 	struct list_filter_arg *lfa = ctx->list;
 	struct json_object *container = lfa->jregion ? lfa->jregion : lfa->jbus;
-	unsigned long long size = ndctl_namespace_get_size(ndns);
 
-	if (ndctl_namespace_is_active(ndns))
-		/* pass */;
-	else if (list.idle)
-		/* pass */;
-	else if (list.configured && (size > 0 && size < ULLONG_MAX))
-		/* pass */;
-	else
+	if (!namespace_is_listed(ndns))
+		return;
+
+	if (lfa->stream && !container) {
+		if (util_json_stream_add(lfa->stream,
+					util_namespace_to_json(ndns, lfa->flags)))
+			fail("\n");
 		return;
+	}
 
 	if (!lfa->jnamespaces) {
 		lfa->jnamespaces = json_object_new_array();
@@ -291,6 +332,17 @@ static bool filter_region(struct ndctl_region *region,
 	if (!list.configured && !list.idle && !ndctl_region_is_enabled(region))
 		return true;
 
+	if (lfa->stream && !jbus) {
+		list_stream_flush(lfa);
+		lfa->jregion = region_to_json(region, lfa->flags);
+		lfa->jnamespaces = NULL;
+		if (!lfa->jregion) {
+			fail("\n");
+			return false;
+		}
+		return true;
+	}
+
 	if (!lfa->jregions) {
 		lfa->jregions = json_object_new_array();
 		if (!lfa->jregions) {
@@ -333,7 +385,7 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
 	if (!list.configured && !list.idle && !ndctl_dimm_is_enabled(dimm))
 		return;
 
-	if (!lfa->jdimms) {
+	if (!lfa->jdimms && !(lfa->stream && !lfa->jbus)) {
 		lfa->jdimms = json_object_new_array();
 		if (!lfa->jdimms) {
 			fail("\n");
@@ -375,23 +427,39 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
 			json_object_object_add(jdimm, "firmware", jfirmware);
 	}
 
+	/* statistics for the commands issued by the requests above */
+	if (list.stats) {
+		struct json_object *jstats;
+
+		jstats = util_cmd_stats_to_json(
+				ndctl_dimm_get_first_cmd_stats(dimm));
+		if (jstats)
+			json_object_object_add(jdimm, "command_stats", jstats);
+	}
+
 	/*
 	 * Without a bus we are collecting dimms anonymously across the
 	 * platform.
 	 */
-	json_object_array_add(lfa->jdimms, jdimm);
+	if (lfa->jdimms)
+		json_object_array_add(lfa->jdimms, jdimm);
+	else if (util_json_stream_add(lfa->stream, jdimm))
+		fail("\n");
 }
 
 static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
 {
 	struct list_filter_arg *lfa = ctx->list;
 
+	if (lfa->stream)
+		list_stream_flush(lfa);
+
 	/*
 	 * These sub-objects are local to a bus and, if present, have
 	 * been added as a child of a parent object on the last
 	 * iteration.
 	 */
-	if (lfa->jbuses) {
+	if (lfa->jbuses || lfa->stream) {
 		lfa->jdimms = NULL;
 		lfa->jregion = NULL;
 		lfa->jregions = NULL;
@@ -401,6 +469,15 @@ static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
 	if (!list.buses)
 		return true;
 
+	if (lfa->stream) {
+		lfa->jbus = util_bus_to_json(bus);
+		if (!lfa->jbus) {
+			fail("\n");
+			return false;
+		}
+		return true;
+	}
+
 	if (!lfa->jbuses) {
 		lfa->jbuses = json_object_new_array();
 		if (!lfa->jbuses) {
@@ -454,11 +531,582 @@ static int list_display(struct list_filter_arg *lfa)
 	return 0;
 }
 
+/*
+ * Flat output (--fields, --csv): one row per object of a single type,
+ * where each field calls only the getters it needs.
+ */
+static struct json_object *list_string(const char *str)
+{
+	if (!str || !str[0])
+		return NULL;
+	return json_object_new_string(str);
+}
+
+static struct json_object *list_size(unsigned long long size,
+		unsigned long flags)
+{
+	if (size == ULLONG_MAX)
+		return NULL;
+	return util_json_object_size(size, flags);
+}
+
+static struct json_object *list_node(int node)
+{
+	if (node < 0)
+		return NULL;
+	return json_object_new_int(node);
+}
+
+static struct json_object *bus_field_provider(void *bus, unsigned long flags)
+{
+	return list_string(ndctl_bus_get_provider(bus));
+}
+
+static struct json_object *bus_field_dev(void *bus, unsigned long flags)
+{
+	return list_string(ndctl_bus_get_devname(bus));
+}
+
+static struct json_object *bus_field_scrub_state(void *bus,
+		unsigned long flags)
+{
+	int scrub = ndctl_bus_get_scrub_state(bus);
+
+	if (scrub < 0)
+		return NULL;
+	return json_object_new_string(scrub ? "active" : "idle");
+}
+
+static const struct util_json_field bus_fields[] = {
+	{ "provider", bus_field_provider },
+	{ "dev", bus_field_dev },
+	{ "scrub_state", bus_field_scrub_state },
+};
+
+/*
+ * The health and firmware fields of a row share one command each, the
+ * result is cached until the next row.
+ */
+static struct {
+	struct ndctl_dimm *dimm;
+	struct json_object *jhealth;
+	struct json_object *jfirmware;
+} dimm_row;
+
+static void dimm_row_reset(void)
+{
+	json_object_put(dimm_row.jhealth);
+	json_object_put(dimm_row.jfirmware);
+	memset(&dimm_row, 0, sizeof(dimm_row));
+}
+
+static struct json_object *dimm_row_get(struct json_object *jobj,
+		const char *key)
+{
+	struct json_object *jval;
+
+	if (!jobj || !json_object_object_get_ex(jobj, key, &jval))
+		return NULL;
+	return json_object_get(jval);
+}
+
+static struct json_object *dimm_health_field(struct ndctl_dimm *dimm,
+		const char *key)
+{
+	if (dimm_row.dimm != dimm) {
+		dimm_row_reset();
+		dimm_row.dimm = dimm;
+	}
+	if (!dimm_row.jhealth)
+		dimm_row.jhealth = util_dimm_health_to_json(dimm);
+	return dimm_row_get(dimm_row.jhealth, key);
+}
+
+static struct json_object *dimm_firmware_field(struct ndctl_dimm *dimm,
+		const char *key, unsigned long flags)
+{
+	if (dimm_row.dimm != dimm) {
+		dimm_row_reset();
+		dimm_row.dimm = dimm;
+	}
+	if (!dimm_row.jfirmware)
+		dimm_row.jfirmware = util_dimm_firmware_to_json(dimm, flags);
+	return dimm_row_get(dimm_row.jfirmware, key);
+}
+
+static struct json_object *dimm_field_dev(void *dimm, unsigned long flags)
+{
+	return list_string(ndctl_dimm_get_devname(dimm));
+}
+
+static struct json_object *dimm_field_id(void *dimm, unsigned long flags)
+{
+	return list_string(ndctl_dimm_get_unique_id(dimm));
+}
+
+static struct json_object *dimm_field_handle(void *dimm, unsigned long flags)
+{
+	unsigned int handle = ndctl_dimm_get_handle(dimm);
+
+	if (handle >= UINT_MAX)
+		return NULL;
+	return util_json_object_hex(handle, flags);
+}
+
+static struct json_object *dimm_field_phys_id(void *dimm, unsigned long flags)
+{
+	unsigned short phys_id = ndctl_dimm_get_phys_id(dimm);
+
+	if (phys_id >= USHRT_MAX)
+		return NULL;
+	return util_json_object_hex(phys_id, flags);
+}
+
+static struct json_object *dimm_field_state(void *dimm, unsigned long flags)
+{
+	return json_object_new_string(ndctl_dimm_is_enabled(dimm)
+			? "enabled" : "disabled");
+}
+
+static struct json_object *dimm_field_security(void *dimm,
+		unsigned long flags)
+{
+	switch (ndctl_dimm_get_security(dimm)) {
+	case NDCTL_SECURITY_DISABLED:
+		return json_object_new_string("disabled");
+	case NDCTL_SECURITY_UNLOCKED:
+		return json_object_new_string("unlocked");
+	case NDCTL_SECURITY_LOCKED:
+		return json_object_new_string("locked");
+	case NDCTL_SECURITY_FROZEN:
+		return json_object_new_string("frozen");
+	case NDCTL_SECURITY_OVERWRITE:
+		return json_object_new_string("overwrite");
+	default:
+		return NULL;
+	}
+}
+
+#define DIMM_HEALTH_FIELD(key) \
+static struct json_object *dimm_field_##key(void *dimm, unsigned long flags) \
+{ \
+	return dimm_health_field(dimm, #key); \
+}
+
+DIMM_HEALTH_FIELD(health_state)
+DIMM_HEALTH_FIELD(temperature_celsius)
+DIMM_HEALTH_FIELD(spares_percentage)
+DIMM_HEALTH_FIELD(life_used_percentage)
+DIMM_HEALTH_FIELD(shutdown_state)
+DIMM_HEALTH_FIELD(shutdown_count)
+
+static struct json_object *dimm_field_firmware_version(void *dimm,
+		unsigned long flags)
+{
+	return dimm_firmware_field(dimm, "current_version", flags);
+}
+
+static const struct util_json_field dimm_fields[] = {
+	{ "dev", dimm_field_dev },
+	{ "id", dimm_field_id },
+	{ "handle", dimm_field_handle },
+	{ "phys_id", dimm_field_phys_id },
+	{ "state", dimm_field_state },
+	{ "security", dimm_field_security },
+	{ "health_state", dimm_field_health_state },
+	{ "temperature_celsius", dimm_field_temperature_celsius },
+	{ "spares_percentage", dimm_field_spares_percentage },
+	{ "life_used_percentage", dimm_field_life_used_percentage },
+	{ "shutdown_state", dimm_field_shutdown_state },
+	{ "shutdown_count", dimm_field_shutdown_count },
+	{ "firmware_version", dimm_field_firmware_version },
+};
+
+static struct json_object *region_field_dev(void *region, unsigned long flags)
+{
+	return list_string(ndctl_region_get_devname(region));
+}
+
+static struct json_object *region_field_size(void *region, unsigned long flags)
+{
+	return list_size(ndctl_region_get_size(region), flags);
+}
+
+static struct json_object *region_field_available_size(void *region,
+		unsigned long flags)
+{
+	return list_size(ndctl_region_get_available_size(region), flags);
+}
+
+static struct json_object *region_field_max_available_extent(void *region,
+		unsigned long flags)
+{
+	return list_size(ndctl_region_get_max_available_extent(region), flags);
+}
+
+static struct json_object *region_field_align(void *region,
+		unsigned long flags)
+{
+	return list_size(ndctl_region_get_align(region), flags);
+}
+
+static struct json_object *region_field_type(void *region, unsigned long flags)
+{
+	switch (ndctl_region_get_type(region)) {
+	case ND_DEVICE_REGION_PMEM:
+		return json_object_new_string("pmem");
+	case ND_DEVICE_REGION_BLK:
+		return json_object_new_string("blk");
+	default:
+		return NULL;
+	}
+}
+
+static struct json_object *region_field_numa_node(void *region,
+		unsigned long flags)
+{
+	return list_node(ndctl_region_get_numa_node(region));
+}
+
+static struct json_object *region_field_target_node(void *region,
+		unsigned long flags)
+{
+	return list_node(ndctl_region_get_target_node(region));
+}
+
+static struct json_object *region_field_iset_id(void *region,
+		unsigned long flags)
+{
+	struct ndctl_interleave_set *iset;
+
+	iset = ndctl_region_get_interleave_set(region);
+	if (!iset)
+		return NULL;
+	return util_json_object_hex(ndctl_interleave_set_get_cookie(iset),
+			flags);
+}
+
+static struct json_object *region_field_state(void *region,
+		unsigned long flags)
+{
+	return json_object_new_string(ndctl_region_is_enabled(region)
+			? "enabled" : "disabled");
+}
+
+static struct json_object *region_field_persistence_domain(void *region,
+		unsigned long flags)
+{
+	switch (ndctl_region_get_persistence_domain(region)) {
+	case PERSISTENCE_CPU_CACHE:
+		return json_object_new_string("cpu_cache");
+	case PERSISTENCE_MEM_CTRL:
+		return json_object_new_string("memory_controller");
+	case PERSISTENCE_NONE:
+		return json_object_new_string("none");
+	default:
+		return json_object_new_string("unknown");
+	}
+}
+
+static struct json_object *region_field_badblock_count(void *region,
+		unsigned long flags)
+{
+	unsigned int bb_count = 0;
+
+	json_object_put(util_region_badblocks_to_json(region, &bb_count,
+				flags));
+	return json_object_new_int(bb_count);
+}
+
+static const struct util_json_field region_fields[] = {
+	{ "dev", region_field_dev },
+	{ "size", region_field_size },
+	{ "available_size", region_field_available_size },
+	{ "max_available_extent", region_field_max_available_extent },
+	{ "align", region_field_align },
+	{ "type", region_field_type },
+	{ "numa_node", region_field_numa_node },
+	{ "target_node", region_field_target_node },
+	{ "iset_id", region_field_iset_id },
+	{ "state", region_field_state },
+	{ "persistence_domain", region_field_persistence_domain },
+	{ "badblock_count", region_field_badblock_count },
+};
+
+static struct json_object *namespace_field_dev(void *ndns,
+		unsigned long flags)
+{
+	return list_string(ndctl_namespace_get_devname(ndns));
+}
+
+static struct json_object *namespace_field_mode(void *ndns,
+		unsigned long flags)
+{
+	switch (ndctl_namespace_get_mode(ndns)) {
+	case NDCTL_NS_MODE_MEMORY:
+		return json_object_new_string("fsdax");
+	case NDCTL_NS_MODE_DAX:
+		return json_object_new_string("devdax");
+	case NDCTL_NS_MODE_SECTOR:
+		return json_object_new_string("sector");
+	case NDCTL_NS_MODE_RAW:
+		return json_object_new_string("raw");
+	default:
+		return NULL;
+	}
+}
+
+/* usable capacity, after any btt / pfn / dax metadata, as 'list' reports */
+static struct json_object *namespace_field_size(void *ndns,
+		unsigned long flags)
+{
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
+
+	if (btt)
+		return list_size(ndctl_btt_get_size(btt), flags);
+	if (pfn)
+		return list_size(ndctl_pfn_get_size(pfn), flags);
+	if (dax)
+		return list_size(ndctl_dax_get_size(dax), flags);
+	return list_size(ndctl_namespace_get_size(ndns), flags);
+}
+
+static struct json_object *namespace_field_uuid(void *ndns,
+		unsigned long flags)
+{
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
+	char buf[40];
+	uuid_t uuid;
+
+	if (btt)
+		ndctl_btt_get_uuid(btt, uuid);
+	else if (pfn)
+		ndctl_pfn_get_uuid(pfn, uuid);
+	else if (dax)
+		ndctl_dax_get_uuid(dax, uuid);
+	else if (ndctl_namespace_get_type(ndns) != ND_DEVICE_NAMESPACE_IO)
+		ndctl_namespace_get_uuid(ndns, uuid);
+	else
+		return NULL;
+	uuid_unparse(uuid, buf);
+	return json_object_new_string(buf);
+}
+
+static struct json_object *namespace_field_blockdev(void *ndns,
+		unsigned long flags)
+{
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+
+	if (btt)
+		return list_string(ndctl_btt_get_block_device(btt));
+	if (pfn)
+		return list_string(ndctl_pfn_get_block_device(pfn));
+	if (ndctl_namespace_get_dax(ndns))
+		return NULL;
+	return list_string(ndctl_namespace_get_block_device(ndns));
+}
+
+static struct json_object *namespace_field_sector_size(void *ndns,
+		unsigned long flags)
+{
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+	unsigned int sector_size;
+
+	if (btt)
+		return json_object_new_int(ndctl_btt_get_sector_size(btt));
+	if (ndctl_namespace_get_dax(ndns))
+		return NULL;
+	sector_size = ndctl_namespace_get_sector_size(ndns);
+	if (!sector_size || sector_size == UINT_MAX)
+		sector_size = 512;
+	return json_object_new_int(sector_size);
+}
+
+static struct json_object *namespace_field_state(void *ndns,
+		unsigned long flags)
+{
+	return json_object_new_string(ndctl_namespace_is_active(ndns)
+			? "enabled" : "disabled");
+}
+
+static struct json_object *namespace_field_name(void *ndns,
+		unsigned long flags)
+{
+	return list_string(ndctl_namespace_get_alt_name(ndns));
+}
+
+static struct json_object *namespace_field_region(void *ndns,
+		unsigned long flags)
+{
+	return list_string(ndctl_region_get_devname(
+				ndctl_namespace_get_region(ndns)));
+}
+
+static struct json_object *namespace_field_numa_node(void *ndns,
+		unsigned long flags)
+{
+	return list_node(ndctl_namespace_get_numa_node(ndns));
+}
+
+static struct json_object *namespace_field_target_node(void *ndns,
+		unsigned long flags)
+{
+	return list_node(ndctl_namespace_get_target_node(ndns));
+}
+
+static const struct util_json_field namespace_fields[] = {
+	{ "dev", namespace_field_dev },
+	{ "mode", namespace_field_mode },
+	{ "size", namespace_field_size },
+	{ "uuid", namespace_field_uuid },
+	{ "blockdev", namespace_field_blockdev },
+	{ "sector_size", namespace_field_sector_size },
+	{ "state", namespace_field_state },
+	{ "name", namespace_field_name },
+	{ "region", namespace_field_region },
+	{ "numa_node", namespace_field_numa_node },
+	{ "target_node", namespace_field_target_node },
+};
+
+/* sized for the table of the listed object type, see list_flat() */
+static const struct util_json_field **flat_sel;
+static int flat_num_sel;
+
+static void flat_row(struct list_filter_arg *lfa, void *obj)
+{
+	struct json_object *jrow;
+
+	jrow = util_json_fields_to_json(obj, flat_sel, flat_num_sel,
+			lfa->flags);
+	dimm_row_reset();
+	if (util_json_stream_add(lfa->stream, jrow))
+		fail("\n");
+}
+
+static bool flat_filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
+{
+	if (list.buses)
+		flat_row(ctx->list, bus);
+	return true;
+}
+
+static bool flat_filter_region(struct ndctl_region *region,
+		struct util_filter_ctx *ctx)
+{
+	if (!list.regions)
+		return true;
+	if (!list.configured && !list.idle && !ndctl_region_is_enabled(region))
+		return true;
+	flat_row(ctx->list, region);
+	return true;
+}
+
+static void flat_filter_dimm(struct ndctl_dimm *dimm,
+		struct util_filter_ctx *ctx)
+{
+	if (!list.configured && !list.idle && !ndctl_dimm_is_enabled(dimm))
+		return;
+	flat_row(ctx->list, dimm);
+}
+
+static void flat_filter_namespace(struct ndctl_namespace *ndns,
+		struct util_filter_ctx *ctx)
+{
+	if (!namespace_is_listed(ndns))
+		return;
+	flat_row(ctx->list, ndns);
+}
+
+static int list_flat(struct ndctl_ctx *ctx, unsigned long flags,
+		enum util_json_stream_format format)
+{
+	static const char * const default_fields[] = {
+		"provider,dev",
+		"dev,id,handle,phys_id,state",
+		"dev,size,available_size,type,state",
+		"dev,mode,size,uuid,blockdev,state",
+	};
+	const struct util_json_field *table;
+	struct util_filter_ctx fctx = { 0 };
+	struct list_filter_arg lfa = { 0 };
+	struct util_json_stream stream;
+	const char *fields = list.fields;
+	int table_len, rc;
+
+	if (list.buses + list.dimms + list.regions + list.namespaces != 1) {
+		error("--fields and --csv list exactly one of --buses, --dimms, --regions, or --namespaces\n");
+		return -EINVAL;
+	}
+
+	if (list.buses) {
+		table = bus_fields;
+		table_len = ARRAY_SIZE(bus_fields);
+		fields = fields ? fields : default_fields[0];
+	} else if (list.dimms) {
+		table = dimm_fields;
+		table_len = ARRAY_SIZE(dimm_fields);
+		fields = fields ? fields : default_fields[1];
+	} else if (list.regions) {
+		table = region_fields;
+		table_len = ARRAY_SIZE(region_fields);
+		fields = fields ? fields : default_fields[2];
+	} else {
+		table = namespace_fields;
+		table_len = ARRAY_SIZE(namespace_fields);
+		fields = fields ? fields : default_fields[3];
+	}
+
+	flat_sel = calloc(table_len, sizeof(*flat_sel));
+	if (!flat_sel)
+		return -ENOMEM;
+	flat_num_sel = util_json_fields_parse(fields, table, table_len,
+			flat_sel, table_len);
+	if (flat_num_sel < 0) {
+		rc = flat_num_sel;
+		goto out;
+	}
+
+	fctx.filter_bus = flat_filter_bus;
+	fctx.filter_dimm = list.dimms ? flat_filter_dimm : NULL;
+	fctx.filter_region = flat_filter_region;
+	fctx.filter_namespace = list.namespaces ? flat_filter_namespace : NULL;
+	fctx.list = &lfa;
+	lfa.flags = flags;
+	lfa.stream = &stream;
+
+	util_json_stream_init(&stream, stdout, flags, format);
+	rc = util_filter_walk(ctx, &fctx, &param);
+	util_json_stream_end(&stream);
+	if (!rc && did_fail)
+		rc = -ENOMEM;
+out:
+	free(flat_sel);
+	flat_sel = NULL;
+	return rc;
+}
+
 static int num_list_flags(void)
 {
 	return list.buses + list.dimms + list.regions + list.namespaces;
 }
 
+/*
+ * Only the combinations that print a flat array can be emitted as the
+ * walk progresses, the multi-type "platform" object is still assembled
+ * in full. With --ndjson every top-level object is its own line.
+ */
+static bool list_can_stream(void)
+{
+	if (list.ndjson || list.buses)
+		return true;
+	return (list.dimms + list.regions + list.namespaces) == 1;
+}
+
 int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 {
 	const struct option options[] = {
@@ -479,6 +1127,8 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 		OPT_BOOLEAN('D', "dimms", &list.dimms, "include dimm info"),
 		OPT_BOOLEAN('F', "firmware", &list.firmware, "include firmware info"),
 		OPT_BOOLEAN('H', "health", &list.health, "include dimm health"),
+		OPT_BOOLEAN('\0', "stats", &list.stats,
+				"include dimm command statistics"),
 		OPT_BOOLEAN('R', "regions", &list.regions,
 				"include region info"),
 		OPT_BOOLEAN('N', "namespaces", &list.namespaces,
@@ -496,6 +1146,12 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 				"use human friendly number formats "),
 		OPT_INCR('v', "verbose", &list.verbose,
 				"increase output detail"),
+		OPT_BOOLEAN('\0', "ndjson", &list.ndjson,
+				"emit one json object per line"),
+		OPT_BOOLEAN('\0', "csv", &list.csv,
+				"emit comma separated values"),
+		OPT_STRING('\0', "fields", &list.fields, "field list",
+				"list only these comma separated fields"),
 		OPT_END(),
 	};
 	const char * const u[] = {
@@ -505,6 +1161,8 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 	bool lint = !!secure_getenv("NDCTL_LIST_LINT");
 	struct util_filter_ctx fctx = { 0 };
 	struct list_filter_arg lfa = { 0 };
+	enum util_json_stream_format format = UTIL_JSON_STREAM_ARRAY;
+	struct util_json_stream stream;
 	int i, rc;
 
         argc = parse_options(argc, argv, options, u, 0);
@@ -551,6 +1209,18 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 	if (num_list_flags() == 0)
 		list.namespaces = true;
 
+	if (list.csv && list.ndjson) {
+		error("--csv and --ndjson are mutually exclusive\n");
+		usage_with_options(u, options);
+	}
+	if (list.csv)
+		format = UTIL_JSON_STREAM_CSV;
+	else if (list.ndjson)
+		format = UTIL_JSON_STREAM_NDJSON;
+
+	if (list.fields || list.csv)
+		return list_flat(ctx, listopts_to_flags(), format);
+
 	fctx.filter_bus = filter_bus;
 	fctx.filter_dimm = list.dimms ? filter_dimm : NULL;
 	fctx.filter_region = filter_region;
@@ -558,11 +1228,20 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 	fctx.list = &lfa;
 	lfa.flags = listopts_to_flags();
 
+	if (list_can_stream()) {
+		util_json_stream_init(&stream, stdout, lfa.flags, format);
+		lfa.stream = &stream;
+	}
+
 	rc = util_filter_walk(ctx, &fctx, &param);
+	if (lfa.stream) {
+		list_stream_flush(&lfa);
+		util_json_stream_end(&stream);
+	}
 	if (rc)
 		return rc;
 
-	if (list_display(&lfa) || did_fail)
+	if ((!lfa.stream && list_display(&lfa)) || did_fail)
 		return -ENOMEM;
 	return 0;
 }
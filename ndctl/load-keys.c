@@ -6,24 +6,30 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <keyutils.h>
 #include <util/json.h>
+#include <util/clock.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <ndctl/libndctl.h>
 #include <util/parse-options.h>
 #include <ccan/array_size/array_size.h>
+#include <util/jobs.h>
 #include <util/keys.h>
 #include <ndctl.h>
 
 static struct parameters {
 	const char *key_path;
 	const char *tpm_handle;
-} param;
+	unsigned int jobs;
+} param = {
+	.jobs = 1,
+};
 
 static const char *key_names[] = {"user", "trusted", "encrypted"};
 
@@ -79,14 +85,58 @@ static int load_master_key(struct loadkeys *lk_ctx, const char *keypath)
 	return 0;
 }
 
-static int load_dimm_keys(struct loadkeys *lk_ctx)
+struct dimm_key {
+	char *fname;
+	char *idbuf;
+	const char *id;
+	int dirfd;
+};
+
+/*
+ * Runs as a util_jobs_run() job, the encrypted key is instantiated
+ * against the master key in the user keyring, which is shared with
+ * the parent.
+ */
+static int load_dimm_key(void *arg, FILE *f_out)
 {
-	int rc;
-	struct dirent *dent;
-	char *fname = NULL, *id, *blob = NULL;
+	unsigned long long start = now_ns();
+	struct dimm_key *dkey = arg;
 	char desc[ND_KEY_DESC_SIZE];
-	int size, count = 0;
 	key_serial_t key;
+	char *blob;
+	int size;
+
+	blob = ndctl_load_key_blob(dkey->fname, &size, NULL, dkey->dirfd,
+			KEY_ENCRYPTED);
+	if (!blob)
+		return -ENOENT;
+
+	if (snprintf(desc, sizeof(desc), "nvdimm:%s", dkey->id)
+			>= (int) sizeof(desc)) {
+		free(blob);
+		return -EINVAL;
+	}
+
+	key = add_key("encrypted", desc, blob, size, KEY_SPEC_USER_KEYRING);
+	free(blob);
+	if (key < 0) {
+		fprintf(stderr, "%s: add_key failed: %s\n", desc,
+				strerror(errno));
+		return -errno;
+	}
+
+	fprintf(f_out, "%llu\n", now_ns() - start);
+	return 0;
+}
+
+static int load_dimm_keys(struct loadkeys *lk_ctx)
+{
+	struct dimm_key *dkeys = NULL, *dkey;
+	struct util_job *jobs = NULL;
+	int i, rc, num = 0, count = 0;
+	unsigned long long start;
+	struct dirent *dent;
+	char *fname, *id;
 
 	while ((dent = readdir(lk_ctx->dir)) != NULL) {
 		if (dent->d_type != DT_REG)
@@ -96,7 +146,8 @@ static int load_dimm_keys(struct loadkeys *lk_ctx)
 		if (!fname) {
 			fprintf(stderr, "Unable to strdup %s\n",
 					dent->d_name);
-			return -ENOMEM;
+			rc = -ENOMEM;
+			goto out;
 		}
 
 		/*
@@ -104,11 +155,7 @@ static int load_dimm_keys(struct loadkeys *lk_ctx)
 		 * as the nvdimm id.
 		 */
 		id = strtok(fname, "_");
-		if (!id) {
-			free(fname);
-			continue;
-		}
-		if (strcmp(id, "nvdimm") != 0) {
+		if (!id || strcmp(id, "nvdimm") != 0) {
 			free(fname);
 			continue;
 		}
@@ -118,34 +165,71 @@ static int load_dimm_keys(struct loadkeys *lk_ctx)
 			continue;
 		}
 
-		blob = ndctl_load_key_blob(dent->d_name, &size, NULL,
-				lk_ctx->dirfd, KEY_ENCRYPTED);
-		if (!blob) {
+		dkey = realloc(dkeys, (num + 1) * sizeof(*dkeys));
+		if (!dkey) {
 			free(fname);
-			continue;
+			rc = -ENOMEM;
+			goto out;
 		}
-
-		rc = sprintf(desc, "nvdimm:%s", id);
-		if (rc < 0) {
-			free(fname);
-			free(blob);
-			continue;
+		dkeys = dkey;
+		dkeys[num] = (struct dimm_key) {
+			.idbuf = fname,
+			.id = id,
+			.dirfd = lk_ctx->dirfd,
+		};
+		dkeys[num].fname = strdup(dent->d_name);
+		if (!dkeys[num++].fname) {
+			rc = -ENOMEM;
+			goto out;
 		}
+	}
 
-		key = add_key("encrypted", desc, blob, size,
-				KEY_SPEC_USER_KEYRING);
-		if (key < 0)
-			fprintf(stderr, "add_key failed: %s\n",
-					strerror(errno));
-		else
-			count++;
-		free(fname);
-		free(blob);
+	if (!num) {
+		printf("0 nvdimm keys loaded\n");
+		return 0;
 	}
 
-	printf("%d nvdimm keys loaded\n", count);
+	jobs = calloc(num, sizeof(*jobs));
+	if (!jobs) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < num; i++) {
+		jobs[i].run = load_dimm_key;
+		jobs[i].arg = &dkeys[i];
+	}
 
-	return 0;
+	start = now_ns();
+	rc = util_jobs_run(jobs, num, param.jobs);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		unsigned long long ns;
+
+		if (jobs[i].rc || !jobs[i].out
+				|| sscanf(jobs[i].out, "%llu", &ns) != 1)
+			continue;
+		printf("nvdimm:%s key loaded in %llu.%03llu ms\n",
+				dkeys[i].id, ns / 1000000,
+				ns / 1000 % 1000);
+		count++;
+	}
+
+	start = now_ns() - start;
+	printf("%d nvdimm keys loaded in %llu.%03llu ms\n", count,
+			start / 1000000, start / 1000 % 1000);
+
+ out:
+	for (i = 0; jobs && i < num; i++)
+		free(jobs[i].out);
+	for (i = 0; i < num; i++) {
+		free(dkeys[i].fname);
+		free(dkeys[i].idbuf);
+	}
+	free(dkeys);
+	free(jobs);
+	return rc;
 }
 
 static int check_tpm_handle(struct loadkeys *lk_ctx)
@@ -235,6 +319,8 @@ int cmd_load_keys(int argc, const char **argv, struct ndctl_ctx *ctx)
 				"override the default key path"),
 		OPT_STRING('t', "tpm-handle", &param.tpm_handle, "tpm-handle",
 				"TPM handle for trusted key"),
+		OPT_UINTEGER('j', "jobs", &param.jobs,
+				"load up to <n> nvdimm keys in parallel"),
 		OPT_END(),
 	};
 	const char *const u[] = {
@@ -2,6 +2,7 @@
 /* Copyright(c) 2018, FUJITSU LIMITED. All rights reserved. */
 
 #include <stdio.h>
+#include <limits.h>
 #include <json-c/json.h>
 #include <libgen.h>
 #include <time.h>
@@ -15,6 +16,12 @@
 #include <ndctl/ndctl.h>
 #include <ndctl/libndctl.h>
 #include <sys/epoll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
 #define BUF_SIZE 2048
 
 /* reuse the core log helpers for the monitor logger */
@@ -28,25 +35,84 @@
 
 static struct monitor {
 	const char *log;
+	const char *metrics;
+	const char *metrics_socket;
+	int metrics_fd;
 	const char *config_file;
 	const char *dimm_event;
 	FILE *log_file;
 	bool daemon;
 	bool human;
 	bool verbose;
+	bool changes_only;
+	bool stats;
 	unsigned int poll_timeout;
+	unsigned int rate_limit;
+	unsigned int flush_interval;
 	unsigned int event_flags;
+	/* CLOCK_BOOTTIME milliseconds of the last log_file flush */
+	unsigned long long flush_ts;
+	bool log_dirty;
+	/* signal mask applied while waiting, see cmd_monitor() */
+	sigset_t *wait_sigmask;
 	struct log_ctx ctx;
 } monitor;
 
+static volatile sig_atomic_t monitor_exiting;
+
+/* decoded subset of the SMART payload sampled on each poll */
+struct monitor_smart {
+	unsigned int flags;
+	unsigned int health;
+	unsigned int temperature;
+	unsigned int ctrl_temperature;
+	unsigned int spares;
+	unsigned int alarm_flags;
+	unsigned int life_used;
+	unsigned int shutdown_state;
+	unsigned int shutdown_count;
+};
+
 struct monitor_dimm {
 	struct ndctl_dimm *dimm;
 	int health_eventfd;
 	unsigned int health;
 	unsigned int event_flags;
+	struct monitor_smart smart;
+	/* @smart and @health hold a successful sample */
+	bool sampled;
+	/* allocated once and reset for each poll */
+	struct ndctl_cmd *smart_cmd;
+	/* alarm thresholds, valid when @alarm_control is non-zero */
+	struct util_smart_threshold threshold;
+	unsigned long long notifications;
+	bool trending;
+	/* state as of the last notification, for --changes-only */
+	struct monitor_smart notified_smart;
+	unsigned long long notify_ts;
+	bool notified;
+	/* events held back by --rate-limit, and the flags of the latest */
+	unsigned long long suppressed;
+	unsigned int pending_flags;
+	/* CLOCK_BOOTTIME milliseconds of the next scheduled poll */
+	unsigned long long deadline;
+	unsigned long interval;
 	struct list_node list;
 };
 
+/*
+ * With --poll each DIMM is polled at its own deadline. The interval
+ * halves (down to MIN) while a DIMM trends toward an alarm threshold
+ * and grows back by a quarter of the base interval per quiet poll (up
+ * to MAX).
+ */
+#define POLL_INTERVAL_MIN_DIV 4
+#define POLL_INTERVAL_MAX_MUL 2
+#define POLL_INTERVAL_FLOOR_MS 1000
+#define POLL_TEMP_MARGIN 5.0 /* Celsius */
+#define POLL_TEMP_RISE 2.0 /* Celsius since the previous sample */
+#define POLL_SPARES_MARGIN 10 /* percent */
+
 static struct util_filter_params param;
 
 static int did_fail;
@@ -58,6 +124,14 @@ do { \
 			VERSION, __func__, __LINE__, ##__VA_ARGS__); \
 } while (0)
 
+static unsigned long long monitor_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
 static void log_syslog(struct log_ctx *ctx, int priority, const char *file,
 		int line, const char *fn, const char *format, va_list args)
 {
@@ -87,7 +161,45 @@ static void log_file(struct log_ctx *ctx, int priority, const char *file,
 	} else
 		vfprintf(f, format, args);
 
-	fflush(f);
+	/*
+	 * With --flush-interval only errors and warnings are flushed
+	 * immediately, everything else waits for monitor_flush_log().
+	 */
+	if (!monitor.flush_interval || priority < LOG_NOTICE) {
+		fflush(f);
+		monitor.flush_ts = monitor_now_ms();
+		monitor.log_dirty = false;
+	} else
+		monitor.log_dirty = true;
+}
+
+static void monitor_flush_log(unsigned long long now, bool force)
+{
+	if (!monitor.log_dirty)
+		return;
+	if (!force && now - monitor.flush_ts < monitor.flush_interval * 1000ULL)
+		return;
+	fflush(monitor.log_file);
+	monitor.flush_ts = now;
+	monitor.log_dirty = false;
+}
+
+/* milliseconds until buffered log output is due to be flushed */
+static int monitor_flush_timeout(unsigned long long now)
+{
+	unsigned long long deadline;
+
+	if (!monitor.log_dirty)
+		return -1;
+	deadline = monitor.flush_ts + monitor.flush_interval * 1000ULL;
+	if (deadline <= now)
+		return 0;
+	return min(deadline - now, (unsigned long long) INT_MAX);
+}
+
+static void monitor_sig_exit(int sig)
+{
+	monitor_exiting = 1;
 }
 
 static struct json_object *dimm_event_to_json(struct monitor_dimm *mdimm)
@@ -172,6 +284,12 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 	if (jobj)
 		json_object_object_add(jmsg, "pid", jobj);
 
+	if (mdimm->suppressed) {
+		jobj = json_object_new_int64(mdimm->suppressed);
+		if (jobj)
+			json_object_object_add(jmsg, "suppressed", jobj);
+	}
+
 	jobj = dimm_event_to_json(mdimm);
 	if (jobj)
 		json_object_object_add(jmsg, "event", jobj);
@@ -180,10 +298,22 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 	if (jdimm)
 		json_object_object_add(jmsg, "dimm", jdimm);
 
-	jobj = util_dimm_health_to_json(mdimm->dimm);
+	/* the command of the sample that raised this event, not a new one */
+	jobj = util_smart_to_json(mdimm->smart_cmd,
+			mdimm->threshold.alarm_control ? &mdimm->threshold
+			: NULL);
 	if (jobj)
 		json_object_object_add(jdimm, "health", jobj);
 
+	if (monitor.stats) {
+		struct json_object *jstats;
+
+		jstats = util_cmd_stats_to_json(
+				ndctl_dimm_get_first_cmd_stats(mdimm->dimm));
+		if (jstats)
+			json_object_object_add(jdimm, "command_stats", jstats);
+	}
+
 	if (monitor.human)
 		notice(&monitor, "%s\n", json_object_to_json_string_ext(jmsg,
 						JSON_C_TO_STRING_PRETTY));
@@ -194,22 +324,193 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 	free(jobj);
 	free(jdimm);
 	free(jmsg);
+
+	mdimm->notified_smart = mdimm->smart;
+	mdimm->notify_ts = monitor_now_ms();
+	mdimm->notified = true;
+	mdimm->notifications++;
+	mdimm->suppressed = 0;
+
+	/* don't let alarms or a degraded health state sit in the buffer */
+	if (mdimm->smart.alarm_flags || (mdimm->smart.health
+				& (ND_SMART_CRITICAL_HEALTH | ND_SMART_FATAL_HEALTH)))
+		monitor_flush_log(mdimm->notify_ts, true);
+	return 0;
+}
+
+static bool monitor_dimm_unchanged(struct monitor_dimm *mdimm)
+{
+	return monitor.changes_only && memcmp(&mdimm->notified_smart,
+			&mdimm->smart, sizeof(mdimm->smart)) == 0;
+}
+
+static unsigned long long monitor_dimm_window_end(struct monitor_dimm *mdimm)
+{
+	return mdimm->notify_ts + monitor.rate_limit * 1000ULL;
+}
+
+/*
+ * --changes-only drops notifications that would repeat the SMART state
+ * of the last one, and --rate-limit spaces out a DIMM's notifications.
+ * An event held back by the latter is counted and remembered, so that
+ * monitor_dimm_notify_pending() can report it when the window ends.
+ */
+static bool monitor_dimm_suppressed(struct monitor_dimm *mdimm)
+{
+	if (!mdimm->notified)
+		return false;
+	if (monitor_dimm_unchanged(mdimm))
+		return true;
+	if (monitor.rate_limit && monitor_now_ms()
+			< monitor_dimm_window_end(mdimm)) {
+		mdimm->pending_flags = mdimm->event_flags;
+		mdimm->suppressed++;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Issue a single SMART command and decode everything the monitor needs
+ * from it, rather than paying for a separate command in each of
+ * ndctl_dimm_get_event_flags() and ndctl_dimm_get_health(). The command
+ * is kept across polls, so steady state polling does not allocate.
+ */
+static int monitor_dimm_sample(struct monitor_dimm *mdimm,
+		struct monitor_smart *smart)
+{
+	struct ndctl_cmd *cmd;
+	int rc;
+
+	cmd = mdimm->smart_cmd;
+	if (cmd && ndctl_cmd_reset(cmd) < 0) {
+		ndctl_cmd_unref(cmd);
+		cmd = NULL;
+	}
+	if (!cmd) {
+		cmd = ndctl_dimm_cmd_new_smart(mdimm->dimm);
+		mdimm->smart_cmd = cmd;
+		if (!cmd)
+			return -ENOTTY;
+	}
+
+	rc = ndctl_cmd_submit(cmd);
+	if (rc)
+		return rc < 0 ? rc : -ENXIO;
+
+	memset(smart, 0, sizeof(*smart));
+	smart->flags = ndctl_cmd_smart_get_flags(cmd);
+	smart->health = ndctl_cmd_smart_get_health(cmd);
+	smart->alarm_flags = ndctl_cmd_smart_get_alarm_flags(cmd);
+	smart->shutdown_state = ndctl_cmd_smart_get_shutdown_state(cmd);
+	if (smart->flags & ND_SMART_TEMP_VALID)
+		smart->temperature = ndctl_cmd_smart_get_temperature(cmd);
+	if (smart->flags & ND_SMART_CTEMP_VALID)
+		smart->ctrl_temperature =
+			ndctl_cmd_smart_get_ctrl_temperature(cmd);
+	if (smart->flags & ND_SMART_SPARES_VALID)
+		smart->spares = ndctl_cmd_smart_get_spares(cmd);
+	if (smart->flags & ND_SMART_USED_VALID)
+		smart->life_used = ndctl_cmd_smart_get_life_used(cmd);
+	if (smart->flags & ND_SMART_SHUTDOWN_COUNT_VALID)
+		smart->shutdown_count = ndctl_cmd_smart_get_shutdown_count(cmd);
+
 	return 0;
 }
 
+/* same translation as ndctl_dimm_get_event_flags() */
+static unsigned int smart_to_event_flags(struct monitor_smart *smart)
+{
+	unsigned int event_flags = 0;
+
+	if (smart->alarm_flags & ND_SMART_SPARE_TRIP)
+		event_flags |= ND_EVENT_SPARES_REMAINING;
+	if (smart->alarm_flags & ND_SMART_MTEMP_TRIP)
+		event_flags |= ND_EVENT_MEDIA_TEMPERATURE;
+	if (smart->alarm_flags & ND_SMART_CTEMP_TRIP)
+		event_flags |= ND_EVENT_CTRL_TEMPERATURE;
+	if (smart->shutdown_state)
+		event_flags |= ND_EVENT_UNCLEAN_SHUTDOWN;
+	return event_flags;
+}
+
+static bool temp_near_threshold(unsigned int temp, unsigned int threshold)
+{
+	return ndctl_decode_smart_temperature(temp) + POLL_TEMP_MARGIN
+		>= ndctl_decode_smart_temperature(threshold);
+}
+
+static bool temp_rising(unsigned int prev, unsigned int cur)
+{
+	return ndctl_decode_smart_temperature(cur)
+		- ndctl_decode_smart_temperature(prev) >= POLL_TEMP_RISE;
+}
+
+/*
+ * A DIMM is trending when a temperature rises by POLL_TEMP_RISE or more,
+ * or spares drop, since the last sample, when either sits within a
+ * margin of its alarm threshold, or when an alarm is already tripped.
+ * Smaller temperature changes are sensor noise.
+ */
+static bool monitor_dimm_trending(struct monitor_dimm *mdimm,
+		struct monitor_smart *prev, struct monitor_smart *cur)
+{
+	struct util_smart_threshold *t = &mdimm->threshold;
+	unsigned int flags = cur->flags & prev->flags;
+
+	if (cur->alarm_flags || cur->health != prev->health)
+		return true;
+
+	if (flags & ND_SMART_TEMP_VALID) {
+		if (temp_rising(prev->temperature, cur->temperature))
+			return true;
+		if ((t->alarm_control & ND_SMART_TEMP_TRIP)
+				&& temp_near_threshold(cur->temperature,
+					t->temperature))
+			return true;
+	}
+
+	if (flags & ND_SMART_CTEMP_VALID) {
+		if (temp_rising(prev->ctrl_temperature,
+					cur->ctrl_temperature))
+			return true;
+		if ((t->alarm_control & ND_SMART_CTEMP_TRIP)
+				&& temp_near_threshold(cur->ctrl_temperature,
+					t->ctrl_temperature))
+			return true;
+	}
+
+	if (flags & ND_SMART_SPARES_VALID) {
+		if (cur->spares < prev->spares)
+			return true;
+		if ((t->alarm_control & ND_SMART_SPARE_TRIP)
+				&& cur->spares <= t->spares + POLL_SPARES_MARGIN)
+			return true;
+	}
+
+	return false;
+}
+
 static struct monitor_dimm *util_dimm_event_filter(struct monitor_dimm *mdimm,
 		unsigned int event_flags)
 {
-	unsigned int health;
+	struct monitor_smart smart;
 
-	mdimm->event_flags = ndctl_dimm_get_event_flags(mdimm->dimm);
-	if (mdimm->event_flags == UINT_MAX)
+	if (monitor_dimm_sample(mdimm, &smart))
 		return NULL;
 
-	health = ndctl_dimm_get_health(mdimm->dimm);
-	if (health == UINT_MAX)
-		return NULL;
-	if (mdimm->health != health)
+	/* the first good sample is the baseline for the ones that follow */
+	if (!mdimm->sampled) {
+		mdimm->smart = smart;
+		mdimm->health = smart.health;
+		mdimm->sampled = true;
+	}
+
+	mdimm->trending = monitor_dimm_trending(mdimm, &mdimm->smart, &smart);
+	mdimm->smart = smart;
+
+	mdimm->event_flags = smart_to_event_flags(&smart);
+	if (mdimm->health != smart.health)
 		mdimm->event_flags |= ND_EVENT_HEALTH_STATE;
 
 	if (mdimm->event_flags & event_flags)
@@ -217,11 +518,12 @@ static struct monitor_dimm *util_dimm_event_filter(struct monitor_dimm *mdimm,
 	return NULL;
 }
 
-static int enable_dimm_supported_threshold_alarms(struct ndctl_dimm *dimm)
+static int enable_dimm_supported_threshold_alarms(struct monitor_dimm *mdimm)
 {
 	unsigned int alarm;
 	int rc = -EOPNOTSUPP;
 	struct ndctl_cmd *st_cmd = NULL, *sst_cmd = NULL;
+	struct ndctl_dimm *dimm = mdimm->dimm;
 	const char *name = ndctl_dimm_get_devname(dimm);
 
 	st_cmd = ndctl_dimm_cmd_new_smart_threshold(dimm);
@@ -255,6 +557,13 @@ static int enable_dimm_supported_threshold_alarms(struct ndctl_dimm *dimm)
 		goto out;
 	}
 
+	mdimm->threshold.alarm_control = alarm;
+	mdimm->threshold.temperature =
+		ndctl_cmd_smart_threshold_get_temperature(st_cmd);
+	mdimm->threshold.ctrl_temperature =
+		ndctl_cmd_smart_threshold_get_ctrl_temperature(st_cmd);
+	mdimm->threshold.spares = ndctl_cmd_smart_threshold_get_spares(st_cmd);
+
 out:
 	ndctl_cmd_unref(sst_cmd);
 	ndctl_cmd_unref(st_cmd);
@@ -278,33 +587,40 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *fctx)
 		return;
 	}
 
+	mdimm = calloc(1, sizeof(struct monitor_dimm));
+	if (!mdimm) {
+		err(&monitor, "%s: calloc for monitor dimm failed\n", name);
+		return;
+	}
+	mdimm->dimm = dimm;
+
 	if (!ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SMART_THRESHOLD)) {
 		dbg(&monitor, "%s: no smart threshold support\n", name);
 	} else if (!ndctl_dimm_is_flag_supported(dimm, ND_SMART_ALARM_VALID)) {
 		err(&monitor, "%s: smart alarm invalid\n", name);
-		return;
-	} else if (enable_dimm_supported_threshold_alarms(dimm)) {
+		goto out;
+	} else if (enable_dimm_supported_threshold_alarms(mdimm)) {
 		err(&monitor, "%s: enable supported threshold alarms failed\n", name);
-		return;
-	}
-
-	mdimm = calloc(1, sizeof(struct monitor_dimm));
-	if (!mdimm) {
-		err(&monitor, "%s: calloc for monitor dimm failed\n", name);
-		return;
+		goto out;
 	}
 
-	mdimm->dimm = dimm;
+	/*
+	 * A failed first sample is likely transient, keep the DIMM and
+	 * take the baseline from its next scheduled poll.
+	 */
 	mdimm->health_eventfd = ndctl_dimm_get_health_eventfd(dimm);
-	mdimm->health = ndctl_dimm_get_health(dimm);
-	mdimm->event_flags = ndctl_dimm_get_event_flags(dimm);
+	if (monitor_dimm_sample(mdimm, &mdimm->smart)) {
+		err(&monitor, "%s: smart command failed\n", name);
+	} else {
+		mdimm->sampled = true;
+		mdimm->health = mdimm->smart.health;
+		mdimm->event_flags = smart_to_event_flags(&mdimm->smart);
+	}
 
-	if (mdimm->event_flags
-			&& util_dimm_event_filter(mdimm, monitor.event_flags)) {
+	if (mdimm->event_flags & monitor.event_flags) {
 		if (notify_dimm_event(mdimm)) {
 			err(&monitor, "%s: notify dimm event failed\n", name);
-			free(mdimm);
-			return;
+			goto out;
 		}
 	}
 
@@ -313,6 +629,9 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *fctx)
 		mfa->maxfd_dimm = mdimm->health_eventfd;
 	mfa->num_dimm++;
 	return;
+out:
+	ndctl_cmd_unref(mdimm->smart_cmd);
+	free(mdimm);
 }
 
 static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *fctx)
@@ -320,20 +639,385 @@ static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *fctx)
 	return true;
 }
 
+#define metric_header(f, name, type, help) \
+	fprintf(f, "# HELP ndctl_" name " " help "\n# TYPE ndctl_" name " " type "\n")
+
+#define metric_label_fmt "{bus=\"%s\",dimm=\"%s\""
+#define metric_label_args(mdimm) \
+	ndctl_bus_get_devname(ndctl_dimm_get_bus((mdimm)->dimm)), \
+	ndctl_dimm_get_devname((mdimm)->dimm)
+
+static unsigned int smart_health_level(unsigned int health)
+{
+	if (health & ND_SMART_FATAL_HEALTH)
+		return 3;
+	if (health & ND_SMART_CRITICAL_HEALTH)
+		return 2;
+	if (health & ND_SMART_NON_CRITICAL_HEALTH)
+		return 1;
+	return 0;
+}
+
+#define metric_cmd_fmt metric_label_fmt ",cmd=\"%s\""
+
+/* libndctl bucket N counts the latencies below 2^N microseconds */
+static void metrics_cmd_histogram(FILE *f, struct monitor_dimm *mdimm,
+		struct ndctl_cmd_stats *stats)
+{
+	unsigned int i, n = ndctl_cmd_stats_get_num_buckets(stats);
+	unsigned long long count = ndctl_cmd_stats_get_count(stats);
+	const char *cmd = ndctl_cmd_stats_get_name(stats);
+	unsigned long long cumulative = 0;
+
+	/* the last bucket is unbounded, it is reported as +Inf */
+	for (i = 0; i + 1 < n; i++) {
+		cumulative += ndctl_cmd_stats_get_bucket(stats, i);
+		fprintf(f, "ndctl_dimm_command_duration_seconds_bucket"
+			metric_cmd_fmt ",le=\"%g\"} %llu\n",
+			metric_label_args(mdimm), cmd, (1ULL << i) / 1e6,
+			cumulative);
+	}
+	fprintf(f, "ndctl_dimm_command_duration_seconds_bucket"
+		metric_cmd_fmt ",le=\"+Inf\"} %llu\n",
+		metric_label_args(mdimm), cmd, count);
+	fprintf(f, "ndctl_dimm_command_duration_seconds_sum"
+		metric_cmd_fmt "} %.9f\n", metric_label_args(mdimm), cmd,
+		ndctl_cmd_stats_get_total_ns(stats) / 1e9);
+	fprintf(f, "ndctl_dimm_command_duration_seconds_count"
+		metric_cmd_fmt "} %llu\n", metric_label_args(mdimm), cmd,
+		count);
+}
+
+/*
+ * Emit the last sampled SMART state and the libndctl command statistics
+ * of each DIMM in the Prometheus text exposition format.
+ */
+static void metrics_to_file(FILE *f, struct monitor_filter_arg *mfa)
+{
+	struct monitor_dimm *mdimm;
+	struct ndctl_cmd_stats *stats;
+
+	metric_header(f, "dimm_health_state", "gauge",
+		"0: ok, 1: non-critical, 2: critical, 3: fatal");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_HEALTH_VALID)
+			fprintf(f, "ndctl_dimm_health_state" metric_label_fmt
+				"} %u\n", metric_label_args(mdimm),
+				smart_health_level(mdimm->smart.health));
+
+	metric_header(f, "dimm_temperature_celsius", "gauge",
+		"Media temperature");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_TEMP_VALID)
+			fprintf(f, "ndctl_dimm_temperature_celsius"
+				metric_label_fmt "} %g\n",
+				metric_label_args(mdimm),
+				ndctl_decode_smart_temperature(
+					mdimm->smart.temperature));
+
+	metric_header(f, "dimm_controller_temperature_celsius", "gauge",
+		"Controller temperature");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_CTEMP_VALID)
+			fprintf(f, "ndctl_dimm_controller_temperature_celsius"
+				metric_label_fmt "} %g\n",
+				metric_label_args(mdimm),
+				ndctl_decode_smart_temperature(
+					mdimm->smart.ctrl_temperature));
+
+	metric_header(f, "dimm_spares_percentage", "gauge",
+		"Spare blocks remaining");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_SPARES_VALID)
+			fprintf(f, "ndctl_dimm_spares_percentage"
+				metric_label_fmt "} %u\n",
+				metric_label_args(mdimm), mdimm->smart.spares);
+
+	metric_header(f, "dimm_life_used_percentage", "gauge",
+		"Estimated media life used");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_USED_VALID)
+			fprintf(f, "ndctl_dimm_life_used_percentage"
+				metric_label_fmt "} %u\n",
+				metric_label_args(mdimm),
+				mdimm->smart.life_used);
+
+	metric_header(f, "dimm_unclean_shutdown", "gauge",
+		"1 if the last shutdown was unclean");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_SHUTDOWN_VALID)
+			fprintf(f, "ndctl_dimm_unclean_shutdown"
+				metric_label_fmt "} %u\n",
+				metric_label_args(mdimm),
+				!!mdimm->smart.shutdown_state);
+
+	metric_header(f, "dimm_shutdown_count", "counter",
+		"Unclean shutdown count");
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->smart.flags & ND_SMART_SHUTDOWN_COUNT_VALID)
+			fprintf(f, "ndctl_dimm_shutdown_count"
+				metric_label_fmt "} %u\n",
+				metric_label_args(mdimm),
+				mdimm->smart.shutdown_count);
+
+	metric_header(f, "dimm_alarm", "gauge",
+		"1 if the alarm threshold has been tripped");
+	list_for_each(&mfa->dimms, mdimm, list) {
+		unsigned int alarm = mdimm->smart.alarm_flags;
+
+		if (!(mdimm->smart.flags & ND_SMART_ALARM_VALID))
+			continue;
+		fprintf(f, "ndctl_dimm_alarm" metric_label_fmt
+			",alarm=\"media_temperature\"} %u\n",
+			metric_label_args(mdimm),
+			!!(alarm & ND_SMART_MTEMP_TRIP));
+		fprintf(f, "ndctl_dimm_alarm" metric_label_fmt
+			",alarm=\"controller_temperature\"} %u\n",
+			metric_label_args(mdimm),
+			!!(alarm & ND_SMART_CTEMP_TRIP));
+		fprintf(f, "ndctl_dimm_alarm" metric_label_fmt
+			",alarm=\"spares\"} %u\n",
+			metric_label_args(mdimm),
+			!!(alarm & ND_SMART_SPARE_TRIP));
+	}
+
+	metric_header(f, "dimm_command_duration_seconds", "histogram",
+		"Latency of the commands submitted to the DIMM");
+	list_for_each(&mfa->dimms, mdimm, list)
+		ndctl_dimm_cmd_stats_foreach(mdimm->dimm, stats)
+			metrics_cmd_histogram(f, mdimm, stats);
+
+	metric_header(f, "dimm_command_errors_total", "counter",
+		"Failed commands, including firmware errors");
+	list_for_each(&mfa->dimms, mdimm, list)
+		ndctl_dimm_cmd_stats_foreach(mdimm->dimm, stats)
+			fprintf(f, "ndctl_dimm_command_errors_total"
+				metric_cmd_fmt "} %llu\n",
+				metric_label_args(mdimm),
+				ndctl_cmd_stats_get_name(stats),
+				ndctl_cmd_stats_get_errors(stats)
+				+ ndctl_cmd_stats_get_fw_errors(stats));
+
+	metric_header(f, "monitor_notifications_total", "counter",
+		"Notifications emitted");
+	list_for_each(&mfa->dimms, mdimm, list)
+		fprintf(f, "ndctl_monitor_notifications_total" metric_label_fmt
+			"} %llu\n", metric_label_args(mdimm),
+			mdimm->notifications);
+}
+
+/* replace the --metrics file atomically so readers never see a partial one */
+static int metrics_write_file(struct monitor_filter_arg *mfa)
+{
+	struct strbuf tmp = STRBUF_INIT;
+	int rc = 0;
+	FILE *f;
+
+	strbuf_addf(&tmp, "%s.tmp", monitor.metrics);
+	f = fopen(tmp.buf, "w");
+	if (!f) {
+		rc = -errno;
+		err(&monitor, "open %s failed: %s\n", tmp.buf, strerror(errno));
+		goto out;
+	}
+	metrics_to_file(f, mfa);
+	if (fclose(f) || rename(tmp.buf, monitor.metrics)) {
+		rc = -errno;
+		err(&monitor, "write %s failed: %s\n", monitor.metrics,
+				strerror(errno));
+		unlink(tmp.buf);
+	}
+out:
+	strbuf_release(&tmp);
+	return rc;
+}
+
+/* only ever remove a socket, never a file that happens to be in the way */
+static int metrics_socket_unlink(void)
+{
+	struct stat st;
+
+	if (lstat(monitor.metrics_socket, &st) < 0)
+		return errno == ENOENT ? 0 : -errno;
+	if (!S_ISSOCK(st.st_mode))
+		return -EEXIST;
+	if (unlink(monitor.metrics_socket) < 0)
+		return -errno;
+	return 0;
+}
+
+static int metrics_socket_init(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd, rc;
+
+	if (strlen(monitor.metrics_socket) >= sizeof(addr.sun_path)) {
+		err(&monitor, "%s: socket path too long\n",
+				monitor.metrics_socket);
+		return -EINVAL;
+	}
+	strcpy(addr.sun_path, monitor.metrics_socket);
+
+	/* a stale socket left by a previous monitor would fail bind() */
+	rc = metrics_socket_unlink();
+	if (rc) {
+		err(&monitor, "%s: %s\n", monitor.metrics_socket,
+				rc == -EEXIST ? "exists and is not a socket"
+				: strerror(-rc));
+		return rc;
+	}
+
+	/* a scraper that hangs up early must not kill the monitor */
+	signal(SIGPIPE, SIG_IGN);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		err(&monitor, "metrics socket failed: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+			|| listen(fd, 8) < 0) {
+		err(&monitor, "%s: bind failed: %s\n", monitor.metrics_socket,
+				strerror(errno));
+		close(fd);
+		return -errno;
+	}
+	monitor.metrics_fd = fd;
+	return 0;
+}
+
+/* each connection receives one snapshot and is then closed */
+static void metrics_socket_serve(struct monitor_filter_arg *mfa)
+{
+	struct timeval timeout = { .tv_sec = 1 };
+	FILE *f;
+	int fd;
+
+	while ((fd = accept4(monitor.metrics_fd, NULL, NULL,
+					SOCK_CLOEXEC)) >= 0) {
+		/* don't let a stalled reader hold up the monitor */
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+				sizeof(timeout));
+		f = fdopen(fd, "w");
+		if (!f) {
+			close(fd);
+			continue;
+		}
+		metrics_to_file(f, mfa);
+		fclose(f);
+	}
+}
+
+static void monitor_dimm_reschedule(struct monitor_dimm *mdimm,
+		unsigned long long now)
+{
+	unsigned long base = monitor.poll_timeout * 1000UL;
+	unsigned long min_interval = max(base / POLL_INTERVAL_MIN_DIV,
+			(unsigned long) POLL_INTERVAL_FLOOR_MS);
+	unsigned long max_interval = base * POLL_INTERVAL_MAX_MUL;
+
+	if (mdimm->trending)
+		mdimm->interval = max(mdimm->interval / 2, min_interval);
+	else
+		mdimm->interval = min(mdimm->interval + base / 4, max_interval);
+	mdimm->deadline = now + mdimm->interval;
+
+	dbg(&monitor, "%s: %s, next poll in %lu ms\n",
+			ndctl_dimm_get_devname(mdimm->dimm),
+			mdimm->trending ? "trending" : "quiet",
+			mdimm->interval);
+}
+
+static int monitor_dimm_poll(struct monitor_dimm *mdimm)
+{
+	char buf;
+	int rc;
+
+	if (util_dimm_event_filter(mdimm, monitor.event_flags)
+			&& !monitor_dimm_suppressed(mdimm)) {
+		rc = notify_dimm_event(mdimm);
+		if (rc) {
+			err(&monitor, "%s: notify dimm event failed\n",
+				ndctl_dimm_get_devname(mdimm->dimm));
+			did_fail = 1;
+			return rc;
+		}
+	}
+	rc = pread(mdimm->health_eventfd, &buf, sizeof(buf), 0);
+	if (rc < 0) {
+		err(&monitor, "pread error\n");
+		return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Once a DIMM's --rate-limit window has passed, report the latest event
+ * that was held back in it, along with the most recent SMART sample.
+ */
+static int monitor_dimm_notify_pending(struct monitor_dimm *mdimm,
+		unsigned long long now)
+{
+	int rc;
+
+	if (!mdimm->suppressed || now < monitor_dimm_window_end(mdimm))
+		return 0;
+	if (monitor_dimm_unchanged(mdimm)) {
+		mdimm->suppressed = 0;
+		return 0;
+	}
+
+	mdimm->event_flags = mdimm->pending_flags;
+	rc = notify_dimm_event(mdimm);
+	if (rc) {
+		err(&monitor, "%s: notify dimm event failed\n",
+			ndctl_dimm_get_devname(mdimm->dimm));
+		did_fail = 1;
+	}
+	return rc;
+}
+
+/*
+ * milliseconds until the earliest poll deadline, end of a --rate-limit
+ * window with an event pending, or log flush
+ */
+static int monitor_next_timeout(struct monitor_filter_arg *mfa,
+		unsigned long long now)
+{
+	unsigned long long deadline = ULLONG_MAX;
+	int timeout, flush_timeout = monitor_flush_timeout(now);
+	struct monitor_dimm *mdimm;
+
+	list_for_each(&mfa->dimms, mdimm, list) {
+		if (monitor.poll_timeout)
+			deadline = min(deadline, mdimm->deadline);
+		if (mdimm->suppressed)
+			deadline = min(deadline,
+					monitor_dimm_window_end(mdimm));
+	}
+	if (deadline == ULLONG_MAX)
+		return flush_timeout;
+	if (deadline <= now)
+		return 0;
+	timeout = min(deadline - now, (unsigned long long) INT_MAX);
+	if (flush_timeout >= 0)
+		timeout = min(timeout, flush_timeout);
+	return timeout;
+}
+
 static int monitor_event(struct ndctl_ctx *ctx,
 		struct monitor_filter_arg *mfa)
 {
 	struct epoll_event ev, *events;
-	int nfds, epollfd, i, rc = 0, polltimeout = -1;
+	int nfds, epollfd, i, rc = 0;
+	unsigned long long now;
 	struct monitor_dimm *mdimm;
+	bool polled;
 	char buf;
-	/* last time a full poll happened */
-	struct timespec fullpoll_ts, ts;
-
-	if (monitor.poll_timeout)
-		polltimeout = monitor.poll_timeout * 1000;
 
-	events = calloc(mfa->num_dimm, sizeof(struct epoll_event));
+	/* one slot per dimm plus the metrics socket */
+	events = calloc(mfa->num_dimm + 1, sizeof(struct epoll_event));
 	if (!events) {
 		err(&monitor, "malloc for events error\n");
 		return -ENOMEM;
@@ -344,6 +1028,13 @@ static int monitor_event(struct ndctl_ctx *ctx,
 		rc = -errno;
 		goto out;
 	}
+
+	/*
+	 * Stagger the initial deadlines across the first interval so that
+	 * the SMART commands for all DIMMs are not issued in one burst.
+	 */
+	now = monitor_now_ms();
+	i = 0;
 	list_for_each(&mfa->dimms, mdimm, list) {
 		memset(&ev, 0, sizeof(ev));
 		rc = pread(mdimm->health_eventfd, &buf, sizeof(buf), 0);
@@ -359,50 +1050,75 @@ static int monitor_event(struct ndctl_ctx *ctx,
 			rc = -errno;
 			goto out;
 		}
+		mdimm->interval = monitor.poll_timeout * 1000UL;
+		mdimm->deadline = now + mdimm->interval * ++i / mfa->num_dimm;
 	}
 
-	clock_gettime(CLOCK_BOOTTIME, &fullpoll_ts);
+	if (monitor.metrics_fd >= 0) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = &monitor.metrics_fd;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD,
+				monitor.metrics_fd, &ev) != 0) {
+			err(&monitor, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+	if (monitor.metrics)
+		metrics_write_file(mfa);
+
 	while (1) {
 		did_fail = 0;
-		nfds = epoll_wait(epollfd, events, mfa->num_dimm, polltimeout);
+		nfds = epoll_pwait(epollfd, events, mfa->num_dimm + 1,
+				monitor_next_timeout(mfa, monitor_now_ms()),
+				monitor.wait_sigmask);
 		if (nfds < 0 && errno != EINTR) {
 			err(&monitor, "epoll_wait error: (%s)\n", strerror(errno));
 			rc = -errno;
 			goto out;
 		}
-
-		/* If needed force a full poll of dimm health */
-		clock_gettime(CLOCK_BOOTTIME, &ts);
-		if ((fullpoll_ts.tv_sec - ts.tv_sec) > monitor.poll_timeout) {
-			nfds = 0;
-			dbg(&monitor, "forcing a full poll\n");
-		}
-
-		/* If we timed out then fill events array with all dimms */
-		if (nfds == 0) {
-			list_for_each(&mfa->dimms, mdimm, list)
-				events[nfds++].data.ptr = mdimm;
-			fullpoll_ts = ts;
+		if (monitor_exiting) {
+			rc = 0;
+			goto out;
 		}
 
+		now = monitor_now_ms();
+		polled = false;
 		for (i = 0; i < nfds; i++) {
+			if (events[i].data.ptr == &monitor.metrics_fd) {
+				metrics_socket_serve(mfa);
+				continue;
+			}
 			mdimm = events[i].data.ptr;
-			if (util_dimm_event_filter(mdimm, monitor.event_flags)) {
-				rc = notify_dimm_event(mdimm);
-				if (rc) {
-					err(&monitor, "%s: notify dimm event failed\n",
-						ndctl_dimm_get_devname(mdimm->dimm));
-					did_fail = 1;
+			polled = true;
+			rc = monitor_dimm_poll(mdimm);
+			if (rc)
+				goto out;
+			if (monitor.poll_timeout)
+				monitor_dimm_reschedule(mdimm, now);
+		}
+
+		if (monitor.poll_timeout)
+			list_for_each(&mfa->dimms, mdimm, list) {
+				if (mdimm->deadline > now)
+					continue;
+				polled = true;
+				rc = monitor_dimm_poll(mdimm);
+				if (rc)
 					goto out;
-				}
+				monitor_dimm_reschedule(mdimm, now);
 			}
-			rc = pread(mdimm->health_eventfd, &buf, sizeof(buf), 0);
-			if (rc < 0) {
-				err(&monitor, "pread error\n");
-				rc = -errno;
-				goto out;
+		if (monitor.rate_limit)
+			list_for_each(&mfa->dimms, mdimm, list) {
+				rc = monitor_dimm_notify_pending(mdimm, now);
+				if (rc)
+					goto out;
 			}
-		}
+		if (monitor.flush_interval)
+			monitor_flush_log(now, false);
+		if (monitor.metrics && polled)
+			metrics_write_file(mfa);
 		if (did_fail)
 			return 1;
 	}
@@ -593,8 +1309,21 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 				"use human friendly output formats"),
 		OPT_BOOLEAN('v', "verbose", &monitor.verbose,
 				"emit extra debug messages to log"),
+		OPT_BOOLEAN('\0', "stats", &monitor.stats,
+				"include dimm command statistics in notifications"),
 		OPT_UINTEGER('p', "poll", &monitor.poll_timeout,
 			     "poll and report events/status every <n> seconds"),
+		OPT_FILENAME('\0', "metrics", &monitor.metrics, "file",
+				"maintain Prometheus text format metrics in <file>"),
+		OPT_FILENAME('\0', "metrics-socket", &monitor.metrics_socket,
+				"path", "serve Prometheus text format metrics "
+				"on a unix socket"),
+		OPT_BOOLEAN('\0', "changes-only", &monitor.changes_only,
+				"only report a DIMM when its SMART state changes"),
+		OPT_UINTEGER('\0', "rate-limit", &monitor.rate_limit,
+			     "report each DIMM at most once every <n> seconds"),
+		OPT_UINTEGER('\0', "flush-interval", &monitor.flush_interval,
+			     "buffer <file> log output for up to <n> seconds"),
 		OPT_END(),
 	};
 	const char * const u[] = {
@@ -604,6 +1333,7 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 	const char *prefix = "./";
 	struct util_filter_ctx fctx = { 0 };
 	struct monitor_filter_arg mfa = { 0 };
+	sigset_t wait_sigmask;
 	int i, rc;
 
 	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
@@ -613,6 +1343,7 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 	if (argc)
 		usage_with_options(u, options);
 
+	monitor.metrics_fd = -1;
 	log_init(&monitor.ctx, "ndctl/monitor", "NDCTL_MONITOR_LOG");
 	monitor.ctx.log_fn = log_standard;
 
@@ -643,6 +1374,25 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 		}
 	}
 
+	if (monitor.flush_interval) {
+		struct sigaction act = { .sa_handler = monitor_sig_exit };
+		sigset_t exit_sigs;
+
+		/*
+		 * Exit through fclose() so buffered notifications are kept.
+		 * The exit signals are only unblocked inside epoll_pwait(),
+		 * so one can't slip in between the check and the wait.
+		 */
+		sigemptyset(&exit_sigs);
+		sigaddset(&exit_sigs, SIGTERM);
+		sigaddset(&exit_sigs, SIGINT);
+		sigprocmask(SIG_BLOCK, &exit_sigs, &wait_sigmask);
+		sigaction(SIGTERM, &act, NULL);
+		sigaction(SIGINT, &act, NULL);
+		monitor.wait_sigmask = &wait_sigmask;
+		monitor.flush_ts = monitor_now_ms();
+	}
+
 	if (monitor.daemon) {
 		if (!monitor.log || strncmp(monitor.log, "./", 2) == 0)
 			monitor.ctx.log_fn = log_syslog;
@@ -677,8 +1427,18 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 		goto out;
 	}
 
+	if (monitor.metrics_socket) {
+		rc = metrics_socket_init();
+		if (rc)
+			goto out;
+	}
+
 	rc = monitor_event(ctx, &mfa);
 out:
+	if (monitor.metrics_fd >= 0) {
+		close(monitor.metrics_fd);
+		metrics_socket_unlink();
+	}
 	if (monitor.log_file)
 		fclose(monitor.log_file);
 	return rc;
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <util/size.h>
+#include <util/util.h>
+#include <util/clock.h>
+#include <ndctl/libndctl.h>
+#include <daxctl/libdaxctl.h>
+
+#include "namespace-io.h"
+
+struct ns_io_worker {
+	struct ns_io *io;
+	ns_io_fn fn;
+	unsigned int idx;
+	unsigned int nr;
+	pthread_t thread;
+	bool started;
+};
+
+/*
+ * ns_io_open_raw - put a namespace in raw mode and open its block device
+ * @flags: access mode, the device is always opened O_DIRECT|O_EXCL
+ * @force: disable an active namespace rather than failing with -EBUSY
+ * @why: completes the "specify --force ..." hint for an active namespace
+ *
+ * On success the namespace stays in raw mode until ns_io_close(), which
+ * re-enables it in its original mode if it had to be disabled.
+ */
+int ns_io_open_raw(struct ns_io *io, struct ndctl_namespace *ndns,
+		int flags, bool force, const char *why)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	bool disabled = false;
+	int rc;
+
+	*io = (struct ns_io) {
+		.devname = devname,
+		.fd = -1,
+	};
+
+	if (ndctl_namespace_is_active(ndns)) {
+		if (!force) {
+			error("%s is active, specify --force %s\n", devname,
+					why);
+			return -EBUSY;
+		}
+		rc = ndctl_namespace_disable_safe(ndns);
+		if (rc)
+			return rc;
+		disabled = true;
+	}
+
+	io->ndns = ndns;
+	io->disabled = disabled;
+	io->raw_mode = ndctl_namespace_get_raw_mode(ndns);
+	rc = ndctl_namespace_set_raw_mode(ndns, 1);
+	if (rc < 0) {
+		error("%s: failed to set the raw mode flag: %s\n", devname,
+				strerror(-rc));
+		goto err;
+	}
+
+	rc = ndctl_namespace_enable(ndns);
+	if (rc < 0) {
+		error("%s: failed to enable in raw mode: %s\n", devname,
+				strerror(-rc));
+		goto err;
+	}
+
+	sprintf(io->path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
+	io->fd = open(io->path, flags|O_DIRECT|O_EXCL|O_CLOEXEC);
+	if (io->fd < 0) {
+		rc = -errno;
+		error("%s: failed to open %s: %s\n", devname, io->path,
+				strerror(errno));
+		goto err;
+	}
+	io->size = ndctl_namespace_get_size(ndns);
+	return 0;
+ err:
+	ns_io_close(io);
+	return rc;
+}
+
+/*
+ * ns_io_open_dax - map the device-dax instance of an enabled devdax
+ * namespace, which stays in service
+ */
+int ns_io_open_dax(struct ns_io *io, struct ndctl_namespace *ndns,
+		bool write)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
+	struct daxctl_region *dax_region;
+	struct daxctl_dev *dev;
+	int rc;
+
+	*io = (struct ns_io) {
+		.devname = devname,
+		.fd = -1,
+	};
+
+	dax_region = dax ? ndctl_dax_get_daxctl_region(dax) : NULL;
+	dev = dax_region ? daxctl_dev_get_first(dax_region) : NULL;
+	if (!dev || !daxctl_dev_is_enabled(dev)) {
+		error("%s: --dax requires an enabled devdax namespace\n",
+				devname);
+		return -ENXIO;
+	}
+
+	sprintf(io->path, "/dev/%s", daxctl_dev_get_devname(dev));
+	io->size = daxctl_dev_get_size(dev);
+	io->fd = open(io->path, (write ? O_RDWR : O_RDONLY)|O_CLOEXEC);
+	if (io->fd < 0) {
+		rc = -errno;
+		error("%s: failed to open %s: %s\n", devname, io->path,
+				strerror(errno));
+		return rc;
+	}
+
+	io->addr = mmap(NULL, io->size, write ? PROT_WRITE : PROT_READ,
+			MAP_SHARED, io->fd, 0);
+	if (io->addr == MAP_FAILED) {
+		rc = -errno;
+		error("%s: failed to map %s: %s\n", devname, io->path,
+				strerror(errno));
+		io->addr = NULL;
+		ns_io_close(io);
+		return rc;
+	}
+	return 0;
+}
+
+void ns_io_close(struct ns_io *io)
+{
+	struct ndctl_namespace *ndns = io->ndns;
+
+	if (io->addr)
+		munmap(io->addr, io->size);
+	io->addr = NULL;
+	if (io->fd >= 0)
+		close(io->fd);
+	io->fd = -1;
+
+	if (!ndns)
+		return;
+	ndctl_namespace_set_raw_mode(ndns, io->raw_mode);
+	ndctl_namespace_disable_invalidate(ndns);
+	if (io->disabled && ndctl_namespace_enable(ndns) < 0)
+		error("%s: failed to re-enable namespace\n", io->devname);
+	io->ndns = NULL;
+}
+
+void ns_io_set_err(struct ns_io *io, int rc)
+{
+	int expected = 0;
+
+	__atomic_compare_exchange_n(&io->err, &expected, rc, false,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void ns_io_progress(struct ns_io *io, const char *verb,
+		unsigned long long elapsed, bool final)
+{
+	unsigned long long done = __atomic_load_n(&io->done,
+			__ATOMIC_RELAXED);
+	double secs = elapsed / 1e9;
+
+	fprintf(stderr, "%s%s: %s %llu of %llu MiB (%llu%%) %.1f MiB/s%s",
+			final ? "" : "\r", io->devname, verb, done / SZ_1M,
+			io->size / SZ_1M,
+			io->size ? done * 100 / io->size : 100,
+			secs > 0 ? done / secs / SZ_1M : 0.0,
+			final ? "\n" : "");
+}
+
+static void *ns_io_worker(void *arg)
+{
+	struct ns_io_worker *worker = arg;
+
+	worker->fn(worker->io, worker->idx, worker->nr);
+	return NULL;
+}
+
+/*
+ * ns_io_run - run @fn in @threads worker threads and wait for them
+ * @verb: what the workers do, for the progress line on stderr
+ * @elapsed: wall clock time from starting the first worker to joining
+ *	     the last one
+ */
+int ns_io_run(struct ns_io *io, ns_io_fn fn, unsigned int threads,
+		const char *verb, bool progress, unsigned long long *elapsed)
+{
+	unsigned long long start = now_ns(), last = start;
+	struct ns_io_worker *workers;
+	struct timespec tick = {
+		.tv_nsec = 100000000,
+	};
+	unsigned int i;
+	int rc;
+
+	if (!threads)
+		threads = 1;
+	workers = calloc(threads, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+
+	for (i = 0; i < threads; i++) {
+		workers[i].io = io;
+		workers[i].fn = fn;
+		workers[i].idx = i;
+		workers[i].nr = threads;
+		rc = pthread_create(&workers[i].thread, NULL, ns_io_worker,
+				&workers[i]);
+		if (rc) {
+			ns_io_set_err(io, -rc);
+			break;
+		}
+		workers[i].started = true;
+	}
+
+	while (progress && !__atomic_load_n(&io->err, __ATOMIC_RELAXED)
+			&& __atomic_load_n(&io->done, __ATOMIC_RELAXED)
+				< io->size) {
+		nanosleep(&tick, NULL);
+		if (now_ns() - last >= 1000000000ULL) {
+			last = now_ns();
+			ns_io_progress(io, verb, last - start, false);
+		}
+	}
+
+	for (i = 0; i < threads; i++)
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+	free(workers);
+	*elapsed = now_ns() - start;
+
+	if (progress && last != start)
+		fprintf(stderr, "\n");
+	return io->err;
+}
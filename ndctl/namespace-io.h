@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __NDCTL_NAMESPACE_IO_H__
+#define __NDCTL_NAMESPACE_IO_H__
+#include <limits.h>
+#include <stdbool.h>
+#include <ndctl/libndctl.h>
+
+/*
+ * struct ns_io - a namespace being read or written by a pool of workers
+ * @path: the device node that was opened
+ * @addr: device-dax mapping, NULL when going through @fd
+ * @done: bytes processed so far, updated atomically by the workers
+ * @err: first error seen by any worker
+ * @ndns: set while the namespace is held in raw mode, restored by
+ *	  ns_io_close()
+ */
+struct ns_io {
+	const char *devname;
+	char path[PATH_MAX];
+	char *addr;
+	int fd;
+	unsigned long long size;
+	unsigned long long done;
+	int err;
+	struct ndctl_namespace *ndns;
+	int raw_mode;
+	bool disabled;
+};
+
+/* called once in each of the @nr worker threads, @idx counts from 0 */
+typedef void (*ns_io_fn)(struct ns_io *io, unsigned int idx,
+		unsigned int nr);
+
+int ns_io_open_raw(struct ns_io *io, struct ndctl_namespace *ndns,
+		int flags, bool force, const char *why);
+int ns_io_open_dax(struct ns_io *io, struct ndctl_namespace *ndns,
+		bool write);
+void ns_io_close(struct ns_io *io);
+void ns_io_set_err(struct ns_io *io, int rc);
+void ns_io_progress(struct ns_io *io, const char *verb,
+		unsigned long long elapsed, bool final);
+int ns_io_run(struct ns_io *io, ns_io_fn fn, unsigned int threads,
+		const char *verb, bool progress, unsigned long long *elapsed);
+#endif /* __NDCTL_NAMESPACE_IO_H__ */
@@ -18,6 +18,8 @@
 #include <unistd.h>
 #include <limits.h>
 #include <syslog.h>
+#include <sched.h>
+#include <dirent.h>
 
 #include <ndctl.h>
 #include "action.h"
@@ -28,6 +30,7 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <util/size.h>
+#include <util/jobs.h>
 #include <util/json.h>
 #include <json-c/json.h>
 #include <util/filter.h>
@@ -40,6 +43,9 @@ static bool force;
 static bool repair;
 static bool logfix;
 static bool scrub;
+static FILE *batch_out;
+static int place_node = NUMA_NO_NODE;
+static bool place_local;
 static struct parameters {
 	bool do_scan;
 	bool mode_default;
@@ -50,6 +56,12 @@ static struct parameters {
 	bool human;
 	bool json;
 	bool std_out;
+	unsigned int count;
+	unsigned int jobs;
+	unsigned int threads;
+	bool dax;
+	const char *placement;
+	const char *numa_node;
 	const char *bus;
 	const char *map;
 	const char *type;
@@ -145,12 +157,22 @@ OPT_BOOLEAN('f', "force", &force, "reconfigure namespace even if currently activ
 OPT_BOOLEAN('L', "autolabel", &param.autolabel, "automatically initialize labels"), \
 OPT_BOOLEAN('c', "continue", &param.greedy, \
 	"continue creating namespaces as long as the filter criteria are met"), \
-OPT_BOOLEAN('R', "autorecover", &param.autorecover, "automatically cleanup on failure")
+OPT_BOOLEAN('R', "autorecover", &param.autorecover, "automatically cleanup on failure"), \
+OPT_UINTEGER(0, "count", &param.count, \
+	"create <n> namespaces spread across the matching regions"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"with --count, create namespaces in up to <n> regions in parallel"), \
+OPT_STRING('P', "placement", &param.placement, "policy", \
+	"pick regions 'first' fit, 'best' fit, or 'spread' across nodes"), \
+OPT_STRING('U', "numa-node", &param.numa_node, "node", \
+	"prefer regions close to <node>, or 'local' to the calling cpu")
 
 #define CHECK_OPTIONS() \
 OPT_BOOLEAN('R', "repair", &repair, "perform metadata repairs"), \
 OPT_BOOLEAN('L', "rewrite-log", &logfix, "regenerate the log"), \
-OPT_BOOLEAN('f', "force", &force, "check namespace even if currently active")
+OPT_BOOLEAN('f', "force", &force, "check namespace even if currently active"), \
+OPT_FILENAME('i', "infile", &param.infile, "image-file", \
+	"check an image of a raw namespace instead of a namespace")
 
 #define CLEAR_OPTIONS() \
 OPT_BOOLEAN('s', "scrub", &scrub, "run a scrub to find latent errors")
@@ -185,18 +207,48 @@ OPT_STRING('p', "parent-uuid", &param.parent_uuid, "parent-uuid", \
 OPT_STRING('O', "offset", &param.offset, "offset", \
 	"EXPERT/DEBUG only: enable namespace inner alignment padding")
 
+#define JOBS_OPTIONS() \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"act on the namespaces of up to <n> regions in parallel")
+
 static const struct option base_options[] = {
 	BASE_OPTIONS(),
+	JOBS_OPTIONS(),
 	OPT_END(),
 };
 
 static const struct option destroy_options[] = {
 	BASE_OPTIONS(),
+	JOBS_OPTIONS(),
 	OPT_BOOLEAN('f', "force", &force,
 			"destroy namespace even if currently active"),
 	OPT_END(),
 };
 
+static const struct option zero_options[] = {
+	BASE_OPTIONS(),
+	OPT_BOOLEAN('f', "force", &force,
+			"zero namespace even if currently active"),
+	OPT_BOOLEAN('d', "dax", &param.dax,
+			"zero through the device-dax mapping, keep the info block"),
+	OPT_UINTEGER('t', "threads", &param.threads,
+			"number of threads to zero with (default: cpus, max 16)"),
+	OPT_END(),
+};
+
+static const struct option scan_options[] = {
+	BASE_OPTIONS(),
+	OPT_BOOLEAN('f', "force", &force,
+			"scan namespace even if currently active"),
+	OPT_BOOLEAN('d', "dax", &param.dax,
+			"scan through the device-dax mapping, leave it enabled"),
+	OPT_UINTEGER('t', "threads", &param.threads,
+			"number of concurrent reads (default: cpus, max 16)"),
+	OPT_BOOLEAN('u', "human", &param.human,
+			"use human friendly number formats"),
+	OPT_END(),
+};
+
 static const struct option create_options[] = {
 	BASE_OPTIONS(),
 	CREATE_OPTIONS(),
@@ -227,6 +279,64 @@ static const struct option write_infoblock_options[] = {
 	OPT_END(),
 };
 
+/* node of the cpu the command runs on, see --numa-node=local */
+static int cpu_numa_node(struct ndctl_ctx *ctx)
+{
+	int cpu = sched_getcpu(), node = NUMA_NO_NODE;
+	char path[PATH_MAX];
+	struct dirent *de;
+	DIR *dir;
+
+	if (cpu < 0)
+		return NUMA_NO_NODE;
+	snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%d",
+			ndctl_get_sysfs_root(ctx), cpu);
+	dir = opendir(path);
+	if (!dir)
+		return NUMA_NO_NODE;
+	while ((de = readdir(dir)) != NULL)
+		if (sscanf(de->d_name, "node%d", &node) == 1)
+			break;
+	closedir(dir);
+	return node < 0 ? NUMA_NO_NODE : node;
+}
+
+/*
+ * Relative access cost from the cpus of node @from to node @to, as
+ * reported by the platform SLIT, 10 being local.
+ */
+static int numa_distance(struct ndctl_ctx *ctx, int from, int to)
+{
+	char path[PATH_MAX], buf[4096], *tok, *save;
+	int i, distance = -1;
+	ssize_t len;
+	int fd;
+
+	if (from == to)
+		return 10;
+	if (from < 0 || to < 0)
+		return 20;
+
+	snprintf(path, sizeof(path), "%s/devices/system/node/node%d/distance",
+			ndctl_get_sysfs_root(ctx), from);
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return 20;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return 20;
+	buf[len] = 0;
+
+	for (i = 0, tok = strtok_r(buf, " \n", &save); tok;
+			i++, tok = strtok_r(NULL, " \n", &save))
+		if (i == to) {
+			distance = strtol(tok, NULL, 0);
+			break;
+		}
+	return distance > 0 ? distance : 20;
+}
+
 static int set_defaults(enum device_action action)
 {
 	uuid_t uuid;
@@ -344,6 +454,53 @@ static int set_defaults(enum device_action action)
 		}
 	}
 
+	if (param.numa_node && action == ACTION_CREATE) {
+		char *end;
+
+		/* resolved against the sysfs root, see collect_batch_regions() */
+		if (strcmp(param.numa_node, "local") == 0)
+			place_local = true;
+		else {
+			place_node = strtol(param.numa_node, &end, 0);
+			if (end == param.numa_node || end[0] || place_node < 0) {
+				error("invalid numa node: '%s'\n",
+						param.numa_node);
+				rc = -EINVAL;
+			}
+		}
+		if (!param.placement)
+			param.placement = "best";
+	}
+
+	if (param.placement && action == ACTION_CREATE) {
+		if (strcmp(param.placement, "first") != 0
+				&& strcmp(param.placement, "best") != 0
+				&& strcmp(param.placement, "spread") != 0) {
+			error("invalid placement '%s', must be 'first', 'best', or 'spread'\n",
+					param.placement);
+			rc = -EINVAL;
+		}
+		if (param.reconfig) {
+			error("--placement is incompatible with --reconfig\n");
+			rc = -EINVAL;
+		}
+	}
+
+	if (param.count && action == ACTION_CREATE) {
+		if (param.reconfig) {
+			error("--count is incompatible with --reconfig\n");
+			rc = -EINVAL;
+		}
+		if (param.uuid) {
+			error("--count is incompatible with --uuid\n");
+			rc = -EINVAL;
+		}
+		if (param.greedy) {
+			error("--count is incompatible with --continue\n");
+			rc = -EINVAL;
+		}
+	}
+
 	if (param.parent_uuid) {
 		if (uuid_parse(param.parent_uuid, uuid)) {
 			error("failed to parse uuid: '%s'\n", param.parent_uuid);
@@ -409,13 +566,21 @@ static const char *parse_namespace_options(int argc, const char **argv,
 			case ACTION_WRITE_INFOBLOCK:
 				action_string = "write-infoblock";
 				break;
+			case ACTION_ZERO:
+				action_string = "zero";
+				break;
+			case ACTION_SCAN:
+				action_string = "scan";
+				break;
 			default:
 				action_string = "<>";
 				break;
 		}
 
 		if ((action != ACTION_READ_INFOBLOCK
-					&& action != ACTION_WRITE_INFOBLOCK)
+					&& action != ACTION_WRITE_INFOBLOCK
+					&& !(action == ACTION_CHECK
+						&& param.infile))
 				|| (action == ACTION_WRITE_INFOBLOCK
 					&& !param.outfile && !param.std_out)) {
 			error("specify a namespace to %s, or \"all\"\n", action_string);
@@ -432,6 +597,11 @@ static const char *parse_namespace_options(int argc, const char **argv,
 		rc = -EINVAL;
 	}
 
+	if (action == ACTION_CHECK && param.infile && argc) {
+		error("specify a namespace, or --infile, not both\n");
+		rc = -EINVAL;
+	}
+
 	if (action == ACTION_WRITE_INFOBLOCK && (param.outfile || param.std_out)
 			&& argc) {
 		error("specify only one of a namespace filter, --output, or --stdout\n");
@@ -602,9 +772,14 @@ static int setup_namespace(struct ndctl_region *region,
 		if (isatty(1))
 			flags |= UTIL_JSON_HUMAN;
 		jndns = util_namespace_to_json(ndns, flags);
-		if (jndns)
+		if (jndns && batch_out)
+			fprintf(batch_out, "%s\n",
+					json_object_to_json_string_ext(jndns,
+						JSON_C_TO_STRING_PLAIN));
+		else if (jndns)
 			printf("%s\n", json_object_to_json_string_ext(jndns,
 						JSON_C_TO_STRING_PRETTY));
+		json_object_put(jndns);
 	}
 	return rc;
 }
@@ -1024,6 +1199,402 @@ static int namespace_create(struct ndctl_region *region)
 	return rc;
 }
 
+static bool region_type_filter(struct ndctl_region *region)
+{
+	if (!param.type)
+		return true;
+	if (strcmp(param.type, "pmem") == 0)
+		return ndctl_region_get_type(region) == ND_DEVICE_REGION_PMEM;
+	if (strcmp(param.type, "blk") == 0)
+		return ndctl_region_get_type(region) == ND_DEVICE_REGION_BLK;
+	return false;
+}
+
+/*
+ * struct batch_region - namespaces planned for one region by --count
+ * @extent: capacity available for the plan
+ * @step: granularity of a namespace size in this region
+ * @size: size of each namespace, or 0 to split @extent evenly
+ * @num: namespaces the region is assigned
+ * @node: numa node the region is attached to
+ * @distance: numa distance from --numa-node, 0 if not specified
+ * @aligned: the region start satisfies the namespace alignment
+ * @index: listing order, the last placement tie breaker
+ */
+struct batch_region {
+	struct ndctl_region *region;
+	unsigned long long extent;
+	unsigned long long step;
+	unsigned long long size;
+	unsigned int max;
+	unsigned int num;
+	int node;
+	int distance;
+	bool aligned;
+	int index;
+};
+
+static unsigned long long batch_size(struct batch_region *br,
+		unsigned int num)
+{
+	if (br->size)
+		return br->size;
+	return rounddown(br->extent / num, br->step);
+}
+
+static bool batch_can_grow(struct batch_region *br)
+{
+	unsigned long long size;
+
+	if (br->num >= br->max)
+		return false;
+	size = batch_size(br, br->num + 1);
+	return size && size >= SZ_16M;
+}
+
+/*
+ * Record the capacity of a candidate region for batch creation. The
+ * namespace options are validated once per region, with the default
+ * size standing in for the whole extent when --size is not specified.
+ */
+static int batch_region_init(struct ndctl_region *region,
+		struct batch_region *br)
+{
+	unsigned long region_align = ndctl_region_get_align(region);
+	struct ndctl_namespace *ndns;
+	unsigned long long step, unit, resource, align;
+	struct parsed_parameters p;
+	int rc;
+
+	rc = validate_namespace_options(region, NULL, &p);
+	if (rc)
+		return rc;
+
+	if (ndctl_region_get_ro(region))
+		return -EAGAIN;
+	ndns = region_get_namespace(region);
+	if (!ndns || !ndctl_namespace_is_configuration_idle(ndns))
+		return -EAGAIN;
+
+	*br = (struct batch_region) {
+		.region = region,
+		.max = UINT_MAX,
+	};
+
+	/* sizes must be a multiple of both the interleave and region align */
+	unit = p.align * ndctl_region_get_interleave_ways(region);
+	for (step = unit; region_align < ULONG_MAX && step % region_align;
+			step += unit)
+		;
+	br->step = step;
+
+	if (param.size)
+		br->size = p.size;
+
+	/* given a zero size, validate_available_capacity() reports the extent */
+	p.size = 0;
+	rc = validate_available_capacity(region, &p);
+	if (rc)
+		return rc;
+	br->extent = p.size;
+
+	if (ndctl_region_get_nstype(region) == ND_DEVICE_NAMESPACE_IO)
+		br->max = 1;
+	else if (br->size)
+		br->max = br->extent / br->size;
+
+	br->node = ndctl_region_get_numa_node(region);
+	if (br->node < 0)
+		br->node = ndctl_region_get_target_node(region);
+	if (place_node != NUMA_NO_NODE)
+		br->distance = numa_distance(ndctl_region_get_ctx(region),
+				place_node, br->node);
+
+	/*
+	 * A region that does not start on the default or requested
+	 * alignment falls back to page sized mappings, or can not host
+	 * dax at all, see validate_namespace_options() and
+	 * check_dax_align().
+	 */
+	resource = ndctl_region_get_resource(region);
+	align = param.align ? parse_size64(param.align) : SZ_2M;
+	br->aligned = resource == ULLONG_MAX || (IS_ALIGNED(resource, align)
+			&& (p.mode == NDCTL_NS_MODE_RAW
+				|| p.mode == NDCTL_NS_MODE_SECTOR
+				|| IS_ALIGNED(resource, SZ_16M)));
+	return 0;
+}
+
+/*
+ * Order candidate regions for --placement=best: regions that keep the
+ * requested alignment first, then the closest to --numa-node, then the
+ * tightest fit for an explicit --size, which preserves large extents
+ * for later allocations, or the largest extent otherwise.
+ */
+static int batch_region_cmp(const void *_a, const void *_b)
+{
+	const struct batch_region *a = _a, *b = _b;
+
+	if (a->aligned != b->aligned)
+		return a->aligned ? -1 : 1;
+	if (a->distance != b->distance)
+		return a->distance < b->distance ? -1 : 1;
+	if (a->extent != b->extent) {
+		if (param.size)
+			return a->extent < b->extent ? -1 : 1;
+		return a->extent > b->extent ? -1 : 1;
+	}
+	/* keep listing order, qsort() is not stable */
+	return a->index - b->index;
+}
+
+static int batch_create_region(void *arg, FILE *f_out)
+{
+	struct batch_region *br = arg;
+	unsigned int i;
+	char size[32];
+	int rc = 0;
+
+	sprintf(size, "%llu", batch_size(br, br->num));
+	param.size = size;
+	batch_out = f_out;
+
+	for (i = 0; i < br->num; i++) {
+		rc = namespace_create(br->region);
+		if (rc)
+			break;
+	}
+	return rc == -EAGAIN ? -ENOSPC : rc;
+}
+
+/*
+ * namespace_create_batch - create param.count namespaces in one pass
+ *
+ * Assign the namespaces to the matching regions round-robin, and size
+ * them up front, so that an unsatisfiable request fails before anything
+ * is created. Regions are then populated independently of each other,
+ * up to param.jobs at a time, and the new namespaces are reported as
+ * one json array. A region that fails stops there, what was already
+ * created is left in place and reported.
+ */
+static int collect_batch_regions(struct ndctl_ctx *ctx,
+		struct batch_region **regions, int *num_regions)
+{
+	struct ndctl_region *region;
+	struct batch_region *br;
+	struct ndctl_bus *bus;
+	int rc;
+
+	*regions = NULL;
+	*num_regions = 0;
+	if (place_local) {
+		place_node = cpu_numa_node(ctx);
+		if (place_node == NUMA_NO_NODE)
+			debug("numa node of the local cpu unknown\n");
+	}
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_bus_filter(bus, param.bus))
+			continue;
+
+		ndctl_region_foreach(bus, region) {
+			struct batch_region tmp;
+
+			if (!util_region_filter(region, param.region))
+				continue;
+			if (!region_type_filter(region))
+				continue;
+
+			rc = batch_region_init(region, &tmp);
+			if (rc == -EAGAIN)
+				continue;
+			if (rc)
+				return rc;
+
+			br = realloc(*regions, (*num_regions + 1)
+					* sizeof(*br));
+			if (!br)
+				return -ENOMEM;
+			*regions = br;
+			tmp.index = *num_regions;
+			(*regions)[(*num_regions)++] = tmp;
+		}
+	}
+
+	if (param.placement && strcmp(param.placement, "first") != 0)
+		qsort(*regions, *num_regions, sizeof(**regions),
+				batch_region_cmp);
+	return 0;
+}
+
+/*
+ * Find the @nth distinct numa node in the order of @regions. Regions
+ * without a node (NUMA_NO_NODE) are a group of their own.
+ */
+static bool batch_nth_node(struct batch_region *regions, int num_regions,
+		int nth, int *node)
+{
+	int i, j;
+
+	for (i = 0; i < num_regions; i++) {
+		for (j = 0; j < i; j++)
+			if (regions[j].node == regions[i].node)
+				break;
+		if (j == i && nth-- == 0) {
+			*node = regions[i].node;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Pick the region for the next namespace of a --count plan: the next
+ * region round-robin for 'first', the best ranked region with room
+ * for 'best', and for 'spread' the least loaded region of the next
+ * numa node in turn.
+ */
+static struct batch_region *batch_plan_next(struct batch_region *regions,
+		int num_regions, int *cursor)
+{
+	const char *placement = param.placement ? param.placement : "first";
+	struct batch_region *br, *pick;
+	int i, j, node, num_nodes;
+
+	if (strcmp(placement, "best") == 0) {
+		for (i = 0; i < num_regions; i++)
+			if (batch_can_grow(&regions[i]))
+				return &regions[i];
+		return NULL;
+	}
+
+	if (strcmp(placement, "first") == 0) {
+		for (i = 0; i < num_regions; i++) {
+			j = (*cursor + i) % num_regions;
+			if (batch_can_grow(&regions[j])) {
+				*cursor = j + 1;
+				return &regions[j];
+			}
+		}
+		return NULL;
+	}
+
+	for (num_nodes = 0; batch_nth_node(regions, num_regions, num_nodes,
+				&node); num_nodes++)
+		;
+	for (i = 0; i < num_nodes; i++) {
+		batch_nth_node(regions, num_regions, (*cursor + i) % num_nodes,
+				&node);
+		pick = NULL;
+		for (j = 0; j < num_regions; j++) {
+			br = &regions[j];
+			if (br->node != node || !batch_can_grow(br))
+				continue;
+			if (!pick || br->num < pick->num)
+				pick = br;
+		}
+		if (pick) {
+			*cursor = (*cursor + i + 1) % num_nodes;
+			return pick;
+		}
+	}
+	return NULL;
+}
+
+static int namespace_create_batch(struct ndctl_ctx *ctx, int *processed)
+{
+	struct batch_region *regions = NULL, *br;
+	struct json_object *jnamespaces = NULL;
+	unsigned int planned = 0, num_jobs = 0;
+	int num_regions = 0, i, j, rc = 0;
+	struct util_job *jobs = NULL;
+	int cursor = 0;
+
+	rc = collect_batch_regions(ctx, &regions, &num_regions);
+	if (rc)
+		goto out;
+
+	while (planned < param.count) {
+		br = batch_plan_next(regions, num_regions, &cursor);
+		if (!br)
+			break;
+		br->num++;
+		planned++;
+	}
+
+	if (planned < param.count) {
+		err("insufficient capacity for %u namespaces, %u available\n",
+				param.count, planned);
+		rc = -ENOSPC;
+		goto out;
+	}
+
+	for (i = 0; i < num_regions; i++)
+		if (regions[i].num) {
+			debug("%s: %u namespace%s of %#llx\n",
+					ndctl_region_get_devname(
+						regions[i].region),
+					regions[i].num,
+					regions[i].num == 1 ? "" : "s",
+					batch_size(&regions[i],
+						regions[i].num));
+			num_jobs++;
+		}
+
+	jobs = calloc(num_jobs, sizeof(*jobs));
+	if (!jobs) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0, j = 0; i < num_regions; i++) {
+		if (!regions[i].num)
+			continue;
+		jobs[j].run = batch_create_region;
+		jobs[j++].arg = &regions[i];
+	}
+
+	fflush(stdout);
+	rc = util_jobs_run(jobs, num_jobs, param.jobs);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < (int) num_jobs; i++) {
+		char *line, *save;
+
+		br = jobs[i].arg;
+		if (jobs[i].rc < 0) {
+			err("%s: %s\n", ndctl_region_get_devname(br->region),
+					strerror(-jobs[i].rc));
+			if (!rc)
+				rc = jobs[i].rc;
+		}
+
+		for (line = jobs[i].out ? strtok_r(jobs[i].out, "\n", &save)
+					: NULL; line;
+				line = strtok_r(NULL, "\n", &save)) {
+			struct json_object *jndns = json_tokener_parse(line);
+
+			(*processed)++;
+			if (!jnamespaces)
+				jnamespaces = json_object_new_array();
+			if (jnamespaces && jndns)
+				json_object_array_add(jnamespaces, jndns);
+			else
+				json_object_put(jndns);
+		}
+	}
+
+	if (jnamespaces)
+		util_display_json_array(stdout, jnamespaces,
+				isatty(1) ? UTIL_JSON_HUMAN : 0);
+ out:
+	for (j = 0; jobs && j < (int) num_jobs; j++)
+		free(jobs[j].out);
+	free(regions);
+	free(jobs);
+	return rc;
+}
+
 /*
  * Return convention:
  * rc < 0 : Error while zeroing, propagate forward
@@ -1273,6 +1844,13 @@ static int namespace_reconfig(struct ndctl_region *region,
 
 int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 		bool repair, bool logfix);
+int namespace_check_file(const char *path, bool verbose, bool repair,
+		bool logfix);
+int namespace_zero(struct ndctl_namespace *ndns, unsigned int threads,
+		bool dax, bool force, bool progress);
+int namespace_scan(struct ndctl_namespace *ndns, unsigned int threads,
+		bool dax, bool force, bool progress, unsigned long flags,
+		struct json_object **jscan);
 
 static int bus_send_clear(struct ndctl_bus *bus, unsigned long long start,
 		unsigned long long size)
@@ -2064,10 +2642,189 @@ out:
 	return rc;
 }
 
+/*
+ * Create one namespace, or with --continue one per region, on the
+ * candidate regions in --placement order rather than listing order.
+ */
+static int namespace_create_placed(struct ndctl_ctx *ctx, int *processed)
+{
+	struct batch_region *regions;
+	int num_regions, i, rc, saved_rc = 0;
+
+	rc = collect_batch_regions(ctx, &regions, &num_regions);
+	if (rc) {
+		free(regions);
+		return rc;
+	}
+
+	rc = -EAGAIN;
+	for (i = 0; i < num_regions; i++) {
+		debug("%s: node: %d distance: %d aligned: %d extent: %#llx\n",
+				ndctl_region_get_devname(regions[i].region),
+				regions[i].node, regions[i].distance,
+				regions[i].aligned, regions[i].extent);
+		rc = namespace_create(regions[i].region);
+		if (rc == -EAGAIN)
+			continue;
+		if (rc == 0) {
+			(*processed)++;
+			if (param.greedy)
+				continue;
+		} else if (param.greedy && force) {
+			saved_rc = rc;
+			continue;
+		}
+		break;
+	}
+	free(regions);
+
+	if (rc == -EAGAIN)
+		rc = param.greedy && *processed ? 0 : -ENOSPC;
+	if (saved_rc)
+		rc = saved_rc;
+	return rc;
+}
+
+struct region_xaction {
+	struct ndctl_region *region;
+	const char *namespace;
+	enum device_action action;
+};
+
+/*
+ * Runs as a util_jobs_run() job, acting on the matching namespaces of
+ * one region in order and writing the name of each processed namespace
+ * to @f_out.
+ */
+static int xaction_region_namespaces(void *arg, FILE *f_out)
+{
+	struct region_xaction *rx = arg;
+	struct ndctl_namespace *ndns, *_n;
+	int rc, err = 0;
+
+	ndctl_namespace_foreach_safe(rx->region, ndns, _n) {
+		const char *ndns_name = ndctl_namespace_get_devname(ndns);
+
+		if (strcmp(rx->namespace, "all") != 0
+				&& strcmp(rx->namespace, ndns_name) != 0)
+			continue;
+
+		switch (rx->action) {
+		case ACTION_DISABLE:
+			rc = ndctl_namespace_disable_safe(ndns);
+			break;
+		case ACTION_ENABLE:
+			rc = ndctl_namespace_enable(ndns);
+			if (rc > 0)
+				rc = 0;
+			break;
+		case ACTION_DESTROY:
+			rc = namespace_destroy(rx->region, ndns);
+			/* skipped, succeed without counting it */
+			if (rc > 0)
+				continue;
+			break;
+		default:
+			rc = -EINVAL;
+			break;
+		}
+
+		if (rc == 0)
+			fprintf(f_out, "%s\n", ndns_name);
+		else if (!err)
+			err = rc;
+	}
+
+	return err;
+}
+
+/*
+ * Enable, disable, or destroy namespaces with the regions handled
+ * concurrently. Namespaces within a region share its seed devices and
+ * label area so they are still processed one at a time. Each bus is
+ * flushed of pending probes once everything has been issued.
+ */
+static int do_xaction_namespace_parallel(const char *namespace,
+		enum device_action action, struct ndctl_ctx *ctx,
+		int *processed)
+{
+	struct region_xaction *rxs = NULL, *rx;
+	struct util_job *jobs = NULL;
+	struct ndctl_region *region;
+	int num = 0, i, rc = 0;
+	struct ndctl_bus *bus;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_bus_filter(bus, param.bus))
+			continue;
+
+		ndctl_region_foreach(bus, region) {
+			if (!util_region_filter(region, param.region))
+				continue;
+			if (!region_type_filter(region))
+				continue;
+			if (!ndctl_namespace_get_first(region))
+				continue;
+
+			rx = realloc(rxs, (num + 1) * sizeof(*rxs));
+			if (!rx) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			rxs = rx;
+			rxs[num++] = (struct region_xaction) {
+				.region = region,
+				.namespace = namespace,
+				.action = action,
+			};
+		}
+	}
+
+	if (!num)
+		return -ENXIO;
+
+	jobs = calloc(num, sizeof(*jobs));
+	if (!jobs) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < num; i++) {
+		jobs[i].run = xaction_region_namespaces;
+		jobs[i].arg = &rxs[i];
+	}
+
+	fflush(stdout);
+	rc = util_jobs_run(jobs, num, param.jobs);
+	if (rc)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		char *line, *save;
+
+		if (jobs[i].rc < 0 && !rc)
+			rc = jobs[i].rc;
+		for (line = jobs[i].out ? strtok_r(jobs[i].out, "\n", &save)
+					: NULL; line;
+				line = strtok_r(NULL, "\n", &save))
+			(*processed)++;
+	}
+
+	ndctl_bus_foreach(ctx, bus)
+		if (util_bus_filter(bus, param.bus))
+			ndctl_bus_wait_probe(bus);
+ out:
+	for (i = 0; jobs && i < num; i++)
+		free(jobs[i].out);
+	free(rxs);
+	free(jobs);
+	return rc;
+}
+
 static int do_xaction_namespace(const char *namespace,
 		enum device_action action, struct ndctl_ctx *ctx,
 		int *processed)
 {
+	struct json_object *jscans = NULL, *jscan = NULL;
 	struct read_infoblock_ctx ri_ctx = { 0 };
 	struct ndctl_namespace *ndns, *_n;
 	int rc = -ENXIO, saved_rc = 0;
@@ -2099,6 +2856,14 @@ static int do_xaction_namespace(const char *namespace,
 		}
 	}
 
+	if (action == ACTION_CHECK && param.infile) {
+		rc = namespace_check_file(param.infile, verbose, repair,
+				logfix);
+		if (rc == 0)
+			(*processed)++;
+		return rc;
+	}
+
 	if (action == ACTION_WRITE_INFOBLOCK && !namespace) {
 		if (!param.align)
 			param.align = "2M";
@@ -2115,6 +2880,12 @@ static int do_xaction_namespace(const char *namespace,
 	if (verbose)
 		ndctl_set_log_priority(ctx, LOG_DEBUG);
 
+	if (action == ACTION_SCAN) {
+		jscans = json_object_new_array();
+		if (!jscans)
+			return -ENOMEM;
+	}
+
 	if (action == ACTION_ENABLE)
 		cmd_name = "enable namespace";
 	else if (action == ACTION_DISABLE)
@@ -2127,6 +2898,23 @@ static int do_xaction_namespace(const char *namespace,
 		cmd_name = "check namespace";
 	else if (action == ACTION_CLEAR)
 		cmd_name = "clear errors namespace";
+	else if (action == ACTION_ZERO)
+		cmd_name = "zero namespace";
+	else if (action == ACTION_SCAN)
+		cmd_name = "scan namespace";
+
+	if (action == ACTION_CREATE && !namespace && param.count)
+		return namespace_create_batch(ctx, processed);
+
+	if (action == ACTION_CREATE && !namespace && param.placement
+			&& strcmp(param.placement, "first") != 0)
+		return namespace_create_placed(ctx, processed);
+
+	if (param.jobs > 1 && (action == ACTION_ENABLE
+				|| action == ACTION_DISABLE
+				|| action == ACTION_DESTROY))
+		return do_xaction_namespace_parallel(namespace, action, ctx,
+				processed);
 
         ndctl_bus_foreach(ctx, bus) {
 		bool do_scrub;
@@ -2141,18 +2929,8 @@ static int do_xaction_namespace(const char *namespace,
 			if (!util_region_filter(region, param.region))
 				continue;
 
-			if (param.type) {
-				if (strcmp(param.type, "pmem") == 0
-						&& ndctl_region_get_type(region)
-						== ND_DEVICE_REGION_PMEM)
-					/* pass */;
-				else if (strcmp(param.type, "blk") == 0
-						&& ndctl_region_get_type(region)
-						== ND_DEVICE_REGION_BLK)
-					/* pass */;
-				else
-					continue;
-			}
+			if (!region_type_filter(region))
+				continue;
 
 			if (action == ACTION_CREATE && !namespace) {
 				rc = namespace_create(region);
@@ -2174,6 +2952,11 @@ static int do_xaction_namespace(const char *namespace,
 				if (strcmp(namespace, "all") != 0
 						&& strcmp(namespace, ndns_name) != 0)
 					continue;
+				/* idle seed namespaces have no capacity to do i/o to */
+				if ((action == ACTION_ZERO
+						|| action == ACTION_SCAN)
+						&& !ndctl_namespace_get_size(ndns))
+					continue;
 				switch (action) {
 				case ACTION_DISABLE:
 					rc = ndctl_namespace_disable_safe(ndns);
@@ -2214,6 +2997,26 @@ static int do_xaction_namespace(const char *namespace,
 					if (rc == 0)
 						*processed = 1;
 					return rc;
+				case ACTION_ZERO:
+					rc = namespace_zero(ndns, param.threads,
+							param.dax, force,
+							verbose || isatty(2));
+					if (rc == 0)
+						(*processed)++;
+					break;
+				case ACTION_SCAN:
+					rc = namespace_scan(ndns, param.threads,
+							param.dax, force,
+							verbose || isatty(2),
+							param.human
+							? UTIL_JSON_HUMAN : 0,
+							&jscan);
+					if (rc == 0) {
+						json_object_array_add(jscans,
+								jscan);
+						(*processed)++;
+					}
+					break;
 				case ACTION_READ_INFOBLOCK:
 					rc = namespace_rw_infoblock(ndns, &ri_ctx, READ);
 					if (rc == 0)
@@ -2235,6 +3038,12 @@ static int do_xaction_namespace(const char *namespace,
 	if (ri_ctx.jblocks)
 		util_display_json_array(ri_ctx.f_out, ri_ctx.jblocks, 0);
 
+	if (jscans && json_object_array_length(jscans))
+		util_display_json_array(stdout, jscans,
+				param.human ? UTIL_JSON_HUMAN : 0);
+	else if (jscans)
+		json_object_put(jscans);
+
 	if (ri_ctx.f_out && ri_ctx.f_out != stdout)
 		fclose(ri_ctx.f_out);
 
@@ -2310,7 +3119,7 @@ int cmd_create_namespace(int argc, const char **argv, struct ndctl_ctx *ctx)
 		rc = do_xaction_namespace(NULL, ACTION_CREATE, ctx, &created);
 	}
 
-	if (param.greedy)
+	if (param.greedy || param.count)
 		fprintf(stderr, "created %d namespace%s\n", created,
 			created == 1 ? "" : "s");
 	if ((rc < 0 || (!namespace && created < 1)) && !err_count) {
@@ -2339,6 +3148,44 @@ int cmd_destroy_namespace(int argc , const char **argv, struct ndctl_ctx *ctx)
 	return rc;
 }
 
+int cmd_zero_namespace(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	char *xable_usage = "ndctl zero-namespace <namespace> [<options>]";
+	const char *namespace = parse_namespace_options(argc, argv,
+			ACTION_ZERO, zero_options, xable_usage);
+	int zeroed, rc;
+
+	if (!param.threads)
+		param.threads = min(sysconf(_SC_NPROCESSORS_ONLN), 16L);
+
+	rc = do_xaction_namespace(namespace, ACTION_ZERO, ctx, &zeroed);
+	if (rc < 0 && !err_count)
+		fprintf(stderr, "error zeroing namespaces: %s\n",
+				strerror(-rc));
+	fprintf(stderr, "zeroed %d namespace%s\n", zeroed,
+			zeroed == 1 ? "" : "s");
+	return rc;
+}
+
+int cmd_scan_namespace(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	char *xable_usage = "ndctl scan-namespace <namespace> [<options>]";
+	const char *namespace = parse_namespace_options(argc, argv,
+			ACTION_SCAN, scan_options, xable_usage);
+	int scanned, rc;
+
+	if (!param.threads)
+		param.threads = min(sysconf(_SC_NPROCESSORS_ONLN), 16L);
+
+	rc = do_xaction_namespace(namespace, ACTION_SCAN, ctx, &scanned);
+	if (rc < 0 && !err_count)
+		fprintf(stderr, "error scanning namespaces: %s\n",
+				strerror(-rc));
+	fprintf(stderr, "scanned %d namespace%s\n", scanned,
+			scanned == 1 ? "" : "s");
+	return rc;
+}
+
 int cmd_check_namespace(int argc , const char **argv, struct ndctl_ctx *ctx)
 {
 	char *xable_usage = "ndctl check-namespace <namespace> [<options>]";
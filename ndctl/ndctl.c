@@ -76,6 +76,8 @@ static struct cmd_struct commands[] = {
 	{ "read-infoblock",  { cmd_read_infoblock } },
 	{ "write-infoblock",  { cmd_write_infoblock } },
 	{ "check-namespace", { cmd_check_namespace } },
+	{ "zero-namespace", { cmd_zero_namespace } },
+	{ "scan-namespace", { cmd_scan_namespace } },
 	{ "clear-errors", { cmd_clear_errors } },
 	{ "enable-region", { cmd_enable_region } },
 	{ "disable-region", { cmd_disable_region } },
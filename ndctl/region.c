@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include "action.h"
+#include <util/jobs.h>
 #include <util/filter.h>
 #include <util/parse-options.h>
 #include <ndctl/libndctl.h>
@@ -22,6 +23,7 @@
 static struct {
 	const char *bus;
 	const char *type;
+	unsigned int jobs;
 } param;
 
 static const struct option region_options[] = {
@@ -29,6 +31,8 @@ static const struct option region_options[] = {
 			"<region> must be on a bus with an id/provider of <bus-id>"),
 	OPT_STRING('t', "type", &param.type, "region-type",
 			"<region> must be of the specified type"),
+	OPT_UINTEGER('j', "jobs", &param.jobs,
+			"act on up to <n> regions in parallel"),
 	OPT_END(),
 };
 
@@ -92,10 +96,59 @@ static int region_action(struct ndctl_region *region, enum device_action mode)
 	return rc;
 }
 
+struct region_job {
+	struct ndctl_region *region;
+	enum device_action mode;
+};
+
+static int region_job(void *arg, FILE *f_out)
+{
+	struct region_job *rj = arg;
+
+	return region_action(rj->region, rj->mode);
+}
+
+/*
+ * Regions are independent of each other, so with --jobs their driver
+ * bind / unbind round trips are overlapped, and each bus is flushed of
+ * pending probes once at the end.
+ */
+static int do_xable_region_parallel(struct region_job *rjs, int num,
+		struct ndctl_ctx *ctx)
+{
+	struct ndctl_bus *bus;
+	struct util_job *jobs;
+	int i, rc, success = 0;
+
+	jobs = calloc(num, sizeof(*jobs));
+	if (!jobs)
+		return -ENOMEM;
+	for (i = 0; i < num; i++) {
+		jobs[i].run = region_job;
+		jobs[i].arg = &rjs[i];
+	}
+
+	rc = util_jobs_run(jobs, num, param.jobs);
+	for (i = 0; i < num; i++) {
+		if (!rc && jobs[i].rc == 0)
+			success++;
+		free(jobs[i].out);
+	}
+	free(jobs);
+	if (rc)
+		return rc;
+
+	ndctl_bus_foreach(ctx, bus)
+		if (util_bus_filter(bus, param.bus))
+			ndctl_bus_wait_probe(bus);
+	return success;
+}
+
 static int do_xable_region(const char *region_arg, enum device_action mode,
 		struct ndctl_ctx *ctx)
 {
-	int rc = -ENXIO, success = 0;
+	int rc = -ENXIO, success = 0, num = 0;
+	struct region_job *rjs = NULL, *rj;
 	struct ndctl_region *region;
 	struct ndctl_bus *bus;
 
@@ -113,13 +166,30 @@ static int do_xable_region(const char *region_arg, enum device_action mode,
 				continue;
 			if (!util_region_filter(region, region_arg))
 				continue;
-			if (region_action(region, mode) == 0)
-				success++;
+			if (param.jobs <= 1) {
+				if (region_action(region, mode) == 0)
+					success++;
+				continue;
+			}
+
+			rj = realloc(rjs, (num + 1) * sizeof(*rjs));
+			if (!rj) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			rjs = rj;
+			rjs[num++] = (struct region_job) {
+				.region = region,
+				.mode = mode,
+			};
 		}
 	}
 
+	if (num)
+		success = do_xable_region_parallel(rjs, num, ctx);
 	rc = success;
  out:
+	free(rjs);
 	param.bus = NULL;
 	return rc;
 }
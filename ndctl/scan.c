@@ -0,0 +1,453 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <util/size.h>
+#include <util/util.h>
+#include <util/json.h>
+#include <json-c/json.h>
+#include <ndctl/libndctl.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/container_of/container_of.h>
+
+#include "namespace-io.h"
+
+#define SCAN_CHUNK SZ_1M
+#define SCAN_SECTOR 512
+
+/* a byte range relative to the start of the scanned device */
+struct scan_extent {
+	unsigned long long offset;
+	unsigned long long len;
+};
+
+/*
+ * struct scan_ctx - one namespace being scanned
+ * @io: the device being read, @io.err is the first error other than a
+ *	media error seen by any worker
+ * @next: offset of the next chunk to be claimed by a worker
+ * @bad: ranges that failed to read, appended under @lock
+ */
+struct scan_ctx {
+	struct ns_io io;
+	unsigned long long next;
+	pthread_mutex_t lock;
+	struct scan_extent *bad;
+	unsigned int nr_bad;
+	unsigned int alloc_bad;
+};
+
+static __thread sigjmp_buf scan_jmp;
+static __thread volatile sig_atomic_t scan_armed;
+static __thread struct scan_extent scan_fault;
+
+static int extent_add(struct scan_extent **ext, unsigned int *nr,
+		unsigned int *alloc, unsigned long long offset,
+		unsigned long long len)
+{
+	struct scan_extent *e;
+
+	if (*nr && (*ext)[*nr - 1].offset + (*ext)[*nr - 1].len == offset) {
+		(*ext)[*nr - 1].len += len;
+		return 0;
+	}
+
+	if (*nr == *alloc) {
+		e = realloc(*ext, (*alloc + 16) * sizeof(*e));
+		if (!e)
+			return -ENOMEM;
+		*ext = e;
+		*alloc += 16;
+	}
+	(*ext)[(*nr)++] = (struct scan_extent) {
+		.offset = offset,
+		.len = len,
+	};
+	return 0;
+}
+
+static int extent_cmp(const void *a, const void *b)
+{
+	const struct scan_extent *ea = a, *eb = b;
+
+	if (ea->offset < eb->offset)
+		return -1;
+	return ea->offset > eb->offset;
+}
+
+/* sort @ext and coalesce overlapping or adjacent ranges in place */
+static unsigned int extent_merge(struct scan_extent *ext, unsigned int nr)
+{
+	unsigned int i, n = 0;
+
+	if (!nr)
+		return 0;
+
+	qsort(ext, nr, sizeof(*ext), extent_cmp);
+	for (i = 1; i < nr; i++) {
+		struct scan_extent *last = &ext[n];
+
+		if (ext[i].offset <= last->offset + last->len) {
+			last->len = max(last->len,
+					ext[i].offset + ext[i].len - last->offset);
+			continue;
+		}
+		ext[++n] = ext[i];
+	}
+	return n + 1;
+}
+
+/* bytes of @e that are covered by the sorted, merged list @ext */
+static unsigned long long extent_overlap(struct scan_extent *e,
+		struct scan_extent *ext, unsigned int nr)
+{
+	unsigned long long sum = 0, start, end;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		if (ext[i].offset >= e->offset + e->len)
+			break;
+		start = max(ext[i].offset, e->offset);
+		end = min(ext[i].offset + ext[i].len, e->offset + e->len);
+		if (end > start)
+			sum += end - start;
+	}
+	return sum;
+}
+
+static void scan_record(struct scan_ctx *sctx, unsigned long long offset,
+		unsigned long long len)
+{
+	int rc;
+
+	pthread_mutex_lock(&sctx->lock);
+	rc = extent_add(&sctx->bad, &sctx->nr_bad, &sctx->alloc_bad,
+			offset, len);
+	pthread_mutex_unlock(&sctx->lock);
+	if (rc)
+		ns_io_set_err(&sctx->io, rc);
+}
+
+static void scan_sigbus(int sig, siginfo_t *info, void *uctx)
+{
+	unsigned long long len;
+
+	if (!scan_armed) {
+		signal(sig, SIG_DFL);
+		raise(sig);
+		return;
+	}
+
+	len = info->si_addr_lsb ? 1ULL << info->si_addr_lsb : SZ_4K;
+	scan_fault.offset = (uintptr_t) info->si_addr & ~(len - 1);
+	scan_fault.len = len;
+	scan_armed = 0;
+	siglongjmp(scan_jmp, 1);
+}
+
+/*
+ * Reads through the mapping are done with a plain memcpy(), poison
+ * that is consumed raises SIGBUS with the address and size of the
+ * failed page, which is recorded before moving on to the next page.
+ * Every fault moves on by at least a page, so a fault address that
+ * does not lie past @off can't stall the scan.
+ */
+static void scan_chunk_dax(struct scan_ctx *sctx, char *buf,
+		unsigned long long start, unsigned long long len)
+{
+	volatile unsigned long long off = start;
+	unsigned long long end = start + len, bad;
+
+	while (off < end) {
+		if (sigsetjmp(scan_jmp, 1)) {
+			bad = scan_fault.offset - (uintptr_t) sctx->io.addr;
+			scan_record(sctx, bad, scan_fault.len);
+			off = max(bad + scan_fault.len,
+					off + (unsigned long long) SZ_4K);
+			continue;
+		}
+		scan_armed = 1;
+		memcpy(buf, sctx->io.addr + off, end - off);
+		scan_armed = 0;
+		off = end;
+	}
+}
+
+/*
+ * Block devices are read with O_DIRECT, the pmem driver fails reads
+ * that touch known badblocks, or that consume poison, with EIO. A
+ * failed chunk is read again a sector at a time to find the extent of
+ * the error.
+ */
+static void scan_chunk_blk(struct scan_ctx *sctx, char *buf,
+		unsigned long long start, unsigned long long len)
+{
+	unsigned long long off;
+	ssize_t n;
+
+	for (off = start; off < start + len; off += n) {
+		n = pread(sctx->io.fd, buf, start + len - off, off);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n < 0 && errno == EIO)
+			break;
+		if (n <= 0) {
+			ns_io_set_err(&sctx->io, n < 0 ? -errno : -ENXIO);
+			return;
+		}
+	}
+
+	for (; off < start + len; off += SCAN_SECTOR) {
+		do
+			n = pread(sctx->io.fd, buf, SCAN_SECTOR, off);
+		while (n < 0 && errno == EINTR);
+		if (n < 0 && errno == EIO)
+			scan_record(sctx, off, SCAN_SECTOR);
+		else if (n != SCAN_SECTOR) {
+			ns_io_set_err(&sctx->io, n < 0 ? -errno : -ENXIO);
+			return;
+		}
+	}
+}
+
+static void scan_worker(struct ns_io *io, unsigned int idx, unsigned int nr)
+{
+	struct scan_ctx *sctx = container_of(io, struct scan_ctx, io);
+	unsigned long long off, len;
+	void *buf;
+
+	if (posix_memalign(&buf, SZ_4K, SCAN_CHUNK)) {
+		ns_io_set_err(io, -ENOMEM);
+		return;
+	}
+
+	/* claim chunks one at a time so a slow error path can't stall */
+	for (;;) {
+		if (__atomic_load_n(&io->err, __ATOMIC_RELAXED))
+			break;
+		off = __atomic_fetch_add(&sctx->next, SCAN_CHUNK,
+				__ATOMIC_RELAXED);
+		if (off >= io->size)
+			break;
+		len = min(io->size - off, (unsigned long long) SCAN_CHUNK);
+		if (io->addr)
+			scan_chunk_dax(sctx, buf, off, len);
+		else
+			scan_chunk_blk(sctx, buf, off, len);
+		__atomic_add_fetch(&io->done, len, __ATOMIC_RELAXED);
+	}
+
+	free(buf);
+}
+
+static int scan_run(struct scan_ctx *sctx, unsigned int threads,
+		bool progress, unsigned long long *elapsed)
+{
+	struct sigaction act = {
+		.sa_sigaction = scan_sigbus,
+		.sa_flags = SA_SIGINFO,
+	}, oact;
+	int rc;
+
+	if (sctx->io.addr && sigaction(SIGBUS, &act, &oact) < 0)
+		return -errno;
+	rc = ns_io_run(&sctx->io, scan_worker, threads, "scanned", progress,
+			elapsed);
+	if (sctx->io.addr)
+		sigaction(SIGBUS, &oact, NULL);
+	return rc;
+}
+
+/*
+ * Collect the region badblocks that fall within the @size bytes at
+ * physical address @base, as byte ranges relative to @base.
+ */
+static int scan_badblocks(struct ndctl_region *region,
+		unsigned long long base, unsigned long long size,
+		struct scan_extent **known, unsigned int *nr)
+{
+	unsigned long long region_base = ndctl_region_get_resource(region);
+	unsigned long long start, end;
+	unsigned int alloc = 0;
+	struct badblock *bb;
+	int rc;
+
+	*known = NULL;
+	*nr = 0;
+	if (region_base == ULLONG_MAX || base == ULLONG_MAX)
+		return 0;
+
+	ndctl_region_badblock_foreach(region, bb) {
+		start = region_base + (bb->offset << 9);
+		end = start + ((unsigned long long) bb->len << 9);
+		start = max(start, base);
+		end = min(end, base + size);
+		if (start >= end)
+			continue;
+		rc = extent_add(known, nr, &alloc, start - base, end - start);
+		if (rc)
+			return rc;
+	}
+
+	*nr = extent_merge(*known, *nr);
+	return 0;
+}
+
+static struct json_object *scan_to_json(struct scan_ctx *sctx,
+		unsigned int threads,
+		unsigned long long elapsed, struct scan_extent *known,
+		unsigned int nr_known, unsigned long flags)
+{
+	unsigned long long known_bytes = 0, bad_bytes = 0, overlap = 0, ov;
+	struct json_object *jscan, *jerrs = NULL, *jerr, *jobj;
+	unsigned int i;
+
+	jscan = json_object_new_object();
+	if (!jscan)
+		return NULL;
+
+	for (i = 0; i < nr_known; i++)
+		known_bytes += known[i].len;
+
+	if (sctx->nr_bad)
+		jerrs = json_object_new_array();
+
+	for (i = 0; i < sctx->nr_bad; i++) {
+		struct scan_extent *e = &sctx->bad[i];
+
+		ov = extent_overlap(e, known, nr_known);
+		overlap += ov;
+		bad_bytes += e->len;
+		if (!jerrs)
+			continue;
+
+		jerr = json_object_new_object();
+		if (!jerr)
+			continue;
+		jobj = json_object_new_int64(e->offset >> 9);
+		if (jobj)
+			json_object_object_add(jerr, "offset", jobj);
+		jobj = json_object_new_int64(e->len >> 9);
+		if (jobj)
+			json_object_object_add(jerr, "length", jobj);
+		jobj = json_object_new_boolean(ov == e->len);
+		if (jobj)
+			json_object_object_add(jerr, "known", jobj);
+		json_object_array_add(jerrs, jerr);
+	}
+
+	jobj = json_object_new_string(sctx->io.devname);
+	if (jobj)
+		json_object_object_add(jscan, "dev", jobj);
+	jobj = json_object_new_string(sctx->io.path);
+	if (jobj)
+		json_object_object_add(jscan, "path", jobj);
+	jobj = util_json_object_size(sctx->io.size, flags);
+	if (jobj)
+		json_object_object_add(jscan, "size", jobj);
+	jobj = json_object_new_int(threads);
+	if (jobj)
+		json_object_object_add(jscan, "threads", jobj);
+	jobj = json_object_new_int64(elapsed);
+	if (jobj)
+		json_object_object_add(jscan, "elapsed_ns", jobj);
+	jobj = json_object_new_int64(elapsed
+			? sctx->io.size * 1000000000.0 / elapsed : 0);
+	if (jobj)
+		json_object_object_add(jscan, "bytes_per_sec", jobj);
+
+	/* counts are in 512 byte sectors, like the badblocks listings */
+	jobj = json_object_new_int64(known_bytes >> 9);
+	if (jobj)
+		json_object_object_add(jscan, "badblock_count", jobj);
+	jobj = json_object_new_int64(bad_bytes >> 9);
+	if (jobj)
+		json_object_object_add(jscan, "error_count", jobj);
+	jobj = json_object_new_int64((bad_bytes - overlap) >> 9);
+	if (jobj)
+		json_object_object_add(jscan, "unknown_count", jobj);
+	jobj = json_object_new_int64((known_bytes - overlap) >> 9);
+	if (jobj)
+		json_object_object_add(jscan, "stale_count", jobj);
+	if (jerrs)
+		json_object_object_add(jscan, "errors", jerrs);
+
+	return jscan;
+}
+
+static int scan_finish(struct scan_ctx *sctx, struct ndctl_region *region,
+		unsigned long long base, unsigned int threads,
+		unsigned long long elapsed, unsigned long flags,
+		struct json_object **jscan)
+{
+	struct scan_extent *known;
+	unsigned int nr_known;
+	int rc;
+
+	sctx->nr_bad = extent_merge(sctx->bad, sctx->nr_bad);
+	rc = scan_badblocks(region, base, sctx->io.size, &known, &nr_known);
+	if (rc == 0) {
+		*jscan = scan_to_json(sctx, threads, elapsed, known, nr_known,
+				flags);
+		if (!*jscan)
+			rc = -ENOMEM;
+	}
+	free(known);
+	return rc;
+}
+
+/*
+ * namespace_scan - read the entire capacity of a namespace to find
+ * media errors, and compare them with the badblocks of its region
+ * @dax: read through the device-dax mapping of an enabled devdax
+ *	 namespace, leaving it in service, rather than the raw namespace
+ * @jscan: the result as a json object, offsets relative to the start
+ *	   of the scanned device
+ *
+ * Without @dax the namespace is put in raw mode for the duration of
+ * the scan, and is re-enabled afterwards if it was enabled before.
+ */
+int namespace_scan(struct ndctl_namespace *ndns, unsigned int threads,
+		bool dax, bool force, bool progress, unsigned long flags,
+		struct json_object **jscan)
+{
+	struct scan_ctx sctx = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	};
+	unsigned long long base, elapsed = 0;
+	int rc;
+
+	if (dax)
+		rc = ns_io_open_dax(&sctx.io, ndns, false);
+	else
+		rc = ns_io_open_raw(&sctx.io, ndns, O_RDONLY, force,
+				"to scan it");
+	if (rc)
+		return rc;
+
+	if (dax)
+		base = ndctl_dax_get_resource(ndctl_namespace_get_dax(ndns));
+	else
+		base = ndctl_namespace_get_resource(ndns);
+
+	rc = scan_run(&sctx, threads, progress, &elapsed);
+	if (rc == 0)
+		rc = scan_finish(&sctx, ndctl_namespace_get_region(ndns), base,
+				threads, elapsed, flags, jscan);
+	if (rc)
+		error("%s: scan failed: %s\n", sctx.io.devname,
+				strerror(-rc));
+	ns_io_close(&sctx.io);
+	free(sctx.bad);
+	return rc;
+}
@@ -18,33 +18,20 @@
 #include <ccan/array_size/array_size.h>
 #include <ndctl.h>
 
-static void smart_threshold_to_json(struct ndctl_dimm *dimm,
+static void smart_threshold_to_json(struct util_smart_threshold *threshold,
 		struct json_object *jhealth)
 {
-	unsigned int alarm_control;
+	unsigned int alarm_control = threshold->alarm_control;
 	struct json_object *jobj;
-	struct ndctl_cmd *cmd;
-	int rc;
-
-	cmd = ndctl_dimm_cmd_new_smart_threshold(dimm);
-	if (!cmd)
-		return;
-
-	rc = ndctl_cmd_submit_xlat(cmd);
-	if (rc < 0)
-		goto out;
 
-	alarm_control = ndctl_cmd_smart_threshold_get_alarm_control(cmd);
 	if (alarm_control & ND_SMART_TEMP_TRIP) {
-		unsigned int temp;
 		double t;
 
 		jobj = json_object_new_boolean(true);
 		if (jobj)
 			json_object_object_add(jhealth,
 				"alarm_enabled_media_temperature", jobj);
-		temp = ndctl_cmd_smart_threshold_get_temperature(cmd);
-		t = ndctl_decode_smart_temperature(temp);
+		t = ndctl_decode_smart_temperature(threshold->temperature);
 		jobj = json_object_new_double(t);
 		if (jobj)
 			json_object_object_add(jhealth,
@@ -57,15 +44,13 @@ static void smart_threshold_to_json(struct ndctl_dimm *dimm,
 	}
 
 	if (alarm_control & ND_SMART_CTEMP_TRIP) {
-		unsigned int temp;
 		double t;
 
 		jobj = json_object_new_boolean(true);
 		if (jobj)
 			json_object_object_add(jhealth,
 				"alarm_enabled_ctrl_temperature", jobj);
-		temp = ndctl_cmd_smart_threshold_get_ctrl_temperature(cmd);
-		t = ndctl_decode_smart_temperature(temp);
+		t = ndctl_decode_smart_temperature(threshold->ctrl_temperature);
 		jobj = json_object_new_double(t);
 		if (jobj)
 			json_object_object_add(jhealth,
@@ -78,14 +63,11 @@ static void smart_threshold_to_json(struct ndctl_dimm *dimm,
 	}
 
 	if (alarm_control & ND_SMART_SPARE_TRIP) {
-		unsigned int spares;
-
 		jobj = json_object_new_boolean(true);
 		if (jobj)
 			json_object_object_add(jhealth,
 				"alarm_enabled_spares", jobj);
-		spares = ndctl_cmd_smart_threshold_get_spares(cmd);
-		jobj = json_object_new_int(spares);
+		jobj = json_object_new_int(threshold->spares);
 		if (jobj)
 			json_object_object_add(jhealth,
 				"spares_threshold", jobj);
@@ -95,34 +77,47 @@ static void smart_threshold_to_json(struct ndctl_dimm *dimm,
 			json_object_object_add(jhealth,
 				"alarm_enabled_spares", jobj);
 	}
+}
+
+/* false if the dimm does not report its alarm thresholds */
+static bool dimm_smart_threshold(struct ndctl_dimm *dimm,
+		struct util_smart_threshold *threshold)
+{
+	struct ndctl_cmd *cmd;
+	int rc;
 
- out:
+	cmd = ndctl_dimm_cmd_new_smart_threshold(dimm);
+	if (!cmd)
+		return false;
+
+	rc = ndctl_cmd_submit_xlat(cmd);
+	if (rc >= 0) {
+		threshold->alarm_control =
+			ndctl_cmd_smart_threshold_get_alarm_control(cmd);
+		threshold->temperature =
+			ndctl_cmd_smart_threshold_get_temperature(cmd);
+		threshold->ctrl_temperature =
+			ndctl_cmd_smart_threshold_get_ctrl_temperature(cmd);
+		threshold->spares = ndctl_cmd_smart_threshold_get_spares(cmd);
+	}
 	ndctl_cmd_unref(cmd);
+	return rc >= 0;
 }
 
-struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
+/*
+ * util_smart_to_json - decode a completed smart command
+ * @threshold: alarm thresholds to report along with the health, or NULL
+ */
+struct json_object *util_smart_to_json(struct ndctl_cmd *cmd,
+		struct util_smart_threshold *threshold)
 {
 	struct json_object *jhealth = json_object_new_object();
 	struct json_object *jobj;
-	struct ndctl_cmd *cmd;
 	unsigned int flags;
-	int rc;
 
 	if (!jhealth)
 		return NULL;
 
-	cmd = ndctl_dimm_cmd_new_smart(dimm);
-	if (!cmd)
-		goto err;
-
-	rc = ndctl_cmd_submit_xlat(cmd);
-	if (rc < 0) {
-		jobj = json_object_new_string("unknown");
-		if (jobj)
-			json_object_object_add(jhealth, "health_state", jobj);
-		goto out;
-	}
-
 	flags = ndctl_cmd_smart_get_flags(cmd);
 	if (flags & ND_SMART_HEALTH_VALID) {
 		unsigned int health = ndctl_cmd_smart_get_health(cmd);
@@ -185,7 +180,8 @@ struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
 			json_object_object_add(jhealth, "alarm_spares", jobj);
 	}
 
-	smart_threshold_to_json(dimm, jhealth);
+	if (threshold)
+		smart_threshold_to_json(threshold, jhealth);
 
 	if (flags & ND_SMART_USED_VALID) {
 		unsigned int life_used = ndctl_cmd_smart_get_life_used(cmd);
@@ -211,13 +207,33 @@ struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
 			json_object_object_add(jhealth, "shutdown_count", jobj);
 	}
 
-	ndctl_cmd_unref(cmd);
 	return jhealth;
- err:
-	json_object_put(jhealth);
-	jhealth = NULL;
- out:
-	if (cmd)
-		ndctl_cmd_unref(cmd);
+}
+
+struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
+{
+	struct util_smart_threshold threshold;
+	struct json_object *jhealth, *jobj;
+	struct ndctl_cmd *cmd;
+	int rc;
+
+	cmd = ndctl_dimm_cmd_new_smart(dimm);
+	if (!cmd)
+		return NULL;
+
+	rc = ndctl_cmd_submit_xlat(cmd);
+	if (rc < 0) {
+		jhealth = json_object_new_object();
+		jobj = json_object_new_string("unknown");
+		if (jhealth && jobj)
+			json_object_object_add(jhealth, "health_state", jobj);
+		else
+			json_object_put(jobj);
+	} else
+		jhealth = util_smart_to_json(cmd,
+				dimm_smart_threshold(dimm, &threshold)
+				? &threshold : NULL);
+
+	ndctl_cmd_unref(cmd);
 	return jhealth;
 }
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <util/size.h>
+#include <util/util.h>
+#include <ndctl/libndctl.h>
+#include <ccan/minmax/minmax.h>
+
+#include "namespace-io.h"
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#define ZERO_CHUNK SZ_1M
+
+/* zero with non-temporal stores so the cpu caches are left alone */
+static void zero_nt(char *dst, unsigned long len)
+{
+#if defined(__x86_64__)
+	__m128i zero = _mm_setzero_si128();
+	unsigned long i;
+
+	for (i = 0; i < len; i += sizeof(zero))
+		_mm_stream_si128((__m128i *) (dst + i), zero);
+	_mm_sfence();
+#else
+	memset(dst, 0, len);
+	msync(dst, len, MS_SYNC);
+#endif
+}
+
+/*
+ * Block devices are written with O_DIRECT, for pmem that copies with
+ * the kernel's cache bypassing memcpy_flushcache() and keeps the page
+ * cache out of the way.
+ */
+static void zero_worker(struct ns_io *io, unsigned int idx, unsigned int nr)
+{
+	unsigned long long slice, start, end, off, len;
+	void *buf = NULL;
+	ssize_t n;
+
+	/* whole chunks per worker, the last one takes the remainder */
+	slice = ALIGN(io->size / nr, ZERO_CHUNK);
+	start = min(io->size, slice * idx);
+	end = idx == nr - 1 ? io->size : min(io->size, slice * (idx + 1));
+
+	if (!io->addr) {
+		if (posix_memalign(&buf, SZ_4K, ZERO_CHUNK)) {
+			ns_io_set_err(io, -ENOMEM);
+			return;
+		}
+		memset(buf, 0, ZERO_CHUNK);
+	}
+
+	for (off = start; off < end; off += len) {
+		if (__atomic_load_n(&io->err, __ATOMIC_RELAXED))
+			break;
+		len = min(end - off, (unsigned long long) ZERO_CHUNK);
+		if (io->addr)
+			zero_nt(io->addr + off, len);
+		else {
+			n = pwrite(io->fd, buf, len, off);
+			if (n < 0 && errno == EINTR) {
+				len = 0;
+				continue;
+			}
+			if (n <= 0) {
+				ns_io_set_err(io, n < 0 ? -errno : -ENOSPC);
+				break;
+			}
+			len = n;
+		}
+		__atomic_add_fetch(&io->done, len, __ATOMIC_RELAXED);
+	}
+
+	free(buf);
+}
+
+static int zero_run(struct ns_io *io, unsigned int threads, bool progress)
+{
+	unsigned long long elapsed;
+	int rc;
+
+	rc = ns_io_run(io, zero_worker, threads, "zeroed", progress, &elapsed);
+	if (rc == 0)
+		ns_io_progress(io, "zeroed", elapsed, true);
+	return rc;
+}
+
+/*
+ * namespace_zero - zero the entire capacity of a namespace
+ * @dax: zero through the device-dax mapping of a devdax namespace,
+ *	 preserving its info block, rather than through the raw namespace
+ *
+ * Without @dax the namespace is put in raw mode so that the info block
+ * of any personality is wiped as well, and it comes back as a raw
+ * namespace if it was enabled before.
+ */
+int namespace_zero(struct ndctl_namespace *ndns, unsigned int threads,
+		bool dax, bool force, bool progress)
+{
+	struct ns_io io;
+	int rc;
+
+	if (dax) {
+		rc = ns_io_open_dax(&io, ndns, true);
+		if (rc)
+			return rc;
+		/* the device-dax instance is enabled, and likely in use */
+		if (!force) {
+			error("%s is active, specify --force for erasure\n",
+					io.devname);
+			ns_io_close(&io);
+			return -EBUSY;
+		}
+	} else {
+		rc = ns_io_open_raw(&io, ndns, O_WRONLY, force,
+				"for erasure");
+		if (rc)
+			return rc;
+	}
+
+	rc = zero_run(&io, threads, progress);
+	if (rc == 0 && !io.addr && fsync(io.fd) < 0)
+		rc = -errno;
+	if (rc)
+		error("%s: zeroing failed: %s\n", io.devname, strerror(-rc));
+	ns_io_close(&io);
+	return rc;
+}
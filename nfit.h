@@ -26,6 +26,15 @@ static inline void nfit_spa_uuid_pm(void *uuid)
 
 enum {
 	NFIT_TABLE_SPA = 0,
+	NFIT_TABLE_MEM = 1,
+	NFIT_TABLE_IDT = 2,
+	NFIT_TABLE_DCR = 4,
+	NFIT_TABLE_FLUSH = 7,
+};
+
+enum {
+	NFIT_SPA_PROXIMITY_VALID = 1 << 1,
+	NFIT_DCR_MFG_VALID = 1 << 0,
 };
 
 /**
@@ -62,4 +71,78 @@ struct nfit_spa {
 	uint64_t mem_attr;
 } __attribute__((packed));
 
+/**
+ * struct nfit_mem - NVDIMM to System Physical Address Range Mapping Table
+ */
+struct nfit_mem {
+	uint16_t type;
+	uint16_t length;
+	uint32_t device_handle;
+	uint16_t physical_id;
+	uint16_t region_id;
+	uint16_t spa_index;
+	uint16_t dcr_index;
+	uint64_t region_size;
+	uint64_t region_offset;
+	uint64_t region_dpa;
+	uint16_t idt_index;
+	uint16_t interleave_ways;
+	uint16_t flags;
+	uint16_t reserved;
+} __attribute__((packed));
+
+/**
+ * struct nfit_idt - Interleave description Table
+ */
+struct nfit_idt {
+	uint16_t type;
+	uint16_t length;
+	uint16_t interleave_index;
+	uint16_t reserved;
+	uint32_t line_count;
+	uint32_t line_size;
+	uint32_t line_offset[];
+} __attribute__((packed));
+
+/**
+ * struct nfit_dcr - NVDIMM Control Region Table
+ */
+struct nfit_dcr {
+	uint16_t type;
+	uint16_t length;
+	uint16_t dcr_index;
+	uint16_t vendor_id;
+	uint16_t device_id;
+	uint16_t revision_id;
+	uint16_t sub_vendor_id;
+	uint16_t sub_device_id;
+	uint16_t sub_revision_id;
+	uint8_t valid_fields;
+	uint8_t manufacturing_location;
+	uint16_t manufacturing_date;
+	uint8_t reserved[2];
+	uint32_t serial_number;
+	uint16_t code;
+	uint16_t windows;
+	uint64_t window_size;
+	uint64_t command_offset;
+	uint64_t command_size;
+	uint64_t status_offset;
+	uint64_t status_size;
+	uint16_t flags;
+	uint8_t reserved1[6];
+} __attribute__((packed));
+
+/**
+ * struct nfit_flush - Flush Hint Address Structure
+ */
+struct nfit_flush {
+	uint16_t type;
+	uint16_t length;
+	uint32_t device_handle;
+	uint16_t hint_count;
+	uint8_t reserved[6];
+	uint64_t hint_address[];
+} __attribute__((packed));
+
 #endif /* __NFIT_H__ */
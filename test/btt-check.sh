@@ -135,6 +135,23 @@ test_bad_info()
 	post_repair_test
 }
 
+test_image()
+{
+	echo "=== ${FUNCNAME[0]} ==="
+	set_raw
+	image="$(mktemp /tmp/btt-check.XXXXXX)"
+	dd if=/dev/$raw_bdev of=$image bs=$bs > /dev/null 2>&1
+	unset_raw
+	$NDCTL check-namespace --infile $image
+	seek="$((raw_size/bs - 1))"
+	echo "wiping info2 block of the image (offset = $seek blocks)"
+	dd if=/dev/zero of=$image bs=$bs count=1 seek=$seek conv=notrunc
+	$NDCTL check-namespace --infile $image 2>&1 | grep "info2 needs to be restored"
+	$NDCTL check-namespace --infile $image --repair
+	! $NDCTL check-namespace --infile $image 2>&1 | grep "needs to be restored"
+	rm -f $image
+}
+
 test_bitmap()
 {
 	echo "=== ${FUNCNAME[0]} ==="
@@ -162,6 +179,7 @@ do_tests()
 	test_force
 	test_bad_info2
 	test_bad_info
+	test_image
 	test_bitmap
 }
 
@@ -0,0 +1,53 @@
+#!/bin/bash -E
+# SPDX-License-Identifier: GPL-2.0
+#
+# Smoke test 'daxctl bench' against a regular file, no persistent
+# memory required. This checks that every test runs and reports sane
+# numbers, not the performance of the file.
+
+rc=77
+
+. ./common
+
+check_prereq "jq"
+
+set -e
+
+root=$(mktemp -d /tmp/daxctl-bench.XXXXXX)
+file="$root/bench.img"
+
+cleanup()
+{
+	rm -rf "$root"
+}
+
+trap 'err $LINENO cleanup' ERR
+
+truncate -s 8M "$file"
+
+rc=1
+
+json=$($DAXCTL bench "$file" --force --threads=2 --duration=1 \
+	--tests=seq-read,seq-write,rand-read,rand-write,latency,fault)
+
+[ "$(echo "$json" | jq '.threads')" -eq 2 ]
+
+# every bandwidth test moved data
+for test in seq-read seq-write rand-read rand-write; do
+	bytes=$(echo "$json" | jq --arg t $test \
+		'[.results[] | select(.test == $t)][0].bytes_per_sec')
+	[ "$bytes" -gt 0 ]
+done
+
+loads=$(echo "$json" | jq '[.results[] | select(.test == "latency")][0].loads')
+[ "$loads" -gt 0 ]
+
+# an 8M file is tried with 4K and 2M pages, with and without MAP_POPULATE,
+# and each run touches every page of the mapping once
+count=$(echo "$json" | jq '[.results[] | select(.test == "fault")] | length')
+[ "$count" -ge 2 ]
+echo "$json" | jq -e '[.results[] | select(.test == "fault")]
+	| all(.touches * .page_size == 8388608 and .touch_ns > 0)' > /dev/null
+
+cleanup
+exit 0
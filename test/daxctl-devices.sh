@@ -83,9 +83,30 @@ daxctl_test()
 	[[ $(daxctl_get_mode "$daxdev") == "devdax" ]]
 }
 
+# carve and release a 2M aligned device when the region has room for it,
+# static (namespace backed) dax regions can not be resized
+daxctl_test_create()
+{
+	local daxdev region avail newdev
+
+	daxdev=$(daxctl_get_dev "$testdev")
+	region=$("$DAXCTL" list -R -d "$daxdev" | jq -er '.[0].id')
+	avail=$("$DAXCTL" list -R -r "$region" | jq -er '.[0].available_size')
+	if (( avail < (64 << 20) )); then
+		return 0
+	fi
+
+	newdev=$("$DAXCTL" create-device -r "$region" -s 64M -a 2M | \
+		jq -er '.[0].chardev')
+	[[ $("$DAXCTL" list -d "$newdev" | jq -er '.[0].size') == $((64 << 20)) ]]
+	[[ $("$DAXCTL" list -d "$newdev" | jq -er '.[0].align') == $((2 << 20)) ]]
+	"$DAXCTL" destroy-device -f "$newdev"
+}
+
 find_testdev
 setup_dev
 rc=1
 daxctl_test
+daxctl_test_create
 reset_dev
 exit 0
@@ -0,0 +1,50 @@
+#!/bin/bash -E
+# SPDX-License-Identifier: GPL-2.0
+#
+# Drive the dimm command paths against the libndctl command emulator
+# and a synthetic sysfs topology, no nfit_test or NVDIMMs required.
+
+rc=77
+
+. ./common
+
+check_prereq "jq"
+
+set -e
+
+root=$(mktemp -d /tmp/emulate.XXXXXX)
+image="$root/fw.img"
+
+cleanup()
+{
+	rm -rf "$root"
+}
+
+trap 'err $LINENO cleanup' ERR
+
+./sysfs-topology -b 1 -d 4 -r 1 -n 2 -e 2 "$root" > /dev/null
+
+export NDCTL_SYSFS_ROOT="$root"
+export NDCTL_EMULATE="default=0"
+
+rc=1
+
+# every dimm reports the emulated smart payload
+count=$($NDCTL list -DH | jq '[.[] | select(.health.health_state == "ok")] | length')
+[ "$count" -eq 4 ]
+
+# emulated state lives as long as the process, so check the injected
+# value in the health that inject-smart reports on completion
+temp=$($NDCTL inject-smart nmem0 -m 60 | jq '.[].health.temperature_celsius')
+[ "$temp" = "60" ] || [ "$temp" = "60.0" ]
+
+# start, send, finish, and query a firmware update
+dd if=/dev/urandom of="$image" bs=4k count=16 2> /dev/null
+$NDCTL update-firmware -f "$image" nmem1 2>&1 | grep -q "updated successfully"
+
+# a scrub limited to one namespace reports only the errors seeded in it
+count=$($NDCTL start-scrub --namespace=namespace0.0 | jq '.[0].record_count')
+[ "$count" -eq 2 ]
+
+cleanup
+exit 0
@@ -0,0 +1,51 @@
+#!/bin/bash -Ex
+# SPDX-License-Identifier: GPL-2.0
+#
+# Disable and enable fsdax namespaces in several regions at once with
+# --jobs, and check that every one of them comes back enabled with its
+# pfn personality, which the kernel registers asynchronously.
+
+rc=77
+
+. ./common
+
+check_prereq "jq"
+
+set -e
+trap 'err $LINENO' ERR
+
+# setup (reset nfit_test dimms)
+modprobe nfit_test
+$NDCTL disable-region -b $NFIT_TEST_BUS0 all
+$NDCTL zero-labels -b $NFIT_TEST_BUS0 all
+$NDCTL enable-region -b $NFIT_TEST_BUS0 all
+
+rc=1
+
+list()
+{
+	$NDCTL list -b $NFIT_TEST_BUS0 "$@" | \
+		jq -c 'if type == "array" then .[] else . end'
+}
+
+# one fsdax namespace in every pmem region
+created=0
+for region in $(list -R -t pmem | jq -r '.dev'); do
+	$NDCTL create-namespace -b $NFIT_TEST_BUS0 -r $region -m fsdax
+	created=$((created + 1))
+done
+[ $created -gt 0 ]
+
+for i in 1 2 3; do
+	$NDCTL disable-namespace -b $NFIT_TEST_BUS0 --jobs=4 all
+	count=$(list -N | grep -c '"blockdev"' || true)
+	[ $count -eq 0 ]
+
+	$NDCTL enable-namespace -b $NFIT_TEST_BUS0 --jobs=4 all
+	count=$(list -N | jq -s \
+		'[.[] | select(.mode == "fsdax" and .blockdev)] | length')
+	[ $count -eq $created ]
+done
+
+_cleanup
+exit 0
@@ -2216,6 +2216,7 @@ static int check_smart(struct ndctl_bus *bus, struct ndctl_dimm *dimm,
 		.vendor_size = 0,
 	};
 	struct ndctl_cmd *cmd = ndctl_dimm_cmd_new_smart(dimm);
+	struct ndctl_cmd_stats *stats;
 	int rc;
 
 	if (!cmd) {
@@ -2244,6 +2245,39 @@ static int check_smart(struct ndctl_bus *bus, struct ndctl_dimm *dimm,
 	if (ndctl_cmd_smart_get_flags(cmd) & ND_SMART_SHUTDOWN_COUNT_VALID)
 		__check_smart(dimm, cmd, shutdown_count, -1);
 
+	/* a reset command must be resubmittable with identical results */
+	rc = ndctl_cmd_reset(cmd);
+	if (rc < 0 || ndctl_cmd_get_status(cmd) != 1
+			|| ndctl_cmd_smart_get_flags(cmd)) {
+		fprintf(stderr, "%s: dimm: %#x failed to reset cmd: %d\n",
+			__func__, ndctl_dimm_get_handle(dimm), rc);
+		ndctl_cmd_unref(cmd);
+		return -ENXIO;
+	}
+
+	rc = ndctl_cmd_submit(cmd);
+	if (rc < 0) {
+		fprintf(stderr, "%s: dimm: %#x failed to resubmit cmd: %d\n",
+			__func__, ndctl_dimm_get_handle(dimm), rc);
+		ndctl_cmd_unref(cmd);
+		return rc;
+	}
+	__check_smart(dimm, cmd, flags, ~(ND_SMART_CTEMP_VALID
+			| ND_SMART_SHUTDOWN_COUNT_VALID));
+	__check_smart(dimm, cmd, health, -1);
+	__check_smart(dimm, cmd, temperature, -1);
+
+	/* both submissions are expected to be accounted */
+	ndctl_dimm_cmd_stats_foreach(dimm, stats)
+		if (ndctl_cmd_stats_get_count(stats) >= 2)
+			break;
+	if (!stats) {
+		fprintf(stderr, "%s: dimm: %#x missing command stats\n",
+			__func__, ndctl_dimm_get_handle(dimm));
+		ndctl_cmd_unref(cmd);
+		return -ENXIO;
+	}
+
 	check->cmd = cmd;
 	return 0;
 }
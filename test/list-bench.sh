@@ -0,0 +1,83 @@
+#!/bin/bash -E
+# SPDX-License-Identifier: GPL-2.0
+#
+# Time 'ndctl list' against a synthetic sysfs topology generated by
+# ./sysfs-topology, no nfit_test or persistent memory required. The
+# topology and the number of iterations can be scaled with:
+#   BENCH_BUSES, BENCH_DIMMS, BENCH_REGIONS, BENCH_NAMESPACES,
+#   BENCH_BADBLOCKS, BENCH_ITERATIONS
+# Each variant emits one line of JSON with the average wall clock time.
+
+rc=77
+
+. ./common
+
+check_prereq "jq"
+
+set -e
+
+buses=${BENCH_BUSES:-4}
+dimms=${BENCH_DIMMS:-8}
+regions=${BENCH_REGIONS:-4}
+namespaces=${BENCH_NAMESPACES:-16}
+badblocks=${BENCH_BADBLOCKS:-4}
+iterations=${BENCH_ITERATIONS:-5}
+
+root=$(mktemp -d /tmp/list-bench.XXXXXX)
+
+cleanup()
+{
+	rm -rf "$root"
+}
+
+trap 'err $LINENO cleanup' ERR
+
+./sysfs-topology -b $buses -d $dimms -r $regions -n $namespaces \
+	-e $badblocks "$root" > /dev/null
+
+export NDCTL_SYSFS_ROOT="$root"
+export DAXCTL_SYSFS_ROOT="$root"
+
+rc=1
+
+count()
+{
+	$NDCTL list "$@" | jq 'if type == "array" then length else 1 end'
+}
+
+# sanity check that the library enumerated the whole topology
+[ "$(count -B)" -eq $buses ]
+[ "$(count -D)" -eq $((buses * dimms)) ]
+[ "$(count -R)" -eq $((buses * regions)) ]
+[ "$(count -N)" -eq $((buses * regions * namespaces)) ]
+[ "$(count -Ni)" -eq $((buses * regions * (namespaces + 1))) ]
+[ "$(count -b nfit_synth.0 -N)" -eq $((regions * namespaces)) ]
+[ "$(count -r region0 -N)" -eq $namespaces ]
+
+bench()
+{
+	local start end i
+
+	start=$(date +%s%N)
+	for i in $(seq $iterations); do
+		$NDCTL list "$@" > /dev/null
+	done
+	end=$(date +%s%N)
+	printf '{"args":"%s","iterations":%d,"avg_ms":%d.%03d}\n' "$*" \
+		$iterations $(((end - start) / iterations / 1000000)) \
+		$(((end - start) / iterations / 1000 % 1000))
+}
+
+bench -B
+bench -D
+bench -R
+bench -N
+bench -BDRN
+bench -Ni
+bench -NM
+bench -RM
+bench -b nfit_synth.0 -N
+bench -r region0 -N
+
+cleanup
+exit 0
@@ -0,0 +1,381 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Materialize a synthetic libnvdimm sysfs hierarchy for hardware-free
+ * enumeration testing and benchmarking. Point NDCTL_SYSFS_ROOT at the
+ * generated directory to have libndctl enumerate it instead of /sys.
+ */
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <uuid/uuid.h>
+#include <ndctl.h>
+
+#define NS_SIZE (1ULL << 30)
+#define BUS_MAJOR 250
+#define DIMM_MAJOR 249
+
+static struct {
+	int buses;
+	int dimms;
+	int regions;
+	int namespaces;
+	int badblocks;
+} topo = {
+	.buses = 1,
+	.dimms = 4,
+	.regions = 2,
+	.namespaces = 2,
+	.badblocks = 0,
+};
+
+static char root[PATH_MAX];
+
+static void __attribute__((format(printf, 1, 2))) die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	exit(EXIT_FAILURE);
+}
+
+/* every path is built under @root, fail rather than truncate one */
+static void __attribute__((format(printf, 3, 4))) path_printf(char *buf,
+		size_t len, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = vsnprintf(buf, len, fmt, ap);
+	va_end(ap);
+	if (rc < 0 || (size_t) rc >= len)
+		die("path too long: %s...\n", buf);
+}
+
+static void mkdir_p(const char *path)
+{
+	char buf[PATH_MAX], *p;
+
+	path_printf(buf, sizeof(buf), "%s", path);
+	for (p = buf + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(buf, 0755) < 0 && errno != EEXIST)
+			die("mkdir %s: %s\n", buf, strerror(errno));
+		*p = '/';
+	}
+	if (mkdir(buf, 0755) < 0 && errno != EEXIST)
+		die("mkdir %s: %s\n", buf, strerror(errno));
+}
+
+static void __attribute__((format(printf, 3, 4))) attr(const char *dir,
+		const char *name, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	va_list ap;
+	FILE *f;
+
+	path_printf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f)
+		die("create %s: %s\n", path, strerror(errno));
+	va_start(ap, fmt);
+	vfprintf(f, fmt, ap);
+	va_end(ap);
+	fclose(f);
+}
+
+static void link_to(const char *target, const char *dir, const char *name)
+{
+	char path[PATH_MAX];
+
+	path_printf(path, sizeof(path), "%s/%s", dir, name);
+	if (symlink(target, path) < 0)
+		die("symlink %s: %s\n", path, strerror(errno));
+}
+
+static void bind_driver(const char *dir, const char *driver)
+{
+	char path[PATH_MAX];
+
+	path_printf(path, sizeof(path), "%s/bus/nd/drivers/%s", root, driver);
+	link_to(path, dir, "driver");
+}
+
+static void add_badblocks(const char *dir, unsigned long long start,
+		unsigned long long sectors, FILE *region_bb)
+{
+	char path[PATH_MAX];
+	int i;
+	FILE *f;
+
+	path_printf(path, sizeof(path), "%s/badblocks", dir);
+	f = fopen(path, "w");
+	if (!f)
+		die("create %s: %s\n", path, strerror(errno));
+	for (i = 0; i < topo.badblocks; i++) {
+		unsigned long long off = sectors / (topo.badblocks + 1) * (i + 1);
+
+		fprintf(f, "%llu 8\n", off);
+		if (region_bb)
+			fprintf(region_bb, "%llu 8\n", start + off);
+	}
+	fclose(f);
+}
+
+static void add_namespace(const char *region_dir, int region_id, int id,
+		unsigned long long resource, unsigned long long size,
+		FILE *region_bb, unsigned long long region_off)
+{
+	char dir[PATH_MAX], path[PATH_MAX], bdev[32], uuid_str[40];
+	uuid_t uuid;
+
+	path_printf(dir, sizeof(dir), "%s/namespace%d.%d", region_dir, region_id,
+			id);
+	mkdir_p(dir);
+
+	attr(dir, "nstype", "%d\n", ND_DEVICE_NAMESPACE_PMEM);
+	attr(dir, "size", "%llu\n", size);
+	attr(dir, "resource", "%#llx\n", size ? resource : 0);
+	attr(dir, "force_raw", "0\n");
+	attr(dir, "numa_node", "%d\n", region_id % 2);
+	attr(dir, "target_node", "%d\n", region_id % 2);
+	attr(dir, "holder_class", "\n");
+	attr(dir, "holder", "\n");
+	attr(dir, "sector_size", "[512] 4096 \n");
+	attr(dir, "alt_name", "\n");
+	attr(dir, "modalias", "nd:t%d\n", ND_DEVICE_NAMESPACE_PMEM);
+	attr(dir, "mode", "raw\n");
+
+	/* the zero-sized namespace is the idle seed of the region */
+	if (!size) {
+		attr(dir, "uuid", "\n");
+		return;
+	}
+
+	uuid_generate(uuid);
+	uuid_unparse(uuid, uuid_str);
+	attr(dir, "uuid", "%s\n", uuid_str);
+	bind_driver(dir, "nd_pmem");
+
+	path_printf(bdev, sizeof(bdev), "pmem%d.%d", region_id, id);
+	path_printf(path, sizeof(path), "%s/block/%s", dir, bdev);
+	mkdir_p(path);
+	attr(path, "size", "%llu\n", size / 512);
+	add_badblocks(path, region_off / 512, size / 512, region_bb);
+
+	path_printf(dir, sizeof(dir), "%s/block", root);
+	link_to(path, dir, bdev);
+}
+
+static void add_region(const char *bus_dir, int id, int first_dimm,
+		unsigned long long resource)
+{
+	unsigned long long size = NS_SIZE * (topo.namespaces + 1);
+	unsigned long long per_dimm = size / topo.dimms;
+	char dir[PATH_MAX], path[PATH_MAX];
+	FILE *region_bb;
+	int i;
+
+	path_printf(dir, sizeof(dir), "%s/region%d", bus_dir, id);
+	mkdir_p(dir);
+
+	attr(dir, "size", "%llu\n", size);
+	attr(dir, "resource", "%#llx\n", resource);
+	attr(dir, "mappings", "%d\n", topo.dimms);
+	for (i = 0; i < topo.dimms; i++) {
+		char name[32];
+
+		path_printf(name, sizeof(name), "mapping%d", i);
+		attr(dir, name, "nmem%d,%llu,%llu,%d\n", first_dimm + i,
+				per_dimm * (id % topo.regions), per_dimm, i);
+	}
+	path_printf(path, sizeof(path), "%s/nfit", dir);
+	mkdir_p(path);
+	attr(path, "range_index", "%d\n", id + 1);
+	attr(dir, "read_only", "0\n");
+	attr(dir, "modalias", "nd:t%d\n", ND_DEVICE_REGION_PMEM);
+	attr(dir, "numa_node", "%d\n", id % 2);
+	attr(dir, "target_node", "%d\n", id % 2);
+	attr(dir, "align", "%#x\n", 16 << 20);
+	attr(dir, "nstype", "%d\n", ND_DEVICE_NAMESPACE_PMEM);
+	attr(dir, "set_cookie", "%#llx\n", 0x1000ULL + id);
+	attr(dir, "persistence_domain", "memory_controller\n");
+	attr(dir, "available_size", "%llu\n", NS_SIZE);
+	attr(dir, "max_available_extent", "%llu\n", NS_SIZE);
+	attr(dir, "namespace_seed", "namespace%d.%d\n", id, topo.namespaces);
+	attr(dir, "btt_seed", "\n");
+	attr(dir, "pfn_seed", "\n");
+	attr(dir, "dax_seed", "\n");
+	attr(dir, "init_namespaces", "%d/%d\n", topo.namespaces,
+			topo.namespaces);
+	bind_driver(dir, "nd_region");
+
+	path_printf(path, sizeof(path), "%s/badblocks", dir);
+	region_bb = fopen(path, "w");
+	if (!region_bb)
+		die("create %s: %s\n", path, strerror(errno));
+	for (i = 0; i < topo.namespaces; i++)
+		add_namespace(dir, id, i, resource + NS_SIZE * i, NS_SIZE,
+				region_bb, NS_SIZE * i);
+	add_namespace(dir, id, topo.namespaces, 0, 0, NULL, 0);
+	fclose(region_bb);
+}
+
+static void add_dimm(const char *bus_dir, int id)
+{
+	char dir[PATH_MAX], path[PATH_MAX];
+
+	path_printf(dir, sizeof(dir), "%s/nmem%d", bus_dir, id);
+	mkdir_p(dir);
+
+	attr(dir, "dev", "%d:%d\n", DIMM_MAJOR, id);
+	attr(dir, "commands",
+		"smart smart_thresh get_size get_data set_data cmd_call \n");
+	attr(dir, "modalias", "nd:t%d\n", ND_DEVICE_DIMM);
+	attr(dir, "flags", "\n");
+	attr(dir, "state", "idle\n");
+	attr(dir, "security", "disabled\n");
+	bind_driver(dir, "nvdimm");
+
+	path_printf(path, sizeof(path), "%s/nfit", dir);
+	mkdir_p(path);
+	attr(path, "handle", "%#x\n", id);
+	attr(path, "phys_id", "%#x\n", id);
+	attr(path, "serial", "%#x\n", 0x1000 + id);
+	attr(path, "vendor", "0x8086\n");
+	attr(path, "device", "0x1\n");
+	attr(path, "rev_id", "0x1\n");
+	attr(path, "id", "8086-01-0000-%08x\n", 0x1000 + id);
+	attr(path, "family", "0\n");
+	/* smart, thresholds, firmware update and smart injection */
+	attr(path, "dsm_mask", "%#x\n", 0x7f3fe);
+	attr(path, "flags", "\n");
+	attr(path, "dirty_shutdown", "0\n");
+}
+
+static void add_bus(int id, int *dimm_id, int *region_id,
+		unsigned long long *resource)
+{
+	char dir[PATH_MAX], ctl[PATH_MAX], path[PATH_MAX];
+	int i, first_dimm = *dimm_id;
+
+	path_printf(dir, sizeof(dir), "%s/devices/platform/nfit_synth.%d/ndbus%d",
+			root, id, id);
+	mkdir_p(dir);
+
+	attr(dir, "commands", "ars_cap ars_start ars_status clear_error \n");
+	attr(dir, "provider", "nfit_synth.%d\n", id);
+	attr(dir, "wait_probe", "0\n");
+	path_printf(path, sizeof(path), "%s/nfit", dir);
+	mkdir_p(path);
+	attr(path, "revision", "1\n");
+	attr(path, "dsm_mask", "0x3fe\n");
+	attr(path, "scrub", "0\n");
+
+	path_printf(ctl, sizeof(ctl), "%s/ndctl%d", dir, id);
+	mkdir_p(ctl);
+	attr(ctl, "dev", "%d:%d\n", BUS_MAJOR, id);
+	link_to(dir, ctl, "device");
+
+	path_printf(path, sizeof(path), "%s/class/nd", root);
+	path_printf(dir, sizeof(dir), "ndctl%d", id);
+	link_to(ctl, path, dir);
+	path_printf(path, sizeof(path), "%s/dev/char", root);
+	path_printf(dir, sizeof(dir), "%d:%d", BUS_MAJOR, id);
+	link_to(ctl, path, dir);
+
+	path_printf(dir, sizeof(dir), "%s/devices/platform/nfit_synth.%d/ndbus%d",
+			root, id, id);
+	for (i = 0; i < topo.dimms; i++)
+		add_dimm(dir, (*dimm_id)++);
+	for (i = 0; i < topo.regions; i++) {
+		add_region(dir, *region_id, first_dimm, *resource);
+		*resource += NS_SIZE * (topo.namespaces + 1);
+		(*region_id)++;
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-b buses] [-d dimms-per-bus] "
+			"[-r regions-per-bus] [-n namespaces-per-region] "
+			"[-e badblocks-per-namespace] <dir>\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long resource = 0x100000000ULL;
+	int opt, i, dimm_id = 0, region_id = 0;
+	const char *drivers[] = { "nd_bus", "nvdimm", "nd_region", "nd_pmem" };
+	char path[PATH_MAX];
+
+	while ((opt = getopt(argc, argv, "b:d:r:n:e:")) != -1) {
+		switch (opt) {
+		case 'b':
+			topo.buses = atoi(optarg);
+			break;
+		case 'd':
+			topo.dimms = atoi(optarg);
+			break;
+		case 'r':
+			topo.regions = atoi(optarg);
+			break;
+		case 'n':
+			topo.namespaces = atoi(optarg);
+			break;
+		case 'e':
+			topo.badblocks = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind + 1 != argc || topo.buses < 1 || topo.dimms < 1
+			|| topo.regions < 0 || topo.namespaces < 0
+			|| topo.badblocks < 0)
+		usage(argv[0]);
+
+	mkdir_p(argv[optind]);
+	if (!realpath(argv[optind], root))
+		die("%s: %s\n", argv[optind], strerror(errno));
+
+	path_printf(path, sizeof(path), "%s/class/nd", root);
+	if (access(path, F_OK) == 0)
+		die("%s: already populated\n", root);
+	mkdir_p(path);
+
+	for (i = 0; i < (int) (sizeof(drivers) / sizeof(drivers[0])); i++) {
+		path_printf(path, sizeof(path), "%s/bus/nd/drivers/%s", root,
+				drivers[i]);
+		mkdir_p(path);
+	}
+	path_printf(path, sizeof(path), "%s/dev/char", root);
+	mkdir_p(path);
+	path_printf(path, sizeof(path), "%s/block", root);
+	mkdir_p(path);
+
+	/* regions and namespaces alternate between numa nodes 0 and 1 */
+	for (i = 0; i < 2; i++) {
+		path_printf(path, sizeof(path), "%s/devices/system/node/node%d",
+				root, i);
+		mkdir_p(path);
+		attr(path, "distance", "%d %d\n", i ? 21 : 10, i ? 10 : 21);
+	}
+
+	for (i = 0; i < topo.buses; i++)
+		add_bus(i, &dimm_id, &region_id, &resource);
+
+	printf("%s\n", root);
+	return 0;
+}
@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NDCTL_CLOCK_H_
+#define _NDCTL_CLOCK_H_
+#include <time.h>
+
+/* monotonic time in nanoseconds, for measuring intervals */
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* _NDCTL_CLOCK_H_ */
@@ -412,9 +412,12 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 	}
 
 	if (param->numa_node && strcmp(param->numa_node, "all") != 0) {
+		char path[PATH_MAX];
 		struct stat st;
 
-		if (stat("/sys/devices/system/node", &st) != 0) {
+		snprintf(path, sizeof(path), "%s/devices/system/node",
+				ndctl_get_sysfs_root(ctx));
+		if (stat(path, &st) != 0) {
 			error("This system does not support NUMA");
 			return -EINVAL;
 		}
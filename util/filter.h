@@ -53,6 +53,7 @@ struct list_filter_arg {
 	struct json_object *jbuses;
 	struct json_object *jregion;
 	struct json_object *jbus;
+	struct util_json_stream *stream;
 	unsigned long flags;
 };
 
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <util/jobs.h>
+
+/*
+ * The library contexts are not thread safe, so independent jobs are run
+ * in forked children that report back over a pipe. A child exits with
+ * the negated errno of its result.
+ */
+static int job_start(struct util_job *job)
+{
+	int fds[2], rc;
+	FILE *f_out;
+
+	job->rc = 0;
+	job->out = NULL;
+	job->out_len = 0;
+	job->fd = -1;
+
+	if (pipe2(fds, O_CLOEXEC) < 0)
+		return -errno;
+
+	job->pid = fork();
+	if (job->pid < 0) {
+		rc = -errno;
+		close(fds[0]);
+		close(fds[1]);
+		return rc;
+	}
+
+	if (job->pid == 0) {
+		close(fds[0]);
+		f_out = fdopen(fds[1], "w");
+		if (!f_out)
+			_exit(ENOMEM);
+		rc = job->run(job->arg, f_out);
+		fclose(f_out);
+		fflush(stderr);
+		_exit(rc < 0 ? (-rc & 0xff) : 0);
+	}
+
+	close(fds[1]);
+	job->fd = fds[0];
+	return 0;
+}
+
+/* returns 1 while the job still has output pending */
+static int job_read(struct util_job *job)
+{
+	char buf[4096], *out;
+	int status;
+	ssize_t n;
+
+	n = read(job->fd, buf, sizeof(buf));
+	if (n < 0 && errno == EINTR)
+		return 1;
+	if (n > 0) {
+		out = realloc(job->out, job->out_len + n + 1);
+		if (!out) {
+			job->rc = -ENOMEM;
+		} else {
+			memcpy(out + job->out_len, buf, n);
+			job->out = out;
+			job->out_len += n;
+			job->out[job->out_len] = 0;
+		}
+		return 1;
+	}
+
+	close(job->fd);
+	job->fd = -1;
+	while (waitpid(job->pid, &status, 0) < 0)
+		if (errno != EINTR) {
+			status = -1;
+			break;
+		}
+
+	if (status < 0 || !WIFEXITED(status))
+		job->rc = -EINTR;
+	else if (WEXITSTATUS(status))
+		job->rc = -WEXITSTATUS(status);
+	return 0;
+}
+
+/*
+ * util_jobs_run - run @jobs with at most @max_jobs in flight
+ *
+ * Jobs are started in array order. Returns 0 once every job has
+ * completed, the per-job result is in ->rc.
+ */
+int util_jobs_run(struct util_job *jobs, int num_jobs, int max_jobs)
+{
+	struct util_job **active;
+	struct pollfd *pfds;
+	int next = 0, num_active = 0, i, rc = 0;
+
+	if (max_jobs < 1)
+		max_jobs = 1;
+
+	active = calloc(max_jobs, sizeof(*active));
+	pfds = calloc(max_jobs, sizeof(*pfds));
+	if (!active || !pfds) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	/* don't let children inherit and replay buffered output */
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next < num_jobs || num_active) {
+		while (num_active < max_jobs && next < num_jobs) {
+			struct util_job *job = &jobs[next++];
+
+			job->rc = job_start(job);
+			if (job->rc == 0)
+				active[num_active++] = job;
+		}
+
+		for (i = 0; i < num_active; i++) {
+			pfds[i].fd = active[i]->fd;
+			pfds[i].events = POLLIN;
+			pfds[i].revents = 0;
+		}
+
+		if (poll(pfds, num_active, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			break;
+		}
+
+		for (i = num_active - 1; i >= 0; i--) {
+			if (!pfds[i].revents)
+				continue;
+			if (job_read(active[i]))
+				continue;
+			active[i] = active[--num_active];
+		}
+	}
+
+	/* only reached with jobs in flight on a poll() failure */
+	for (i = 0; i < num_active; i++)
+		while (job_read(active[i]))
+			;
+out:
+	free(active);
+	free(pfds);
+	return rc;
+}
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NDCTL_JOBS_H_
+#define _NDCTL_JOBS_H_
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * struct util_job - one unit of work for util_jobs_run()
+ * @run: executed in a child process, anything written to @f_out is
+ *	 collected in @out; returns 0 or -errno
+ * @rc: result of @run once the job has completed
+ * @out: NUL terminated output of @run, free() when done
+ */
+struct util_job {
+	int (*run)(void *arg, FILE *f_out);
+	void *arg;
+	int rc;
+	char *out;
+	size_t out_len;
+	pid_t pid;
+	int fd;
+};
+
+int util_jobs_run(struct util_job *jobs, int num_jobs, int max_jobs);
+#endif /* _NDCTL_JOBS_H_ */
@@ -10,8 +10,10 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
  * General Public License for more details.
  */
+#include <errno.h>
 #include <limits.h>
 #include <string.h>
+#include <util/util.h>
 #include <util/json.h>
 #include <util/filter.h>
 #include <uuid/uuid.h>
@@ -122,6 +124,243 @@ void util_display_json_array(FILE *f_out, struct json_object *jarray,
 	json_object_put(jarray);
 }
 
+void util_json_stream_init(struct util_json_stream *stream, FILE *f_out,
+		unsigned long flags, enum util_json_stream_format format)
+{
+	*stream = (struct util_json_stream) {
+		.f_out = f_out,
+		.flags = flags,
+		.format = format,
+	};
+}
+
+static void util_csv_print_len(FILE *f_out, const char *str, size_t len)
+{
+	size_t i;
+
+	if (strcspn(str, ",\"\r\n") >= len) {
+		fwrite(str, 1, len, f_out);
+		return;
+	}
+
+	fputc('"', f_out);
+	for (i = 0; i < len; i++) {
+		if (str[i] == '"')
+			fputc('"', f_out);
+		fputc(str[i], f_out);
+	}
+	fputc('"', f_out);
+}
+
+static void util_csv_print(FILE *f_out, const char *str)
+{
+	util_csv_print_len(f_out, str, strlen(str));
+}
+
+static void util_csv_header(FILE *f_out, struct json_object *jobj)
+{
+	int i = 0;
+	json_object_object_foreach(jobj, key, val) {
+		(void) val;
+		if (i++)
+			fputc(',', f_out);
+		util_csv_print(f_out, key);
+	}
+	fputc('\n', f_out);
+}
+
+static void util_csv_row(FILE *f_out, struct json_object *jobj)
+{
+	const char *str;
+	size_t len;
+	int i = 0;
+
+	json_object_object_foreach(jobj, key, val) {
+		(void) key;
+		if (i++)
+			fputc(',', f_out);
+		if (!val)
+			continue;
+		if (json_object_is_type(val, json_type_string)) {
+			util_csv_print(f_out, json_object_get_string(val));
+			continue;
+		}
+
+		/*
+		 * The --human serializers (display_size(), display_hex())
+		 * render numbers as a quoted json string, emit the value
+		 * without the quotes.
+		 */
+		str = json_object_to_json_string_ext(val,
+				JSON_C_TO_STRING_PLAIN);
+		len = strlen(str);
+		if (len >= 2 && str[0] == '"' && str[len - 1] == '"')
+			util_csv_print_len(f_out, str + 1, len - 2);
+		else
+			util_csv_print(f_out, str);
+	}
+	fputc('\n', f_out);
+}
+
+static int util_json_stream_emit(struct util_json_stream *stream,
+		struct json_object *jobj)
+{
+	struct json_object *jwrap;
+	const char *str;
+	size_t len;
+
+	switch (stream->format) {
+	case UTIL_JSON_STREAM_NDJSON:
+		fprintf(stream->f_out, "%s\n", json_object_to_json_string_ext(
+					jobj, JSON_C_TO_STRING_PLAIN));
+		json_object_put(jobj);
+		stream->count++;
+		return 0;
+	case UTIL_JSON_STREAM_CSV:
+		if (!stream->count)
+			util_csv_header(stream->f_out, jobj);
+		util_csv_row(stream->f_out, jobj);
+		json_object_put(jobj);
+		stream->count++;
+		return 0;
+	default:
+		break;
+	}
+
+	/*
+	 * Render the element as the sole member of an array so that it is
+	 * indented exactly as it would be in the fully built array, then
+	 * strip the "[\n" and "\n]" framing.
+	 */
+	jwrap = json_object_new_array();
+	if (!jwrap) {
+		json_object_put(jobj);
+		return -ENOMEM;
+	}
+	json_object_array_add(jwrap, jobj);
+	str = json_object_to_json_string_ext(jwrap, JSON_C_TO_STRING_PRETTY);
+	len = strlen(str);
+	if (len >= 4)
+		fprintf(stream->f_out, "%s%.*s", stream->count ? ",\n" : "[\n",
+				(int) (len - 4), str + 2);
+	json_object_put(jwrap);
+	stream->count++;
+	return 0;
+}
+
+/*
+ * util_json_stream_add - emit a completed top-level element
+ *
+ * Takes ownership of @jobj. The output is identical to what
+ * util_display_json_array() prints for the same elements, including
+ * unwrapping a lone element in --human mode, without holding more than
+ * one element in memory.
+ */
+int util_json_stream_add(struct util_json_stream *stream,
+		struct json_object *jobj)
+{
+	int rc;
+
+	if (!jobj)
+		return -EINVAL;
+
+	if (stream->format == UTIL_JSON_STREAM_ARRAY
+			&& (stream->flags & UTIL_JSON_HUMAN)
+			&& !stream->count && !stream->pending) {
+		stream->pending = jobj;
+		return 0;
+	}
+
+	if (stream->pending) {
+		rc = util_json_stream_emit(stream, stream->pending);
+		stream->pending = NULL;
+		if (rc) {
+			json_object_put(jobj);
+			return rc;
+		}
+	}
+
+	return util_json_stream_emit(stream, jobj);
+}
+
+void util_json_stream_end(struct util_json_stream *stream)
+{
+	if (stream->pending) {
+		fprintf(stream->f_out, "%s\n", json_object_to_json_string_ext(
+					stream->pending, JSON_C_TO_STRING_PRETTY));
+		json_object_put(stream->pending);
+		stream->pending = NULL;
+	} else if (stream->count && stream->format == UTIL_JSON_STREAM_ARRAY)
+		fprintf(stream->f_out, "\n]\n");
+	stream->count = 0;
+}
+
+/*
+ * util_json_fields_parse - resolve a comma separated list of field names
+ *
+ * Returns the number of fields stored in @sel, or -EINVAL after
+ * reporting the first name that is not in @table.
+ */
+int util_json_fields_parse(const char *list,
+		const struct util_json_field *table, int table_len,
+		const struct util_json_field **sel, int max_sel)
+{
+	const char *name = list;
+	int num_sel = 0;
+
+	while (name && *name) {
+		const char *end = strchrnul(name, ',');
+		size_t len = end - name;
+		int i;
+
+		for (i = 0; i < table_len; i++)
+			if (strlen(table[i].name) == len
+					&& strncmp(table[i].name, name, len) == 0)
+				break;
+
+		if (i >= table_len) {
+			error("unknown field \"%.*s\", valid fields:", (int) len,
+					name);
+			for (i = 0; i < table_len; i++)
+				fprintf(stderr, "%s%s", i ? "," : " ",
+						table[i].name);
+			fprintf(stderr, "\n");
+			return -EINVAL;
+		}
+
+		if (num_sel >= max_sel) {
+			error("too many fields\n");
+			return -EINVAL;
+		}
+		sel[num_sel++] = &table[i];
+		name = *end ? end + 1 : end;
+	}
+
+	return num_sel;
+}
+
+/*
+ * util_json_fields_to_json - build a flat object holding only the
+ * selected fields, in the selected order. Fields that do not apply to
+ * @obj are reported as null.
+ */
+struct json_object *util_json_fields_to_json(void *obj,
+		const struct util_json_field **sel, int num_sel,
+		unsigned long flags)
+{
+	struct json_object *jrow = json_object_new_object();
+	int i;
+
+	if (!jrow)
+		return NULL;
+
+	for (i = 0; i < num_sel; i++)
+		json_object_object_add(jrow, sel[i]->name,
+				sel[i]->get(obj, flags));
+
+	return jrow;
+}
+
 struct json_object *util_bus_to_json(struct ndctl_bus *bus)
 {
 	struct json_object *jbus = json_object_new_object();
@@ -278,6 +517,7 @@ struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 	struct daxctl_memory *mem = daxctl_dev_get_memory(dev);
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct json_object *jdev, *jobj;
+	unsigned long align;
 	int node, movable;
 
 	jdev = json_object_new_object();
@@ -292,6 +532,13 @@ struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 	if (jobj)
 		json_object_object_add(jdev, "size", jobj);
 
+	align = daxctl_dev_get_align(dev);
+	if (align) {
+		jobj = util_json_object_size(align, flags);
+		if (jobj)
+			json_object_object_add(jdev, "align", jobj);
+	}
+
 	node = daxctl_dev_get_target_node(dev);
 	if (node >= 0) {
 		jobj = json_object_new_int(node);
@@ -478,11 +725,11 @@ struct json_object *util_daxctl_region_to_json(struct daxctl_region *region,
 	if (!(flags & UTIL_JSON_DAX)) {
 		/* trim off the redundant /sys/devices prefix */
 		const char *path = daxctl_region_get_path(region);
-		int len = strlen("/sys/devices");
-		const char *trim = &path[len];
+		const char *trim = strstr(path, "/devices/");
 
-		if (strncmp(path, "/sys/devices", len) != 0)
+		if (!trim)
 			goto err;
+		trim += strlen("/devices");
 		jobj = json_object_new_string(trim);
 		if (!jobj)
 			goto err;
@@ -1197,3 +1444,98 @@ struct json_object *util_badblock_rec_to_json(u64 block, u64 count,
 	json_object_put(jerr);
 	return NULL;
 }
+
+static struct json_object *util_cmd_stat_to_json(struct ndctl_cmd_stats *stats)
+{
+	struct json_object *jstat = json_object_new_object();
+	unsigned long long count = ndctl_cmd_stats_get_count(stats);
+	struct json_object *jobj, *jhist;
+	unsigned int i;
+
+	if (!jstat)
+		return NULL;
+
+	jobj = json_object_new_string(ndctl_cmd_stats_get_name(stats));
+	if (!jobj)
+		goto err;
+	json_object_object_add(jstat, "command", jobj);
+
+	jobj = json_object_new_int64(count);
+	if (!jobj)
+		goto err;
+	json_object_object_add(jstat, "count", jobj);
+
+	jobj = json_object_new_int64(ndctl_cmd_stats_get_errors(stats));
+	if (!jobj)
+		goto err;
+	json_object_object_add(jstat, "errors", jobj);
+
+	jobj = json_object_new_int64(ndctl_cmd_stats_get_fw_errors(stats));
+	if (!jobj)
+		goto err;
+	json_object_object_add(jstat, "firmware_errors", jobj);
+
+	if (count) {
+		jobj = json_object_new_int64(
+				ndctl_cmd_stats_get_total_ns(stats) / count
+				/ 1000);
+		if (!jobj)
+			goto err;
+		json_object_object_add(jstat, "avg_latency_usec", jobj);
+	}
+
+	jobj = json_object_new_int64(ndctl_cmd_stats_get_max_ns(stats) / 1000);
+	if (!jobj)
+		goto err;
+	json_object_object_add(jstat, "max_latency_usec", jobj);
+
+	/* non-empty buckets, keyed by their exclusive upper bound */
+	jhist = json_object_new_object();
+	if (!jhist)
+		goto err;
+	json_object_object_add(jstat, "latency_usec", jhist);
+	for (i = 0; i < ndctl_cmd_stats_get_num_buckets(stats); i++) {
+		unsigned long long n = ndctl_cmd_stats_get_bucket(stats, i);
+		char key[24];
+
+		if (!n)
+			continue;
+		if (i + 1 == ndctl_cmd_stats_get_num_buckets(stats))
+			strcpy(key, "inf");
+		else
+			sprintf(key, "%llu", 1ULL << i);
+		jobj = json_object_new_int64(n);
+		if (!jobj)
+			goto err;
+		json_object_object_add(jhist, key, jobj);
+	}
+
+	return jstat;
+ err:
+	json_object_put(jstat);
+	return NULL;
+}
+
+/* @stats is the first entry from ndctl_{dimm,bus}_get_first_cmd_stats() */
+struct json_object *util_cmd_stats_to_json(struct ndctl_cmd_stats *stats)
+{
+	struct json_object *jstats, *jstat;
+
+	if (!stats)
+		return NULL;
+
+	jstats = json_object_new_array();
+	if (!jstats)
+		return NULL;
+
+	for (; stats; stats = ndctl_cmd_stats_get_next(stats)) {
+		jstat = util_cmd_stat_to_json(stats);
+		if (!jstat) {
+			json_object_put(jstats);
+			return NULL;
+		}
+		json_object_array_add(jstats, jstat);
+	}
+
+	return jstats;
+}
@@ -31,6 +31,46 @@ enum util_json_flags {
 struct json_object;
 void util_display_json_array(FILE *f_out, struct json_object *jarray,
 		unsigned long flags);
+
+enum util_json_stream_format {
+	UTIL_JSON_STREAM_ARRAY,
+	UTIL_JSON_STREAM_NDJSON,
+	UTIL_JSON_STREAM_CSV,
+};
+
+/*
+ * struct util_json_stream - print a top-level json array one element at
+ * a time, one element per line (ndjson), or one flat element per csv row
+ */
+struct util_json_stream {
+	FILE *f_out;
+	unsigned long flags;
+	enum util_json_stream_format format;
+	int count;
+	struct json_object *pending;
+};
+
+void util_json_stream_init(struct util_json_stream *stream, FILE *f_out,
+		unsigned long flags, enum util_json_stream_format format);
+int util_json_stream_add(struct util_json_stream *stream,
+		struct json_object *jobj);
+void util_json_stream_end(struct util_json_stream *stream);
+
+/*
+ * struct util_json_field - a named attribute of a listed object, @get
+ * only queries what is needed for this one field
+ */
+struct util_json_field {
+	const char *name;
+	struct json_object *(*get)(void *obj, unsigned long flags);
+};
+
+int util_json_fields_parse(const char *list,
+		const struct util_json_field *table, int table_len,
+		const struct util_json_field **sel, int max_sel);
+struct json_object *util_json_fields_to_json(void *obj,
+		const struct util_json_field **sel, int num_sel,
+		unsigned long flags);
 struct json_object *util_bus_to_json(struct ndctl_bus *bus);
 struct json_object *util_dimm_to_json(struct ndctl_dimm *dimm,
 		unsigned long flags);
@@ -55,8 +95,19 @@ struct json_object *util_json_object_size(unsigned long long size,
 		unsigned long flags);
 struct json_object *util_json_object_hex(unsigned long long val,
 		unsigned long flags);
+/* alarm thresholds as reported by a smart threshold command */
+struct util_smart_threshold {
+	unsigned int alarm_control;
+	unsigned int temperature;
+	unsigned int ctrl_temperature;
+	unsigned int spares;
+};
+
 struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm);
+struct json_object *util_smart_to_json(struct ndctl_cmd *cmd,
+		struct util_smart_threshold *threshold);
 struct json_object *util_dimm_firmware_to_json(struct ndctl_dimm *dimm,
 		unsigned long flags);
 struct json_object *util_region_capabilities_to_json(struct ndctl_region *region);
+struct json_object *util_cmd_stats_to_json(struct ndctl_cmd_stats *stats);
 #endif /* __NDCTL_JSON_H__ */
@@ -18,11 +18,14 @@
 #define SZ_1K     0x00000400
 #define SZ_4K     0x00001000
 #define SZ_8K     0x00002000
+#define SZ_64K    0x00010000
+#define SZ_128K   0x00020000
 #define SZ_1M     0x00100000
 #define SZ_2M     0x00200000
 #define SZ_4M     0x00400000
 #define SZ_16M    0x01000000
 #define SZ_64M    0x04000000
+#define SZ_256M   0x10000000
 #define SZ_1G     0x40000000
 #define SZ_1T 0x10000000000ULL
 